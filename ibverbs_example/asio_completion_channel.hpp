@@ -0,0 +1,188 @@
+#ifndef KDD_RDMA_ASIO_COMPLETION_CHANNEL_HPP
+#define KDD_RDMA_ASIO_COMPLETION_CHANNEL_HPP
+
+#include "completion_queue.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <boost/asio.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+
+namespace rdma
+{
+    // Drives a completion queue from a Boost.Asio io_context. The file descriptor of
+    // the queue's completion event channel is registered with the io_context as a
+    // posix::stream_descriptor, so one thread can wait for RDMA completions, TCP
+    // sockets and timers in the same io_context::run():
+    //
+    //   rdma::asio_completion_channel channel{io, cq, evt_ch};
+    //
+    //   channel.async_wait(wcs, 32, [&](const boost::system::error_code& _ec, int _n) {
+    //       // Process _wcs[0, _n), then call async_wait() again.
+    //   });
+    //
+    // async_wait() is the asynchronous counterpart of completion_queue::wait(). It
+    // polls the queue first and only arms it and waits for the descriptor to become
+    // readable if it is empty. Events are acknowledged in batches.
+    //
+    // The event channel must be dedicated to the completion queue, and the queue must
+    // not be waited on with completion_queue::wait() while the channel is wrapped,
+    // because the descriptor is switched to non-blocking mode. The descriptor stays
+    // owned by the completion_event_channel and is not closed by the destructor.
+    // The object must outlive the handlers of its pending waits (see cancel()).
+    class asio_completion_channel
+    {
+    public:
+        asio_completion_channel(boost::asio::io_context& _io,
+                                const completion_queue& _cq,
+                                const completion_event_channel& _evt_ch)
+            : cq_{&_cq}
+            , evt_ch_{&_evt_ch.handle()}
+            , descriptor_{_io}
+            , fd_flags_{fcntl(evt_ch_->fd, F_GETFL)}
+            , unacked_events_{}
+            , wakeups_{}
+        {
+            if (fd_flags_ < 0 || fcntl(evt_ch_->fd, F_SETFL, fd_flags_ | O_NONBLOCK) < 0) {
+                perror("fcntl");
+                throw std::runtime_error{"fcntl error"};
+            }
+
+            descriptor_.assign(evt_ch_->fd);
+        }
+
+        asio_completion_channel(const asio_completion_channel&) = delete;
+        auto operator=(const asio_completion_channel&) -> asio_completion_channel& = delete;
+
+        ~asio_completion_channel()
+        {
+            // Deregisters the descriptor without closing it.
+            descriptor_.release();
+            fcntl(evt_ch_->fd, F_SETFL, fd_flags_);
+
+            if (unacked_events_ > 0)
+                ibv_ack_cq_events(&cq_->handle(), unacked_events_);
+        }
+
+        // Calls _handler(error_code, n) from the io_context once at least one
+        // completion is available, after up to _max completions have been written to
+        // _wcs. _wcs must stay valid until then. The handler is never called from
+        // within async_wait().
+        template <typename Handler>
+        auto async_wait(ibv_wc* _wcs, int _max, Handler _handler) -> void
+        {
+            if (const auto n = poll_or_arm(_wcs, _max); n > 0) {
+                boost::asio::post(descriptor_.get_executor(), [n, h = std::move(_handler)]() mutable {
+                    h(boost::system::error_code{}, n);
+                });
+
+                return;
+            }
+
+            descriptor_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                                   [this, _wcs, _max, h = std::move(_handler)](const boost::system::error_code& _ec) mutable {
+                                       on_readable(_ec, _wcs, _max, std::move(h));
+                                   });
+        }
+
+        // Completes pending waits with boost::asio::error::operation_aborted.
+        auto cancel() -> void
+        {
+            descriptor_.cancel();
+        }
+
+        // The number of times the descriptor became readable, i.e. the number of waits
+        // that had to go through the interrupt.
+        auto wakeups() const noexcept -> std::uint64_t
+        {
+            return wakeups_;
+        }
+
+    private:
+        static constexpr unsigned int event_ack_batch_size = 64;
+
+        // Returns the number of completions polled. If there are none, the queue has
+        // been armed and the descriptor will become readable with the next completion.
+        auto poll_or_arm(ibv_wc* _wcs, int _max) -> int
+        {
+            if (const auto n = cq_->poll(_wcs, _max); n > 0)
+                return n;
+
+            if (ibv_req_notify_cq(&cq_->handle(), 0)) {
+                perror("ibv_req_notify_cq");
+                throw std::runtime_error{"ibv_req_notify_cq error"};
+            }
+
+            // A completion may have arrived between the poll and arming the queue.
+            return cq_->poll(_wcs, _max);
+        }
+
+        template <typename Handler>
+        auto on_readable(const boost::system::error_code& _ec, ibv_wc* _wcs, int _max, Handler&& _handler) -> void
+        {
+            if (_ec) {
+                _handler(_ec, 0);
+                return;
+            }
+
+            ++wakeups_;
+
+            if (const auto ec = consume_events(); ec) {
+                _handler(ec, 0);
+                return;
+            }
+
+            // The events may be stale (left over from an arm whose completion was found
+            // by polling). In that case, the queue has been re-armed, so wait again.
+            if (const auto n = poll_or_arm(_wcs, _max); n > 0) {
+                _handler(boost::system::error_code{}, n);
+                return;
+            }
+
+            descriptor_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                                   [this, _wcs, _max, h = std::move(_handler)](const boost::system::error_code& _ec) mutable {
+                                       on_readable(_ec, _wcs, _max, std::move(h));
+                                   });
+        }
+
+        // Reads all pending events off the non-blocking descriptor.
+        auto consume_events() -> boost::system::error_code
+        {
+            ibv_cq* evt_cq{};
+            void* evt_cq_ctx{};
+
+            while (ibv_get_cq_event(evt_ch_, &evt_cq, &evt_cq_ctx) == 0) {
+                if (evt_cq != &cq_->handle()) {
+                    ibv_ack_cq_events(evt_cq, 1);
+                    throw std::logic_error{"completion event channel is shared with another completion queue"};
+                }
+
+                if (++unacked_events_ >= event_ack_batch_size) {
+                    ibv_ack_cq_events(evt_cq, unacked_events_);
+                    unacked_events_ = 0;
+                }
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return {};
+
+            return {errno, boost::system::system_category()};
+        }
+
+        const completion_queue* cq_;
+        ibv_comp_channel* evt_ch_;
+        boost::asio::posix::stream_descriptor descriptor_;
+        int fd_flags_;
+        unsigned int unacked_events_;
+        std::uint64_t wakeups_;
+    }; // class asio_completion_channel
+} // namespace rdma
+
+#endif // KDD_RDMA_ASIO_COMPLETION_CHANNEL_HPP
@@ -0,0 +1,284 @@
+#ifndef KDD_RDMA_ATOMICS_HPP
+#define KDD_RDMA_ATOMICS_HPP
+
+#include "memory_region.hpp"
+#include "queue_pair.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+
+// Synchronization primitives built on RDMA atomics. The shared state is a 64-bit
+// word in a memory region registered with IBV_ACCESS_REMOTE_ATOMIC. Every node,
+// including the one owning the memory, must update the word through RDMA atomics.
+// Local CPU stores are not atomic with respect to them.
+//
+// Each primitive issues one atomic at a time and blocks until it completes. The
+// queue pair must not have selective signaling enabled, and its completion queue
+// must not be polled by another thread while an operation is in flight. Other
+// completions of the queue that arrive while waiting are kept and handed back by
+// take_other_completions().
+
+namespace rdma
+{
+    namespace detail
+    {
+        // Posts one atomic through _post and returns the original value of the remote word.
+        // Other completions of the queue that arrive in the meantime are appended to _others.
+        template <typename PostAtomic>
+        auto execute_atomic(queue_pair& _qp,
+                            const buffer_descriptor& _result,
+                            std::vector<ibv_wc>& _others,
+                            PostAtomic _post) -> std::uint64_t
+        {
+            _post(_qp, _result);
+
+            while (true) {
+                const auto wc = _qp.wait_for_completion();
+
+                const auto is_atomic = wc.qp_num == _qp.queue_pair_number() &&
+                                       wc.wr_id == _result.wr_id &&
+                                       (wc.opcode == IBV_WC_FETCH_ADD || wc.opcode == IBV_WC_COMP_SWAP);
+
+                // A failed work request has no valid opcode. Since the QP is in the error
+                // state afterwards, its atomic will not complete successfully either.
+                const auto is_own_error = wc.qp_num == _qp.queue_pair_number() && wc.status != IBV_WC_SUCCESS;
+
+                if (is_own_error)
+                    throw std::runtime_error{ibv_wc_status_str(wc.status)};
+
+                if (!is_atomic) {
+                    _others.push_back(wc);
+                    continue;
+                }
+
+                return *static_cast<const volatile std::uint64_t*>(_result.address);
+            }
+        }
+
+        inline auto check_atomic_word(queue_pair& _qp, const buffer_descriptor& _result) -> void
+        {
+            if (_qp.signal_interval() > 0)
+                throw std::logic_error{"remote atomics require every send to be signaled"};
+
+            if (_result.length != sizeof(std::uint64_t))
+                throw std::invalid_argument{"remote atomics require an 8 byte result buffer"};
+        }
+    } // namespace detail
+
+    // A 64-bit counter in remote memory, e.g. for handing out sequence numbers.
+    // _result is a local 8 byte buffer (registered with IBV_ACCESS_LOCAL_WRITE)
+    // that receives the value returned by each operation.
+    class remote_counter
+    {
+    public:
+        remote_counter(queue_pair& _qp,
+                       const buffer_descriptor& _result,
+                       const remote_memory_region& _remote,
+                       std::uint64_t _remote_offset)
+            : qp_{&_qp}
+            , result_{_result}
+            , remote_{_remote}
+            , remote_offset_{_remote_offset}
+            , others_{}
+        {
+            detail::check_atomic_word(_qp, _result);
+        }
+
+        // Adds _value and returns the value before the addition.
+        auto fetch_add(std::uint64_t _value = 1) -> std::uint64_t
+        {
+            return detail::execute_atomic(*qp_, result_, others_, [this, _value](queue_pair& _qp, const buffer_descriptor& _result) {
+                _qp.post_fetch_add(_result, remote_, remote_offset_, _value);
+            });
+        }
+
+        auto load() -> std::uint64_t
+        {
+            return fetch_add(0);
+        }
+
+        // Replaces the value with _desired if it equals _expected. Returns the value
+        // before the operation.
+        auto compare_exchange(std::uint64_t _expected, std::uint64_t _desired) -> std::uint64_t
+        {
+            return detail::execute_atomic(*qp_, result_, others_, [&](queue_pair& _qp, const buffer_descriptor& _result) {
+                _qp.post_compare_swap(_result, remote_, remote_offset_, _expected, _desired);
+            });
+        }
+
+        // The completions of other work requests received while waiting for atomics.
+        auto take_other_completions() -> std::vector<ibv_wc>
+        {
+            return std::exchange(others_, {});
+        }
+
+    private:
+        queue_pair* qp_;
+        buffer_descriptor result_;
+        remote_memory_region remote_;
+        std::uint64_t remote_offset_;
+        std::vector<ibv_wc> others_;
+    }; // class remote_counter
+
+    // A mutual exclusion lock in remote memory. The lock word holds zero when the lock
+    // is free and the owner id of the holder otherwise. Every node must use a distinct,
+    // non-zero owner id. Waiting is done by retrying the compare-and-swap with an
+    // exponential backoff, so each attempt costs one network round trip.
+    class remote_spinlock
+    {
+    public:
+        remote_spinlock(queue_pair& _qp,
+                        const buffer_descriptor& _result,
+                        const remote_memory_region& _remote,
+                        std::uint64_t _remote_offset,
+                        std::uint64_t _owner_id)
+            : word_{_qp, _result, _remote, _remote_offset}
+            , owner_id_{_owner_id}
+        {
+            if (_owner_id == 0)
+                throw std::invalid_argument{"remote spinlock owner id must not be zero"};
+        }
+
+        auto try_lock() -> bool
+        {
+            return word_.compare_exchange(0, owner_id_) == 0;
+        }
+
+        auto lock() -> void
+        {
+            constexpr std::chrono::microseconds max_backoff{256};
+            std::chrono::microseconds backoff{1};
+
+            while (!try_lock()) {
+                std::this_thread::sleep_for(backoff);
+
+                if (backoff < max_backoff)
+                    backoff *= 2;
+            }
+        }
+
+        auto unlock() -> void
+        {
+            if (word_.compare_exchange(owner_id_, 0) != owner_id_)
+                throw std::logic_error{"remote spinlock is not held by this owner"};
+        }
+
+        auto take_other_completions() -> std::vector<ibv_wc>
+        {
+            return word_.take_other_completions();
+        }
+
+    private:
+        remote_counter word_;
+        std::uint64_t owner_id_;
+    }; // class remote_spinlock
+
+    // A lock that expires, so that a crashed holder cannot block the other nodes
+    // forever. The lock word packs the owner id in the upper 16 bits and the
+    // expiry time, in milliseconds since the Unix epoch, in the lower 48 bits.
+    //
+    // Expiry is judged by the clock of the node trying to acquire the lease, so the
+    // clocks of all nodes must be synchronized (e.g. with PTP or NTP) to well within
+    // the lease duration. A holder must renew the lease before it expires and must
+    // stop touching the protected state once renew() fails.
+    class remote_lease
+    {
+    public:
+        remote_lease(queue_pair& _qp,
+                     const buffer_descriptor& _result,
+                     const remote_memory_region& _remote,
+                     std::uint64_t _remote_offset,
+                     std::uint16_t _owner_id)
+            : word_{_qp, _result, _remote, _remote_offset}
+            , owner_id_{_owner_id}
+            , held_{}
+        {
+            if (_owner_id == 0)
+                throw std::invalid_argument{"remote lease owner id must not be zero"};
+        }
+
+        // Acquires the lease for _duration if it is free or has expired.
+        auto try_acquire(std::chrono::milliseconds _duration) -> bool
+        {
+            const auto now = now_ms();
+            const auto desired = make_word(now + _duration.count());
+            const auto current = word_.compare_exchange(0, desired);
+
+            if (current != 0) {
+                if (expiry(current) > now)
+                    return false;
+
+                // The lease expired. Take it over unless someone else already did.
+                if (word_.compare_exchange(current, desired) != current)
+                    return false;
+            }
+
+            held_ = desired;
+            return true;
+        }
+
+        // Extends a held lease to expire _duration from now. Returns false if the
+        // lease was lost, i.e. it expired and another node acquired it.
+        auto renew(std::chrono::milliseconds _duration) -> bool
+        {
+            if (held_ == 0)
+                throw std::logic_error{"remote lease is not held"};
+
+            const auto desired = make_word(now_ms() + _duration.count());
+
+            if (word_.compare_exchange(held_, desired) != held_) {
+                held_ = 0;
+                return false;
+            }
+
+            held_ = desired;
+            return true;
+        }
+
+        auto release() -> void
+        {
+            if (held_ == 0)
+                return;
+
+            word_.compare_exchange(held_, 0);
+            held_ = 0;
+        }
+
+        auto take_other_completions() -> std::vector<ibv_wc>
+        {
+            return word_.take_other_completions();
+        }
+
+    private:
+        static constexpr std::uint64_t expiry_mask = (std::uint64_t{1} << 48) - 1;
+
+        static auto now_ms() -> std::uint64_t
+        {
+            using namespace std::chrono;
+            return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        }
+
+        static constexpr auto expiry(std::uint64_t _word) noexcept -> std::uint64_t
+        {
+            return _word & expiry_mask;
+        }
+
+        auto make_word(std::uint64_t _expiry_ms) const noexcept -> std::uint64_t
+        {
+            return (std::uint64_t{owner_id_} << 48) | (_expiry_ms & expiry_mask);
+        }
+
+        remote_counter word_;
+        std::uint16_t owner_id_;
+        std::uint64_t held_; // The lock word as last written by this node, or zero.
+    }; // class remote_lease
+} // namespace rdma
+
+#endif // KDD_RDMA_ATOMICS_HPP
@@ -0,0 +1,112 @@
+#ifndef KDD_RDMA_BENCHMARK_ADAPTIVE_WAIT_HPP
+#define KDD_RDMA_BENCHMARK_ADAPTIVE_WAIT_HPP
+
+#include "common.hpp"
+
+#include <time.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    inline auto thread_cpu_seconds() -> double
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    // A sender thread alternates bursts of back-to-back messages with idle gaps.
+    // The receiver waits with completion_queue::wait() for several spin budgets and
+    // reports how many waits ended while spinning versus after blocking, along with
+    // the CPU time the receiving thread consumed.
+    inline auto run_adaptive_wait(const options& _opts) -> void
+    {
+        constexpr std::size_t queue_depth = 64;
+        constexpr std::size_t burst_size = 16;
+        constexpr std::chrono::microseconds idle_gap{500};
+
+        loopback_config config;
+        config.max_send_wr = queue_depth;
+        config.max_recv_wr = queue_depth;
+        config.cqe_size = queue_depth;
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> send_buffer(_opts.message_size);
+        std::vector<std::uint8_t> recv_buffer(queue_depth * _opts.message_size);
+        memory_region send_mr{lb.pd(), send_buffer, loopback_access_flags};
+        memory_region recv_mr{lb.pd(), recv_buffer, loopback_access_flags};
+
+        std::vector<buffer_descriptor> recvs;
+
+        for (std::size_t i = 0; i < queue_depth; ++i) {
+            const auto length = static_cast<std::uint32_t>(_opts.message_size);
+            recvs.push_back(make_buffer_descriptor(recv_mr, i * _opts.message_size, length, i));
+        }
+
+        const auto send = make_buffer_descriptor(send_mr, 0, static_cast<std::uint32_t>(_opts.message_size));
+        const auto messages = std::min<std::size_t>(_opts.iterations, 10000);
+
+        report r{std::cout, _opts.format, {"test", "spin_budget_ns", "messages", "seconds", "receiver_cpu_seconds", "spin_waits", "blocking_waits"}};
+
+        for (const auto budget : {0, 1'000, 10'000, 100'000, 1'000'000}) {
+            auto& cq = lb.receiver_cq();
+            cq.set_spin_budget(std::chrono::nanoseconds{budget});
+            cq.reset_statistics();
+
+            // Never post more receives than the stream will consume.
+            std::size_t recv_posted = std::min(queue_depth, messages);
+            lb.receiver().post_receive(recvs.data(), recv_posted);
+
+            // The sender never gets ahead of the posted receives because each burst is
+            // smaller than the receive queue and is followed by a long idle gap.
+            std::thread sender{[&] {
+                for (std::size_t sent = 0; sent < messages;) {
+                    const auto n = std::min(burst_size, messages - sent);
+
+                    for (std::size_t i = 0; i < n; ++i)
+                        lb.sender().post_send(&send, 1);
+
+                    wait_for_completions(lb.sender_cq(), n);
+                    sent += n;
+
+                    std::this_thread::sleep_for(idle_gap);
+                }
+            }};
+
+            std::size_t received = 0;
+            ibv_wc wcs[16];
+
+            const auto cpu_start = thread_cpu_seconds();
+            const stopwatch sw;
+
+            while (received < messages) {
+                const auto n = static_cast<std::size_t>(cq.wait(wcs, 16));
+                received += n;
+
+                const auto to_post = std::min(n, messages - recv_posted);
+                if (to_post > 0) {
+                    lb.receiver().post_receive(recvs.data(), to_post);
+                    recv_posted += to_post;
+                }
+            }
+
+            const auto seconds = sw.elapsed_seconds();
+            const auto cpu_seconds = thread_cpu_seconds() - cpu_start;
+
+            sender.join();
+
+            const auto stats = cq.statistics();
+
+            r.row("adaptive_wait", budget, received, seconds, cpu_seconds, stats.spin_waits, stats.blocking_waits);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_ADAPTIVE_WAIT_HPP
@@ -0,0 +1,277 @@
+#ifndef KDD_RDMA_BENCHMARK_ASIO_EVENT_LOOP_HPP
+#define KDD_RDMA_BENCHMARK_ASIO_EVENT_LOOP_HPP
+
+#include "common.hpp"
+
+#include <boost/asio.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma::benchmark
+{
+    // Streams messages through a loopback pair from an io_context. The receiver's
+    // completions are waited for through an asio_completion_channel. The sender's
+    // queue is polled whenever receives complete.
+    class asio_rdma_stream
+    {
+    public:
+        asio_rdma_stream(boost::asio::io_context& _io, loopback& _lb, const memory_region& _mr,
+                         std::uint32_t _length, std::uint32_t _depth, std::size_t _messages)
+            : io_{&_io}
+            , lb_{&_lb}
+            , channel_{_io, _lb.receiver_cq(), _lb.receiver_event_channel()}
+            , sends_(_depth)
+            , recvs_(_depth)
+            , depth_{_depth}
+            , messages_{_messages}
+            , recv_posted_{}
+            , sent_{}
+            , send_completed_{}
+            , received_{}
+        {
+            for (std::uint32_t i = 0; i < _depth; ++i) {
+                sends_[i] = make_buffer_descriptor(_mr, 0, _length, i);
+                recvs_[i] = make_buffer_descriptor(_mr, i * _length, _length, i);
+            }
+        }
+
+        asio_rdma_stream(const asio_rdma_stream&) = delete;
+        auto operator=(const asio_rdma_stream&) -> asio_rdma_stream& = delete;
+
+        auto start() -> void
+        {
+            recv_posted_ = std::min<std::size_t>(depth_, messages_);
+            lb_->receiver().post_receive(recvs_.data(), recv_posted_);
+            step();
+        }
+
+        auto received() const noexcept -> std::size_t
+        {
+            return received_;
+        }
+
+        auto wakeups() const noexcept -> std::uint64_t
+        {
+            return channel_.wakeups();
+        }
+
+    private:
+        static constexpr int poll_batch_size = 32;
+
+        auto step() -> void
+        {
+            send_completed_ += poll_completions(lb_->sender_cq(), static_cast<int>(depth_));
+
+            const auto n = std::min(recv_posted_ - sent_, depth_ - (sent_ - send_completed_));
+
+            if (n > 0) {
+                lb_->sender().post_send(sends_.data(), n);
+                sent_ += n;
+            }
+
+            // The loopback pair is reused by the next run, so its sends must not
+            // complete after this one.
+            if (received_ == messages_) {
+                wait_for_completions(lb_->sender_cq(), sent_ - send_completed_);
+                return;
+            }
+
+            // With nothing in flight, only send completions can free up the send queue.
+            // Those are not signaled through the channel, so yield to the other handlers
+            // and try again.
+            if (received_ == sent_) {
+                boost::asio::post(*io_, [this] { step(); });
+                return;
+            }
+
+            channel_.async_wait(wcs_, poll_batch_size, [this](const boost::system::error_code& _ec, int _n) {
+                on_receive(_ec, _n);
+            });
+        }
+
+        auto on_receive(const boost::system::error_code& _ec, int _n) -> void
+        {
+            if (_ec)
+                throw boost::system::system_error{_ec};
+
+            for (int i = 0; i < _n; ++i) {
+                if (wcs_[i].status != IBV_WC_SUCCESS)
+                    throw std::runtime_error{ibv_wc_status_str(wcs_[i].status)};
+            }
+
+            received_ += _n;
+
+            if (const auto to_post = std::min<std::size_t>(_n, messages_ - recv_posted_); to_post > 0) {
+                lb_->receiver().post_receive(recvs_.data(), to_post);
+                recv_posted_ += to_post;
+            }
+
+            step();
+        }
+
+        boost::asio::io_context* io_;
+        loopback* lb_;
+        asio_completion_channel channel_;
+        std::vector<buffer_descriptor> sends_;
+        std::vector<buffer_descriptor> recvs_;
+        ibv_wc wcs_[poll_batch_size];
+        std::size_t depth_;
+        std::size_t messages_;
+        std::size_t recv_posted_;
+        std::size_t sent_;
+        std::size_t send_completed_;
+        std::size_t received_;
+    }; // class asio_rdma_stream
+
+    // Round trips of a message between two connected TCP sockets of an io_context.
+    // The server echoes every message and the client checks the echo.
+    class asio_tcp_ping_pong
+    {
+    public:
+        asio_tcp_ping_pong(boost::asio::io_context& _io, std::size_t _length, std::size_t _round_trips)
+            : client_{_io}
+            , server_{_io}
+            , message_(std::max<std::size_t>(1, _length))
+            , client_buffer_(message_.size())
+            , server_buffer_(message_.size())
+            , round_trips_{_round_trips}
+            , served_{}
+            , completed_{}
+        {
+            using tcp = boost::asio::ip::tcp;
+
+            tcp::acceptor acceptor{_io, tcp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+            client_.connect(acceptor.local_endpoint());
+            acceptor.accept(server_);
+
+            client_.set_option(tcp::no_delay{true});
+            server_.set_option(tcp::no_delay{true});
+
+            for (std::size_t i = 0; i < message_.size(); ++i)
+                message_[i] = static_cast<std::uint8_t>(i);
+        }
+
+        asio_tcp_ping_pong(const asio_tcp_ping_pong&) = delete;
+        auto operator=(const asio_tcp_ping_pong&) -> asio_tcp_ping_pong& = delete;
+
+        auto start() -> void
+        {
+            if (round_trips_ == 0)
+                return;
+
+            serve();
+            ping();
+        }
+
+        auto completed() const noexcept -> std::size_t
+        {
+            return completed_;
+        }
+
+    private:
+        auto ping() -> void
+        {
+            boost::asio::async_write(client_, boost::asio::buffer(message_), [this](const boost::system::error_code& _ec, std::size_t) {
+                check(_ec);
+
+                boost::asio::async_read(client_, boost::asio::buffer(client_buffer_), [this](const boost::system::error_code& _ec, std::size_t) {
+                    check(_ec);
+
+                    if (client_buffer_ != message_)
+                        throw std::runtime_error{"tcp echo mismatch"};
+
+                    if (++completed_ < round_trips_)
+                        ping();
+                });
+            });
+        }
+
+        auto serve() -> void
+        {
+            boost::asio::async_read(server_, boost::asio::buffer(server_buffer_), [this](const boost::system::error_code& _ec, std::size_t) {
+                check(_ec);
+
+                boost::asio::async_write(server_, boost::asio::buffer(server_buffer_), [this](const boost::system::error_code& _ec, std::size_t) {
+                    check(_ec);
+
+                    if (++served_ < round_trips_)
+                        serve();
+                });
+            });
+        }
+
+        static auto check(const boost::system::error_code& _ec) -> void
+        {
+            if (_ec)
+                throw boost::system::system_error{_ec};
+        }
+
+        boost::asio::ip::tcp::socket client_;
+        boost::asio::ip::tcp::socket server_;
+        std::vector<std::uint8_t> message_;
+        std::vector<std::uint8_t> client_buffer_;
+        std::vector<std::uint8_t> server_buffer_;
+        std::size_t round_trips_;
+        std::size_t served_;
+        std::size_t completed_;
+    }; // class asio_tcp_ping_pong
+
+    // Runs RDMA and TCP traffic on a single thread from one io_context: --iterations
+    // RDMA sends of --size bytes with --queue-depth in flight, whose receive
+    // completions are waited for through an asio_completion_channel, and --iterations
+    // TCP round trips of --size bytes over the loopback interface. Each kind of traffic
+    // runs alone first, then both together. Every run checks that all of its traffic
+    // completed. Reports the rate of each and the number of completion channel wakeups.
+    inline auto run_asio_event_loop(const options& _opts) -> void
+    {
+        const auto depth = static_cast<std::uint32_t>(_opts.queue_depth);
+        const auto length = static_cast<std::uint32_t>(_opts.message_size);
+        const auto messages = std::max<std::size_t>(1, _opts.iterations);
+
+        loopback_config config;
+        config.max_send_wr = depth;
+        config.max_recv_wr = depth;
+        config.cqe_size = static_cast<int>(depth);
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> buffer(std::size_t{depth} * std::max<std::uint32_t>(1, length));
+        memory_region mr{lb.pd(), buffer, loopback_access_flags};
+
+        report r{std::cout, _opts.format, {"test", "traffic", "message_size", "rdma_messages", "tcp_round_trips",
+                                           "seconds", "rdma_messages_per_second", "tcp_round_trips_per_second",
+                                           "wakeups"}};
+
+        for (const auto traffic : {"rdma", "tcp", "mixed"}) {
+            const auto rdma_messages = traffic[0] == 't' ? 0 : messages;
+            const auto tcp_round_trips = traffic[0] == 'r' ? 0 : messages;
+
+            boost::asio::io_context io;
+            asio_rdma_stream stream{io, lb, mr, length, depth, rdma_messages};
+            asio_tcp_ping_pong ping_pong{io, length, tcp_round_trips};
+
+            const stopwatch sw;
+
+            if (rdma_messages > 0)
+                stream.start();
+
+            ping_pong.start();
+            io.run();
+
+            const auto seconds = sw.elapsed_seconds();
+
+            if (stream.received() != rdma_messages || ping_pong.completed() != tcp_round_trips)
+                throw std::runtime_error{"asio_event_loop: traffic did not complete"};
+
+            r.row("asio_event_loop", traffic, length, rdma_messages, tcp_round_trips, seconds,
+                  rdma_messages / seconds, tcp_round_trips / seconds, stream.wakeups());
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_ASIO_EVENT_LOOP_HPP
@@ -0,0 +1,83 @@
+#ifndef KDD_RDMA_BENCHMARK_BATCH_POSTING_HPP
+#define KDD_RDMA_BENCHMARK_BATCH_POSTING_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Streams small sends between the loopback queue pairs, posting them in batches
+    // of 1, 2, 4, ..., 256 work requests per doorbell. The send and receive queues
+    // are kept as full as possible so that the posting cost dominates.
+    inline auto run_batch_posting(const options& _opts) -> void
+    {
+        constexpr std::size_t max_batch_size = 256;
+
+        loopback_config config;
+        config.max_send_wr = max_batch_size;
+        config.max_recv_wr = max_batch_size;
+        config.cqe_size = 2 * max_batch_size;
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> send_buffer(max_batch_size * _opts.message_size);
+        std::vector<std::uint8_t> recv_buffer(max_batch_size * _opts.message_size);
+        memory_region send_mr{lb.pd(), send_buffer, loopback_access_flags};
+        memory_region recv_mr{lb.pd(), recv_buffer, loopback_access_flags};
+
+        std::vector<buffer_descriptor> sends;
+        std::vector<buffer_descriptor> recvs;
+
+        for (std::size_t i = 0; i < max_batch_size; ++i) {
+            const auto offset = i * _opts.message_size;
+            const auto length = static_cast<std::uint32_t>(_opts.message_size);
+            sends.push_back(make_buffer_descriptor(send_mr, offset, length, i));
+            recvs.push_back(make_buffer_descriptor(recv_mr, offset, length, i));
+        }
+
+        report r{std::cout, _opts.format, {"test", "batch_size", "message_size", "messages", "seconds", "messages_per_second"}};
+
+        for (std::size_t batch_size = 1; batch_size <= max_batch_size; batch_size *= 2) {
+            std::size_t posted = 0;
+            std::size_t send_outstanding = 0;
+            std::size_t recv_outstanding = 0;
+            std::size_t completed = 0;
+
+            const stopwatch sw;
+
+            while (completed < _opts.iterations) {
+                const auto remaining = _opts.iterations - posted;
+                const auto n = std::min(batch_size, remaining);
+
+                if (n > 0 &&
+                    send_outstanding + n <= max_batch_size &&
+                    recv_outstanding + n <= max_batch_size)
+                {
+                    lb.receiver().post_receive(recvs.data(), n);
+                    lb.sender().post_send(sends.data(), n);
+                    posted += n;
+                    send_outstanding += n;
+                    recv_outstanding += n;
+                }
+
+                send_outstanding -= poll_completions(lb.sender_cq(), static_cast<int>(send_outstanding));
+
+                const auto received = poll_completions(lb.receiver_cq(), static_cast<int>(recv_outstanding));
+                recv_outstanding -= received;
+                completed += received;
+            }
+
+            wait_for_completions(lb.sender_cq(), send_outstanding);
+
+            const auto seconds = sw.elapsed_seconds();
+
+            r.row("batch_posting", batch_size, _opts.message_size, completed, seconds, completed / seconds);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_BATCH_POSTING_HPP
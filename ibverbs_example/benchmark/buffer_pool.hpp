@@ -0,0 +1,73 @@
+#ifndef KDD_RDMA_BENCHMARK_BUFFER_POOL_HPP
+#define KDD_RDMA_BENCHMARK_BUFFER_POOL_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Measures allocate/deallocate pairs per second from a buffer_pool, going
+    // directly to the shared free lists and through per-thread caches, for an
+    // increasing number of threads. Each thread holds a few buffers at a time to
+    // mimic a sender with several messages in flight.
+    inline auto run_buffer_pool(const options& _opts) -> void
+    {
+        constexpr std::size_t in_flight = 8;
+
+        device_list devices;
+        context ctx{devices[_opts.device_index]};
+        protection_domain pd{ctx};
+
+        const auto message_size = static_cast<std::uint32_t>(_opts.message_size);
+        const auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        buffer_pool pool{pd, {{message_size, 64 * 1024}, {4 * message_size, 1024}}, loopback_access_flags};
+
+        report r{std::cout, _opts.format, {"test", "mode", "threads", "message_size", "operations", "seconds", "operations_per_second"}};
+
+        for (const bool use_cache : {false, true}) {
+            for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+                std::vector<std::thread> workers;
+
+                const stopwatch sw;
+
+                for (unsigned int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&] {
+                        pooled_buffer held[in_flight];
+
+                        if (use_cache) {
+                            buffer_pool::thread_cache cache{pool};
+
+                            for (std::size_t i = 0; i < _opts.iterations; i += in_flight) {
+                                for (auto& b : held) b = cache.allocate(message_size);
+                                for (auto& b : held) cache.deallocate(b);
+                            }
+                        }
+                        else {
+                            for (std::size_t i = 0; i < _opts.iterations; i += in_flight) {
+                                for (auto& b : held) b = pool.allocate(message_size);
+                                for (auto& b : held) pool.deallocate(b);
+                            }
+                        }
+                    });
+                }
+
+                for (auto& w : workers)
+                    w.join();
+
+                const auto seconds = sw.elapsed_seconds();
+                const auto operations = static_cast<double>(threads) * _opts.iterations;
+
+                r.row("buffer_pool", use_cache ? "thread_cache" : "shared", threads, message_size,
+                      operations, seconds, operations / seconds);
+            }
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_BUFFER_POOL_HPP
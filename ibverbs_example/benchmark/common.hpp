@@ -0,0 +1,239 @@
+#ifndef KDD_RDMA_BENCHMARK_COMMON_HPP
+#define KDD_RDMA_BENCHMARK_COMMON_HPP
+
+#include "../verbs.hpp"
+#include "report.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+namespace rdma::benchmark
+{
+    struct options
+    {
+        int device_index = 0;
+        std::uint8_t port_number = 1;
+        int gid_index = 0;
+        std::size_t message_size = 64;
+        std::size_t iterations = 100000;
+        std::size_t region_size = std::size_t{256} << 20;
+        std::size_t queue_depth = 128;
+        std::size_t min_message_size = 2;
+        std::size_t max_message_size = std::size_t{8} << 20;
+        std::size_t connections = 256;
+        std::string control_port = "18515";
+        int mtu = 0; // The largest path MTU in bytes. Zero uses the port's active MTU.
+        output_format format = output_format::csv;
+    };
+
+    struct loopback_config
+    {
+        std::uint32_t max_send_wr = 1;
+        std::uint32_t max_recv_wr = 1;
+        std::uint32_t max_send_sge = 1;
+        std::uint32_t max_recv_sge = 1;
+        std::uint32_t max_inline_data = 0;
+        int cqe_size = 1;
+        int sq_sig_all = 1;
+    };
+
+    constexpr auto loopback_access_flags = IBV_ACCESS_LOCAL_WRITE |
+                                           IBV_ACCESS_REMOTE_READ |
+                                           IBV_ACCESS_REMOTE_WRITE |
+                                           IBV_ACCESS_REMOTE_ATOMIC;
+
+    inline auto make_queue_pair_init_attributes(const completion_queue& _cq,
+                                                const loopback_config& _config) -> ibv_qp_init_attr
+    {
+        ibv_qp_init_attr attrs{};
+        attrs.qp_type = IBV_QPT_RC;
+        attrs.sq_sig_all = _config.sq_sig_all;
+        attrs.send_cq = &_cq.handle();
+        attrs.recv_cq = &_cq.handle();
+        attrs.cap.max_send_wr = _config.max_send_wr;
+        attrs.cap.max_recv_wr = _config.max_recv_wr;
+        attrs.cap.max_send_sge = _config.max_send_sge;
+        attrs.cap.max_recv_sge = _config.max_recv_sge;
+        attrs.cap.max_inline_data = _config.max_inline_data;
+        return attrs;
+    }
+
+    // Connects two RC queue pairs on the same device to each other and transitions
+    // both to RTS.
+    inline auto connect_loopback_queue_pairs(const context& _ctx,
+                                             queue_pair& _a,
+                                             queue_pair& _b,
+                                             const options& _opts) -> void
+    {
+        const auto port_info = _ctx.port_info(_opts.port_number);
+        const auto grh_required = (port_info.flags & IBV_QPF_GRH_REQUIRED) == IBV_QPF_GRH_REQUIRED;
+        const auto gid = _ctx.gid(_opts.port_number, _opts.gid_index);
+
+        const auto a_psn = generate_random_int();
+        const auto b_psn = generate_random_int();
+
+        // Both QPs live on the same device, so the negotiated limits are the device limits.
+        const auto limits = query_atomic_limits(_ctx);
+
+        const queue_pair_info a_info{_a.queue_pair_number(), a_psn, port_info.lid,
+                                     limits.max_rd_atomic, limits.max_dest_rd_atomic,
+                                     static_cast<std::uint8_t>(port_info.active_mtu), gid};
+        const queue_pair_info b_info{_b.queue_pair_number(), b_psn, port_info.lid,
+                                     limits.max_rd_atomic, limits.max_dest_rd_atomic,
+                                     static_cast<std::uint8_t>(port_info.active_mtu), gid};
+
+        // --mtu caps the path MTU below the port's active MTU.
+        connection_parameters params;
+
+        if (_opts.mtu > 0)
+            params.max_path_mtu = mtu_from_bytes(_opts.mtu);
+
+        const auto path_mtu = negotiate_path_mtu(port_info.active_mtu, b_info, params);
+
+        constexpr auto pkey_index = 0;
+        change_queue_pair_state_to_init(_a, _opts.port_number, pkey_index, loopback_access_flags);
+        change_queue_pair_state_to_init(_b, _opts.port_number, pkey_index, loopback_access_flags);
+
+        change_queue_pair_state_to_rtr(_a, b_info, _opts.port_number, _opts.gid_index,
+                                       grh_required, limits.max_dest_rd_atomic, path_mtu, params);
+        change_queue_pair_state_to_rtr(_b, a_info, _opts.port_number, _opts.gid_index,
+                                       grh_required, limits.max_dest_rd_atomic, path_mtu, params);
+
+        change_queue_pair_state_to_rts(_a, a_psn, limits.max_rd_atomic, params);
+        change_queue_pair_state_to_rts(_b, b_psn, limits.max_rd_atomic, params);
+    }
+
+    // Two RC queue pairs on the same device that are connected to each other.
+    // Each queue pair has its own completion queue so that the sender's and the
+    // receiver's completions can be drained independently. The receiver's completion
+    // queue is attached to an event channel so that blocking waits can be measured.
+    // Running against Soft-RoCE (rxe) allows the wrappers to be measured on a single host.
+    class loopback
+    {
+    public:
+        loopback(const options& _opts, const loopback_config& _config)
+            : devices_{}
+            , context_{devices_[_opts.device_index]}
+            , pd_{context_}
+            , receiver_evt_ch_{context_}
+            , sender_cq_{_config.cqe_size, context_}
+            , receiver_cq_{_config.cqe_size, receiver_evt_ch_}
+            , sender_attrs_{make_queue_pair_init_attributes(sender_cq_, _config)}
+            , receiver_attrs_{make_queue_pair_init_attributes(receiver_cq_, _config)}
+            , sender_{pd_, sender_attrs_, sender_cq_}
+            , receiver_{pd_, receiver_attrs_, receiver_cq_}
+        {
+            connect_loopback_queue_pairs(context_, sender_, receiver_, _opts);
+        }
+
+        loopback(const loopback&) = delete;
+        auto operator=(const loopback&) -> loopback& = delete;
+
+        auto device_context() noexcept -> context& { return context_; }
+        auto pd() noexcept -> protection_domain& { return pd_; }
+        auto sender_cq() noexcept -> completion_queue& { return sender_cq_; }
+        auto receiver_cq() noexcept -> completion_queue& { return receiver_cq_; }
+        auto receiver_event_channel() noexcept -> completion_event_channel& { return receiver_evt_ch_; }
+        auto sender() noexcept -> queue_pair& { return sender_; }
+        auto receiver() noexcept -> queue_pair& { return receiver_; }
+
+    private:
+        device_list devices_;
+        context context_;
+        protection_domain pd_;
+        completion_event_channel receiver_evt_ch_;
+        completion_queue sender_cq_;
+        completion_queue receiver_cq_;
+        ibv_qp_init_attr sender_attrs_;
+        ibv_qp_init_attr receiver_attrs_;
+        queue_pair sender_;
+        queue_pair receiver_;
+    }; // class loopback
+
+    // Non-blocking. Polls up to _max completions from the completion queue and
+    // returns the number of completions reaped. Unsuccessful completions are
+    // treated as fatal for the benchmark.
+    inline auto poll_completions(const completion_queue& _cq, int _max) -> int
+    {
+        constexpr int poll_batch_size = 32;
+        ibv_wc wcs[poll_batch_size];
+
+        int total = 0;
+
+        while (total < _max) {
+            const auto n = _cq.poll(wcs, std::min(poll_batch_size, _max - total));
+
+            for (int i = 0; i < n; ++i) {
+                if (wcs[i].status != IBV_WC_SUCCESS)
+                    throw std::runtime_error{ibv_wc_status_str(wcs[i].status)};
+            }
+
+            total += n;
+
+            if (n < poll_batch_size)
+                break;
+        }
+
+        return total;
+    }
+
+    // Non-blocking. Drains the send completion queue of a QP that uses selective
+    // signaling and reclaims the send queue slots covered by its completions.
+    // Returns the number of slots reclaimed. Unsuccessful completions are thrown
+    // as std::runtime_error.
+    inline auto reclaim_send_slots(const completion_queue& _cq, queue_pair& _qp) -> std::uint32_t
+    {
+        constexpr int poll_batch_size = 32;
+        ibv_wc wcs[poll_batch_size];
+
+        std::uint32_t reclaimed = 0;
+        int n = 0;
+
+        do {
+            n = _cq.poll(wcs, poll_batch_size);
+
+            for (int i = 0; i < n; ++i) {
+                reclaimed += _qp.on_send_completion(wcs[i]);
+
+                if (wcs[i].status != IBV_WC_SUCCESS)
+                    throw std::runtime_error{ibv_wc_status_str(wcs[i].status)};
+            }
+        }
+        while (n == poll_batch_size);
+
+        return reclaimed;
+    }
+
+    // Blocks (busy-polls) until exactly _count completions have been reaped.
+    inline auto wait_for_completions(const completion_queue& _cq, std::size_t _count) -> void
+    {
+        while (_count > 0)
+            _count -= poll_completions(_cq, static_cast<int>(std::min<std::size_t>(_count, 1 << 20)));
+    }
+
+    class stopwatch
+    {
+    public:
+        stopwatch()
+            : start_{std::chrono::steady_clock::now()}
+        {
+        }
+
+        auto elapsed_seconds() const -> double
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    }; // class stopwatch
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_COMMON_HPP
@@ -0,0 +1,101 @@
+#ifndef KDD_RDMA_BENCHMARK_COMPLETION_POLLING_HPP
+#define KDD_RDMA_BENCHMARK_COMPLETION_POLLING_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma::benchmark
+{
+    // Measures the rate at which receive completions are drained and dispatched
+    // through completion_queue::poll_and_dispatch() when polling 1, 16 or 64
+    // completions per call. Receives are tagged for one of several handlers to
+    // emulate many QPs sharing a completion queue.
+    inline auto run_completion_polling(const options& _opts) -> void
+    {
+        constexpr std::size_t queue_depth = 256;
+        constexpr std::uint16_t handler_count = 8;
+
+        loopback_config config;
+        config.max_send_wr = queue_depth;
+        config.max_recv_wr = queue_depth;
+        config.cqe_size = queue_depth;
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> send_buffer(queue_depth * _opts.message_size);
+        std::vector<std::uint8_t> recv_buffer(queue_depth * _opts.message_size);
+        memory_region send_mr{lb.pd(), send_buffer, loopback_access_flags};
+        memory_region recv_mr{lb.pd(), recv_buffer, loopback_access_flags};
+
+        std::vector<buffer_descriptor> sends;
+        std::vector<buffer_descriptor> recvs;
+
+        for (std::size_t i = 0; i < queue_depth; ++i) {
+            const auto offset = i * _opts.message_size;
+            const auto length = static_cast<std::uint32_t>(_opts.message_size);
+            const auto tag = static_cast<std::uint16_t>(i % handler_count);
+            sends.push_back(make_buffer_descriptor(send_mr, offset, length, i));
+            recvs.push_back(make_buffer_descriptor(recv_mr, offset, length, make_work_request_id(tag, i)));
+        }
+
+        std::vector<std::size_t> dispatched(handler_count);
+
+        for (std::uint16_t tag = 0; tag < handler_count; ++tag) {
+            lb.receiver_cq().set_handler(tag, [&dispatched, tag](const ibv_wc& _wc) {
+                if (_wc.status != IBV_WC_SUCCESS)
+                    throw std::runtime_error{ibv_wc_status_str(_wc.status)};
+
+                ++dispatched[tag];
+            });
+        }
+
+        std::vector<ibv_wc> wcs(64);
+
+        report r{std::cout, _opts.format, {"test", "poll_batch_size", "message_size", "completions", "seconds", "completions_per_second"}};
+
+        for (const int poll_batch_size : {1, 16, 64}) {
+            std::fill(std::begin(dispatched), std::end(dispatched), 0);
+
+            std::size_t posted = 0;
+            std::size_t outstanding = 0;
+            std::size_t send_outstanding = 0;
+            std::size_t completed = 0;
+
+            const stopwatch sw;
+
+            while (completed < _opts.iterations) {
+                const auto n = std::min({queue_depth - outstanding,
+                                         queue_depth - send_outstanding,
+                                         _opts.iterations - posted});
+
+                if (n > 0) {
+                    lb.receiver().post_receive(recvs.data(), n);
+                    lb.sender().post_send(sends.data(), n);
+                    posted += n;
+                    outstanding += n;
+                    send_outstanding += n;
+                }
+
+                const auto received = lb.receiver_cq().poll_and_dispatch(wcs.data(), poll_batch_size);
+                outstanding -= received;
+                completed += received;
+
+                // Every send is signaled. Drain them so the send queue can be refilled.
+                send_outstanding -= poll_completions(lb.sender_cq(), static_cast<int>(send_outstanding));
+            }
+
+            wait_for_completions(lb.sender_cq(), send_outstanding);
+
+            const auto seconds = sw.elapsed_seconds();
+
+            r.row("completion_polling", poll_batch_size, _opts.message_size, completed, seconds, completed / seconds);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_COMPLETION_POLLING_HPP
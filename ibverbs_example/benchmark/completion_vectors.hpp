@@ -0,0 +1,198 @@
+#ifndef KDD_RDMA_BENCHMARK_COMPLETION_VECTORS_HPP
+#define KDD_RDMA_BENCHMARK_COMPLETION_VECTORS_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // One thread's pair of connected QPs. The receiver's completion queue is
+    // signaled through completion vector _comp_vector.
+    class vector_stream
+    {
+    public:
+        vector_stream(const context& _ctx, const protection_domain& _pd, const options& _opts,
+                      const loopback_config& _config, int _comp_vector)
+            : evt_ch_{_ctx}
+            , sender_cq_{_config.cqe_size, _ctx}
+            , receiver_cq_{_config.cqe_size, evt_ch_, _comp_vector}
+            , sender_attrs_{make_queue_pair_init_attributes(sender_cq_, _config)}
+            , receiver_attrs_{make_queue_pair_init_attributes(receiver_cq_, _config)}
+            , sender_{_pd, sender_attrs_, sender_cq_}
+            , receiver_{_pd, receiver_attrs_, receiver_cq_}
+        {
+            connect_loopback_queue_pairs(_ctx, sender_, receiver_, _opts);
+
+            // Always sleep on the event channel, so every wait goes through the interrupt.
+            receiver_cq_.set_spin_budget(std::chrono::nanoseconds{0});
+        }
+
+        vector_stream(const vector_stream&) = delete;
+        auto operator=(const vector_stream&) -> vector_stream& = delete;
+
+        // Streams _messages sends with at most _depth in flight and waits for each
+        // batch of receives on the event channel.
+        auto run(const memory_region& _mr, std::uint32_t _length, std::uint32_t _depth, std::size_t _messages) -> void
+        {
+            std::vector<buffer_descriptor> sends(_depth);
+            std::vector<buffer_descriptor> recvs(_depth);
+
+            for (std::uint32_t i = 0; i < _depth; ++i) {
+                sends[i] = make_buffer_descriptor(_mr, 0, _length, i);
+                recvs[i] = make_buffer_descriptor(_mr, i * _length, _length, i);
+            }
+
+            std::size_t recv_posted = std::min<std::size_t>(_depth, _messages);
+            receiver_.post_receive(recvs.data(), recv_posted);
+
+            std::size_t sent = 0;
+            std::size_t send_completed = 0;
+            std::size_t received = 0;
+
+            constexpr int poll_batch_size = 32;
+            ibv_wc wcs[poll_batch_size];
+
+            while (received < _messages) {
+                const auto n = std::min(recv_posted - sent, _depth - (sent - send_completed));
+
+                if (n > 0) {
+                    sender_.post_send(sends.data(), n);
+                    sent += n;
+                }
+
+                send_completed += poll_completions(sender_cq_, static_cast<int>(_depth));
+
+                // With nothing in flight, only send completions can free up the send queue.
+                if (received == sent)
+                    continue;
+
+                const auto r = receiver_cq_.wait(wcs, poll_batch_size);
+
+                for (int i = 0; i < r; ++i) {
+                    if (wcs[i].status != IBV_WC_SUCCESS)
+                        throw std::runtime_error{ibv_wc_status_str(wcs[i].status)};
+                }
+
+                received += r;
+
+                if (const auto to_post = std::min<std::size_t>(r, _messages - recv_posted); to_post > 0) {
+                    receiver_.post_receive(recvs.data(), to_post);
+                    recv_posted += to_post;
+                }
+            }
+        }
+
+        auto blocking_waits() const noexcept -> std::uint64_t
+        {
+            return receiver_cq_.statistics().blocking_waits;
+        }
+
+    private:
+        completion_event_channel evt_ch_;
+        completion_queue sender_cq_;
+        completion_queue receiver_cq_;
+        ibv_qp_init_attr sender_attrs_;
+        ibv_qp_init_attr receiver_attrs_;
+        queue_pair sender_;
+        queue_pair receiver_;
+    }; // class vector_stream
+
+    // Runs one event-driven stream per thread, up to one thread per completion vector
+    // of the device (at most 16), and spreads the receivers' completion queues
+    // round-robin over 1, 2, 4, ... vectors. Each thread is pinned to a core near its
+    // queue's vector. With a single vector, every interrupt is taken by the same core.
+    // Reports the aggregate message rate of --iterations messages of --size bytes.
+    inline auto run_completion_vectors(const options& _opts) -> void
+    {
+        device_list devices;
+        context ctx{devices[_opts.device_index]};
+        protection_domain pd{ctx};
+
+        const auto device_name = devices[_opts.device_index].name();
+        const auto max_vectors = std::min(ctx.num_completion_vectors(), 16);
+        const auto threads = static_cast<std::size_t>(max_vectors);
+
+        const auto depth = static_cast<std::uint32_t>(_opts.queue_depth);
+        const auto length = static_cast<std::uint32_t>(_opts.message_size);
+        const auto messages_per_thread = std::max<std::size_t>(1, _opts.iterations / threads);
+
+        loopback_config config;
+        config.max_send_wr = depth;
+        config.max_recv_wr = depth;
+        config.cqe_size = static_cast<int>(depth);
+
+        report r{std::cout, _opts.format, {"test", "vectors", "threads", "message_size", "messages",
+                                           "seconds", "messages_per_second", "blocking_waits"}};
+
+        std::vector<int> vector_counts;
+
+        for (int v = 1; v < max_vectors; v *= 2)
+            vector_counts.push_back(v);
+
+        vector_counts.push_back(max_vectors);
+
+        for (const auto vectors : vector_counts) {
+            completion_vector_allocator allocator{ctx, vectors};
+
+            std::vector<std::unique_ptr<std::vector<std::uint8_t>>> buffers;
+            std::vector<std::unique_ptr<memory_region>> mrs;
+            std::vector<std::unique_ptr<vector_stream>> streams;
+            std::vector<int> cpus;
+
+            for (std::size_t t = 0; t < threads; ++t) {
+                const auto vector = allocator.next();
+
+                buffers.push_back(std::make_unique<std::vector<std::uint8_t>>(std::size_t{depth} * std::max<std::uint32_t>(1, length)));
+                mrs.push_back(std::make_unique<memory_region>(pd, *buffers.back(), loopback_access_flags));
+                streams.push_back(std::make_unique<vector_stream>(ctx, pd, _opts, config, vector));
+                cpus.push_back(cpu_for_completion_vector(device_name, vector));
+            }
+
+            std::vector<std::exception_ptr> errors(threads);
+            std::vector<std::thread> workers;
+
+            const stopwatch sw;
+
+            for (std::size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    try {
+                        pin_current_thread(cpus[t]);
+                        streams[t]->run(*mrs[t], length, depth, messages_per_thread);
+                    }
+                    catch (...) {
+                        errors[t] = std::current_exception();
+                    }
+                });
+            }
+
+            for (auto& w : workers)
+                w.join();
+
+            const auto seconds = sw.elapsed_seconds();
+
+            for (const auto& e : errors) {
+                if (e)
+                    std::rethrow_exception(e);
+            }
+
+            std::uint64_t blocking_waits = 0;
+
+            for (const auto& s : streams)
+                blocking_waits += s->blocking_waits();
+
+            const auto messages = messages_per_thread * threads;
+            r.row("completion_vectors", vectors, threads, length, messages, seconds, messages / seconds, blocking_waits);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_COMPLETION_VECTORS_HPP
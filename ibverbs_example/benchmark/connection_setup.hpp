@@ -0,0 +1,172 @@
+#ifndef KDD_RDMA_BENCHMARK_CONNECTION_SETUP_HPP
+#define KDD_RDMA_BENCHMARK_CONNECTION_SETUP_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // How the out-of-band information of the QPs travels between the two sides.
+    enum class setup_mode
+    {
+        reconnect,  // A new TCP connection for the exchange and another for the sync of every QP.
+        persistent, // One control channel, one exchange and one sync per QP.
+        batched     // One control channel, one exchange and one sync for all QPs.
+    };
+
+    inline constexpr auto to_string(setup_mode _mode) noexcept -> const char*
+    {
+        switch (_mode) {
+            case setup_mode::reconnect:  return "reconnect";
+            case setup_mode::persistent: return "persistent";
+            case setup_mode::batched:    return "batched";
+            default:                     return "?";
+        }
+    }
+
+    // Establishes --connections RC QP pairs between a client and a server thread of
+    // this process, exchanging their information over TCP on --control-port. The
+    // "reconnect" mode is how main.cpp connected its QP before control_channel
+    // existed. Each side creates its QPs, moves them to INIT, exchanges their
+    // information, moves them to RTS and syncs with the other side. Reports the
+    // number of QPs the client established per second.
+    inline auto run_connection_setup(const options& _opts) -> void
+    {
+        const auto connections = _opts.connections;
+
+        device_list devices;
+        context ctx{devices[_opts.device_index]};
+        protection_domain pd{ctx};
+
+        const auto port_info = ctx.port_info(_opts.port_number);
+        const auto grh_required = (port_info.flags & IBV_QPF_GRH_REQUIRED) == IBV_QPF_GRH_REQUIRED;
+        const auto gid = ctx.gid(_opts.port_number, _opts.gid_index);
+        const auto limits = query_atomic_limits(ctx);
+
+        // Bound up front, so the client never races the server to the port.
+        control_listener listener{_opts.control_port};
+
+        report r{std::cout, _opts.format, {"test", "mode", "queue_pairs", "seconds", "queue_pairs_per_second"}};
+
+        for (const auto mode : {setup_mode::reconnect, setup_mode::persistent, setup_mode::batched}) {
+            auto establish = [&](bool _is_server, double& _seconds) {
+                completion_queue cq{1, ctx};
+                loopback_config config;
+
+                std::vector<std::unique_ptr<queue_pair>> qps;
+                std::vector<connection_setup> setups(connections);
+                std::vector<std::uint32_t> psns(connections);
+
+                const stopwatch sw;
+
+                for (std::size_t i = 0; i < connections; ++i) {
+                    auto attrs = make_queue_pair_init_attributes(cq, config);
+                    qps.push_back(std::make_unique<queue_pair>(pd, attrs, cq));
+
+                    constexpr auto pkey_index = 0;
+                    change_queue_pair_state_to_init(*qps.back(), _opts.port_number, pkey_index, loopback_access_flags);
+
+                    psns[i] = generate_random_int();
+                    setups[i] = {{qps.back()->queue_pair_number(), psns[i], port_info.lid,
+                                  limits.max_rd_atomic, limits.max_dest_rd_atomic,
+                                  static_cast<std::uint8_t>(port_info.active_mtu), gid}, {}};
+                }
+
+                // Expects the peer's information in setups[_first, _first + _count).
+                auto connect = [&](std::size_t _first, std::size_t _count) {
+                    for (auto i = _first; i < _first + _count; ++i) {
+                        const auto negotiated = negotiate_atomic_limits(limits, setups[i].qp);
+                        const auto path_mtu = negotiate_path_mtu(port_info.active_mtu, setups[i].qp);
+                        change_queue_pair_state_to_rtr(*qps[i], setups[i].qp, _opts.port_number, _opts.gid_index,
+                                                       grh_required, negotiated.max_dest_rd_atomic, path_mtu);
+                        change_queue_pair_state_to_rts(*qps[i], psns[i], negotiated.max_rd_atomic);
+                    }
+                };
+
+                auto open_channel = [&] {
+                    return _is_server ? std::make_unique<control_channel>(listener)
+                                      : std::make_unique<control_channel>("127.0.0.1", _opts.control_port);
+                };
+
+                switch (mode) {
+                    case setup_mode::reconnect:
+                        for (std::size_t i = 0; i < connections; ++i) {
+                            open_channel()->exchange(&setups[i], 1);
+                            connect(i, 1);
+                            open_channel()->sync();
+                        }
+                        break;
+
+                    case setup_mode::persistent: {
+                        const auto channel = open_channel();
+
+                        for (std::size_t i = 0; i < connections; ++i) {
+                            channel->exchange(&setups[i], 1);
+                            connect(i, 1);
+                            channel->sync();
+                        }
+                        break;
+                    }
+
+                    case setup_mode::batched: {
+                        const auto channel = open_channel();
+                        channel->exchange(setups);
+                        connect(0, connections);
+                        channel->sync();
+                        break;
+                    }
+                }
+
+                // Destroying the QPs is not part of the measurement.
+                _seconds = sw.elapsed_seconds();
+            };
+
+            double server_seconds = 0;
+            std::exception_ptr server_error;
+
+            std::thread server{[&] {
+                try {
+                    establish(true, server_seconds);
+                }
+                catch (...) {
+                    server_error = std::current_exception();
+                }
+            }};
+
+            double client_seconds = 0;
+
+            try {
+                establish(false, client_seconds);
+            }
+            catch (...) {
+                // The server may be waiting for the client to connect. Connecting and
+                // hanging up makes its next read fail.
+                try {
+                    control_channel{"127.0.0.1", _opts.control_port};
+                }
+                catch (const std::exception&) {
+                }
+
+                server.join();
+                throw;
+            }
+
+            server.join();
+
+            if (server_error)
+                std::rethrow_exception(server_error);
+
+            r.row("connection_setup", to_string(mode), connections, client_seconds, connections / client_seconds);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_CONNECTION_SETUP_HPP
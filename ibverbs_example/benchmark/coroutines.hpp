@@ -0,0 +1,108 @@
+#ifndef KDD_RDMA_BENCHMARK_COROUTINES_HPP
+#define KDD_RDMA_BENCHMARK_COROUTINES_HPP
+
+#include "common.hpp"
+#include "../coroutine.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Issues --iterations RDMA WRITEs and READs of --size bytes, first blocking on
+    // every operation like the examples do (one operation in flight per thread),
+    // then from --queue-depth coroutines resumed by a single completion_poller on
+    // the same thread. Reports the operation rate of both.
+    inline auto run_coroutines(const options& _opts) -> void
+    {
+        const auto depth = static_cast<std::uint32_t>(_opts.queue_depth);
+        const auto length = static_cast<std::uint32_t>(_opts.message_size);
+
+        loopback_config config;
+        config.max_send_wr = depth;
+        config.cqe_size = static_cast<int>(depth);
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> local_buffer(std::size_t{depth} * length);
+        std::vector<std::uint8_t> remote_buffer(std::size_t{depth} * length);
+        memory_region local_mr{lb.pd(), local_buffer, loopback_access_flags};
+        memory_region remote_mr{lb.pd(), remote_buffer, loopback_access_flags};
+
+        const auto remote = remote_mr.remote_descriptor();
+
+        completion_poller poller{lb.sender_cq()};
+        async_queue_pair aqp{lb.sender(), poller};
+
+        report r{std::cout, _opts.format, {"test", "operation", "mode", "in_flight", "message_size",
+                                           "operations", "seconds", "operations_per_second"}};
+
+        for (const bool is_read : {false, true}) {
+            const auto operation = is_read ? "read" : "write";
+
+            {
+                const auto local = make_buffer_descriptor(local_mr, 0, length);
+                const stopwatch sw;
+
+                for (std::size_t i = 0; i < _opts.iterations; ++i) {
+                    if (is_read)
+                        lb.sender().post_read(local, remote, 0);
+                    else
+                        lb.sender().post_write(local, remote, 0);
+
+                    wait_for_completions(lb.sender_cq(), 1);
+                }
+
+                const auto seconds = sw.elapsed_seconds();
+                r.row("coroutines", operation, "blocking", 1, length, _opts.iterations, seconds, _opts.iterations / seconds);
+            }
+
+            {
+                // Each coroutine works on its own slot of both buffers.
+                auto worker = [&](std::uint32_t _slot, std::size_t _operations) -> task<> {
+                    const auto local = make_buffer_descriptor(local_mr, _slot * length, length);
+
+                    for (std::size_t i = 0; i < _operations; ++i) {
+                        if (is_read)
+                            co_await aqp.read(local, remote, _slot * length);
+                        else
+                            co_await aqp.write(local, remote, _slot * length);
+                    }
+                };
+
+                std::vector<task<>> tasks;
+                tasks.reserve(depth);
+
+                const stopwatch sw;
+
+                for (std::uint32_t slot = 0; slot < depth; ++slot) {
+                    const auto operations = _opts.iterations * (slot + 1) / depth - _opts.iterations * slot / depth;
+                    tasks.push_back(worker(slot, operations));
+                    tasks.back().start();
+                }
+
+                const auto all_done = [&tasks] {
+                    return std::all_of(tasks.begin(), tasks.end(), [](const task<>& _t) { return _t.done(); });
+                };
+
+                while (!all_done()) {
+                    // Completions are reaped in batches between the checks.
+                    for (int i = 0; i < 64; ++i)
+                        poller.poll();
+                }
+
+                const auto seconds = sw.elapsed_seconds();
+
+                for (auto& t : tasks)
+                    t.result();
+
+                r.row("coroutines", operation, "coroutine", depth, length, _opts.iterations, seconds, _opts.iterations / seconds);
+            }
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_COROUTINES_HPP
@@ -0,0 +1,136 @@
+#ifndef KDD_RDMA_BENCHMARK_ENGINE_HPP
+#define KDD_RDMA_BENCHMARK_ENGINE_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // The state of one worker's stream. Only touched on the worker's thread.
+    struct engine_stream
+    {
+        queue_pair* sender;
+        queue_pair* receiver;
+        buffer_descriptor message;
+        std::vector<buffer_descriptor> recvs;
+        std::size_t sent;
+        std::size_t send_completed;
+        std::size_t received;
+    };
+
+    // Streams --iterations messages of --size bytes per worker through an
+    // rdma::engine with 1, 2, 4, ... workers, up to one per core of the device's
+    // NUMA node (at most 16). Every worker owns a connected pair of QPs, keeps
+    // --queue-depth messages in flight and re-posts its receives from its own
+    // buffer pool, all from its completion handler. Reports the aggregate message
+    // rate for each worker count.
+    inline auto run_engine(const options& _opts) -> void
+    {
+        device_list devices;
+        context ctx{devices[_opts.device_index]};
+        protection_domain pd{ctx};
+
+        const auto depth = static_cast<std::uint32_t>(_opts.queue_depth);
+        const auto length = static_cast<std::uint32_t>(_opts.message_size);
+        const auto messages = std::max<std::size_t>(1, _opts.iterations);
+
+        const auto cores = device_local_cpus(devices[_opts.device_index].name()).size();
+        const auto max_workers = std::min<std::size_t>(16, std::max<std::size_t>(1, cores));
+
+        loopback_config config;
+        config.max_send_wr = depth;
+        config.max_recv_wr = depth;
+
+        report r{std::cout, _opts.format, {"test", "workers", "message_size", "messages",
+                                           "seconds", "messages_per_second"}};
+
+        std::vector<std::size_t> worker_counts;
+
+        for (std::size_t w = 1; w < max_workers; w *= 2)
+            worker_counts.push_back(w);
+
+        worker_counts.push_back(max_workers);
+
+        for (const auto workers : worker_counts) {
+            engine_config ec;
+            ec.workers = workers;
+            ec.cqe_size = static_cast<int>(2 * depth);
+            ec.buffer_classes = {{std::max<std::uint32_t>(64, length), depth + 1}};
+            ec.access_flags = loopback_access_flags;
+
+            engine eng{ctx, pd, ec};
+
+            std::vector<engine_stream> streams(workers);
+            std::atomic<std::size_t> done{0};
+
+            for (std::size_t i = 0; i < workers; ++i) {
+                auto& w = eng.assign();
+                auto& s = streams[w.index()];
+
+                s.sender = &w.create_queue_pair(make_queue_pair_init_attributes(w.cq(), config));
+                s.receiver = &w.create_queue_pair(make_queue_pair_init_attributes(w.cq(), config));
+                connect_loopback_queue_pairs(ctx, *s.sender, *s.receiver, _opts);
+
+                const auto to_descriptor = [length](const pooled_buffer& _b, std::uint64_t _wr_id) {
+                    return buffer_descriptor{_wr_id, _b.data, length, _b.local_key};
+                };
+
+                s.message = to_descriptor(w.pool().allocate(length), 0);
+
+                for (std::uint32_t j = 0; j < depth; ++j)
+                    s.recvs.push_back(to_descriptor(w.pool().allocate(length), j));
+
+                s.receiver->post_receive(s.recvs);
+
+                // Never sends more than the receiver has posted, nor more than fit in
+                // the send queue.
+                const auto try_send = [depth, messages](engine_stream& _s) {
+                    while (_s.sent < messages && _s.sent < depth + _s.received && _s.sent - _s.send_completed < depth) {
+                        _s.sender->post_send(&_s.message, 1);
+                        ++_s.sent;
+                    }
+                };
+
+                w.set_completion_handler([&s, &done, try_send, messages](engine_worker&, const ibv_wc& _wc) {
+                    if (_wc.status != IBV_WC_SUCCESS)
+                        throw std::runtime_error{ibv_wc_status_str(_wc.status)};
+
+                    if (_wc.opcode & IBV_WC_RECV) {
+                        s.receiver->post_receive(&s.recvs[_wc.wr_id], 1);
+
+                        if (++s.received == messages)
+                            done.fetch_add(1, std::memory_order_release);
+                    }
+                    else {
+                        ++s.send_completed;
+                    }
+
+                    try_send(s);
+                });
+
+                eng.run_on(w.index(), [&s, try_send](engine_worker&) { try_send(s); });
+            }
+
+            const stopwatch sw;
+            eng.start();
+
+            // stop() rethrows the error of a failed worker.
+            while (done.load(std::memory_order_acquire) < workers && !eng.failed())
+                std::this_thread::yield();
+
+            const auto seconds = sw.elapsed_seconds();
+            eng.stop();
+
+            r.row("engine", workers, length, messages * workers, seconds, messages * workers / seconds);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_ENGINE_HPP
@@ -0,0 +1,147 @@
+#ifndef KDD_RDMA_BENCHMARK_FLOW_CONTROL_HPP
+#define KDD_RDMA_BENCHMARK_FLOW_CONTROL_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Streams --iterations messages of --size bytes with up to --queue-depth messages
+    // in flight to a slow receiver, which posts only a quarter of that many receives
+    // and re-posts at most 8 of them per polling round. In the "rnr" mode the sender
+    // posts plain sends and every send that finds no receive waits out an RNR NAK.
+    // In the "credits" mode both sides use a credit_flow_control and the sender
+    // queues messages locally instead. Reports the message rate, the credit stalls
+    // and updates, and the change of the device's RNR NAK counter (-1 if the driver
+    // does not expose one).
+    inline auto run_flow_control(const options& _opts) -> void
+    {
+        const auto window = static_cast<std::uint32_t>(std::max<std::size_t>(8, _opts.queue_depth));
+        const auto receives = std::max<std::uint32_t>(2, window / 4);
+        const auto length = static_cast<std::uint32_t>(_opts.message_size);
+        const auto iterations = _opts.iterations;
+
+        // The sender's receives, which only ever hold credit updates.
+        constexpr std::uint32_t update_receives = 8;
+        constexpr std::size_t max_reposts_per_round = 8;
+
+        loopback_config config;
+        config.max_send_wr = 2 * window;
+        config.max_recv_wr = std::max(receives, update_receives);
+        config.cqe_size = static_cast<int>(4 * window);
+
+        report r{std::cout, _opts.format, {"test", "mode", "message_size", "queue_depth", "receives", "messages",
+                                           "seconds", "messages_per_second", "credit_stalls", "credit_updates",
+                                           "max_queued", "rnr_naks"}};
+
+        for (const bool use_credits : {false, true}) {
+            loopback lb{_opts, config};
+
+            std::vector<std::uint8_t> buffer((1 + receives) * std::max<std::uint32_t>(1, length));
+            memory_region mr{lb.pd(), buffer, loopback_access_flags};
+
+            const auto message = make_buffer_descriptor(mr, 0, length);
+            std::vector<buffer_descriptor> recvs(receives);
+            std::vector<buffer_descriptor> updates(update_receives);
+
+            for (std::uint32_t i = 0; i < receives; ++i)
+                recvs[i] = make_buffer_descriptor(mr, (1 + i) * length, length, i);
+
+            for (std::uint32_t i = 0; i < update_receives; ++i)
+                updates[i] = make_buffer_descriptor(mr, 0, 0, i);
+
+            lb.receiver().post_receive(recvs);
+
+            std::unique_ptr<credit_flow_control> sender_fc;
+            std::unique_ptr<credit_flow_control> receiver_fc;
+
+            if (use_credits) {
+                lb.sender().post_receive(updates);
+                sender_fc = std::make_unique<credit_flow_control>(lb.sender(), receives, update_receives,
+                                                                  update_receives / 2);
+                receiver_fc = std::make_unique<credit_flow_control>(lb.receiver(), update_receives, receives,
+                                                                    std::max<std::uint32_t>(1, receives / 4));
+            }
+
+            const auto rnr_before = read_rnr_nak_counter(lb.device_context(), _opts.port_number);
+
+            std::size_t sent = 0;
+            std::size_t completed = 0;
+            std::size_t received = 0;
+            std::deque<std::uint64_t> consumed; // Receives waiting to be re-posted.
+            std::vector<buffer_descriptor> reposts;
+
+            constexpr int poll_batch_size = 32;
+            ibv_wc wcs[poll_batch_size];
+
+            const stopwatch sw;
+
+            while (received < iterations) {
+                for (; sent < iterations && sent - completed < window; ++sent) {
+                    if (use_credits)
+                        sender_fc->send(message);
+                    else
+                        lb.sender().post_send(&message, 1);
+                }
+
+                for (int i = 0, n = lb.sender_cq().poll(wcs, poll_batch_size); i < n; ++i) {
+                    if (wcs[i].status != IBV_WC_SUCCESS)
+                        throw std::runtime_error{ibv_wc_status_str(wcs[i].status)};
+
+                    if (wcs[i].opcode & IBV_WC_RECV) {
+                        sender_fc->on_receive(wcs[i]);
+                        sender_fc->post_receive(&updates[wcs[i].wr_id], 1);
+                    }
+                    else if (wcs[i].wr_id != credit_flow_control::credit_update_wr_id) {
+                        ++completed;
+                    }
+                }
+
+                for (int i = 0, n = lb.receiver_cq().poll(wcs, poll_batch_size); i < n; ++i) {
+                    if (wcs[i].status != IBV_WC_SUCCESS)
+                        throw std::runtime_error{ibv_wc_status_str(wcs[i].status)};
+
+                    if (!(wcs[i].opcode & IBV_WC_RECV))
+                        continue;
+
+                    if (!use_credits || receiver_fc->on_receive(wcs[i]))
+                        ++received;
+
+                    consumed.push_back(wcs[i].wr_id);
+                }
+
+                // The slow consumer.
+                reposts.clear();
+
+                while (!consumed.empty() && reposts.size() < max_reposts_per_round) {
+                    reposts.push_back(recvs[consumed.front()]);
+                    consumed.pop_front();
+                }
+
+                if (use_credits)
+                    receiver_fc->post_receive(reposts.data(), reposts.size());
+                else
+                    lb.receiver().post_receive(reposts);
+            }
+
+            const auto seconds = sw.elapsed_seconds();
+            const auto rnr_after = read_rnr_nak_counter(lb.device_context(), _opts.port_number);
+            const auto rnr_naks = rnr_before && rnr_after ? static_cast<std::int64_t>(*rnr_after - *rnr_before) : -1;
+
+            const auto counters = use_credits ? sender_fc->counters() : flow_control_counters{};
+            const auto updates_sent = use_credits ? counters.credit_updates + receiver_fc->counters().credit_updates : 0;
+
+            r.row("flow_control", use_credits ? "credits" : "rnr", length, window, receives, iterations, seconds,
+                  iterations / seconds, counters.credit_stalls, updates_sent, counters.max_queued, rnr_naks);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_FLOW_CONTROL_HPP
@@ -0,0 +1,95 @@
+#ifndef KDD_RDMA_BENCHMARK_HUGE_PAGES_HPP
+#define KDD_RDMA_BENCHMARK_HUGE_PAGES_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // For each page size, registers a large region and measures the registration
+    // time. Then streams sends gathered from random offsets across the region, so
+    // that the NIC has to translate addresses all over the registration. The
+    // receiver writes into a small region that always stays in the translation cache.
+    inline auto run_huge_pages(const options& _opts) -> void
+    {
+        constexpr std::size_t queue_depth = 128;
+
+        loopback_config config;
+        config.max_send_wr = queue_depth;
+        config.max_recv_wr = queue_depth;
+        config.cqe_size = queue_depth;
+
+        loopback lb{_opts, config};
+
+        const auto length = static_cast<std::uint32_t>(_opts.message_size);
+
+        std::vector<std::uint8_t> recv_buffer(queue_depth * _opts.message_size);
+        memory_region recv_mr{lb.pd(), recv_buffer, loopback_access_flags};
+
+        std::vector<buffer_descriptor> recvs;
+        for (std::size_t i = 0; i < queue_depth; ++i)
+            recvs.push_back(make_buffer_descriptor(recv_mr, i * _opts.message_size, length, i));
+
+        report r{std::cout, _opts.format, {"test", "page_size", "backing", "region_size", "registration_seconds", "message_size",
+                                           "messages", "seconds", "messages_per_second", "bytes_per_second"}};
+
+        for (const auto ps : {page_size::normal, page_size::huge_2mb, page_size::huge_1gb}) {
+            huge_page_memory memory{_opts.region_size, ps};
+
+            const stopwatch reg_sw;
+            memory_region send_mr{lb.pd(), memory.data(), memory.size(), loopback_access_flags};
+            const auto registration_seconds = reg_sw.elapsed_seconds();
+
+            std::mt19937_64 gen{42};
+            std::uniform_int_distribution<std::size_t> distrib{0, memory.size() / _opts.message_size - 1};
+
+            std::vector<buffer_descriptor> sends(queue_depth);
+
+            std::size_t posted = 0;
+            std::size_t send_outstanding = 0;
+            std::size_t recv_outstanding = 0;
+            std::size_t completed = 0;
+
+            const stopwatch sw;
+
+            while (completed < _opts.iterations) {
+                const auto n = std::min({queue_depth - send_outstanding,
+                                         queue_depth - recv_outstanding,
+                                         _opts.iterations - posted});
+
+                if (n > 0) {
+                    for (std::size_t i = 0; i < n; ++i)
+                        sends[i] = make_buffer_descriptor(send_mr, distrib(gen) * _opts.message_size, length, i);
+
+                    lb.receiver().post_receive(recvs.data(), n);
+                    lb.sender().post_send(sends.data(), n);
+                    posted += n;
+                    send_outstanding += n;
+                    recv_outstanding += n;
+                }
+
+                send_outstanding -= poll_completions(lb.sender_cq(), static_cast<int>(send_outstanding));
+
+                const auto received = poll_completions(lb.receiver_cq(), static_cast<int>(recv_outstanding));
+                recv_outstanding -= received;
+                completed += received;
+            }
+
+            wait_for_completions(lb.sender_cq(), send_outstanding);
+
+            const auto seconds = sw.elapsed_seconds();
+            const char* page_size_names[] = {"normal", "huge_2mb", "huge_1gb"};
+
+            r.row("huge_pages", page_size_names[static_cast<int>(ps)], to_string(memory.backing()), memory.size(),
+                  registration_seconds, _opts.message_size, completed, seconds, completed / seconds,
+                  completed * _opts.message_size / seconds);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_HUGE_PAGES_HPP
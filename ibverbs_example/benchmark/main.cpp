@@ -0,0 +1,136 @@
+#include "common.hpp"
+#include "batch_posting.hpp"
+#include "selective_signaling.hpp"
+#include "completion_polling.hpp"
+#include "adaptive_wait.hpp"
+#include "registration_cache.hpp"
+#include "buffer_pool.hpp"
+#include "huge_pages.hpp"
+#include "perftest.hpp"
+#include "shared_receive_queue.hpp"
+#include "scatter_gather.hpp"
+#include "connection_setup.hpp"
+#include "mesh_setup.hpp"
+#include "flow_control.hpp"
+#include "completion_vectors.hpp"
+#include "engine.hpp"
+#include "coroutines.hpp"
+#include "asio_event_loop.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <map>
+#include <functional>
+
+namespace po = boost::program_options;
+
+auto main(int _argc, char* _argv[]) -> int
+{
+    const std::map<std::string, std::function<void(const rdma::benchmark::options&)>> benchmarks{
+        {"batch_posting", rdma::benchmark::run_batch_posting},
+        {"selective_signaling", rdma::benchmark::run_selective_signaling},
+        {"completion_polling", rdma::benchmark::run_completion_polling},
+        {"adaptive_wait", rdma::benchmark::run_adaptive_wait},
+        {"registration_cache", rdma::benchmark::run_registration_cache},
+        {"buffer_pool", rdma::benchmark::run_buffer_pool},
+        {"huge_pages", rdma::benchmark::run_huge_pages},
+        {"send_lat", rdma::benchmark::run_send_latency},
+        {"send_bw", rdma::benchmark::run_send_bandwidth},
+        {"mtu_bw", rdma::benchmark::run_mtu_bandwidth},
+        {"inline_lat", rdma::benchmark::run_inline_latency},
+        {"write_lat", rdma::benchmark::run_write_latency},
+        {"write_bw", rdma::benchmark::run_write_bandwidth},
+        {"read_lat", rdma::benchmark::run_read_latency},
+        {"read_bw", rdma::benchmark::run_read_bandwidth},
+        {"atomic_lat", rdma::benchmark::run_atomic_latency},
+        {"shared_receive_queue", rdma::benchmark::run_shared_receive_queue},
+        {"scatter_gather", rdma::benchmark::run_scatter_gather},
+        {"connection_setup", rdma::benchmark::run_connection_setup},
+        {"mesh_setup", rdma::benchmark::run_mesh_setup},
+        {"flow_control", rdma::benchmark::run_flow_control},
+        {"completion_vectors", rdma::benchmark::run_completion_vectors},
+        {"engine", rdma::benchmark::run_engine},
+        {"coroutines", rdma::benchmark::run_coroutines},
+        {"asio_event_loop", rdma::benchmark::run_asio_event_loop}
+    };
+
+    try {
+        po::options_description desc{"Options"};
+        desc.add_options()
+            ("test,t", po::value<std::string>()->default_value("batch_posting"), "The benchmark to run.")
+            ("device,d", po::value<int>()->default_value(0), "The index of the RDMA device to use.")
+            ("ib-port,i", po::value<int>()->default_value(1), "The port number of the RDMA device to use.")
+            ("gid-index,g", po::value<int>()->default_value(0), "The index of the GID to use.")
+            ("size,s", po::value<std::size_t>()->default_value(64), "The message size in bytes.")
+            ("iterations,n", po::value<std::size_t>()->default_value(100000), "The number of messages per measurement.")
+            ("region-size,r", po::value<std::size_t>()->default_value(std::size_t{256} << 20), "The size of large memory regions in bytes.")
+            ("queue-depth,q", po::value<std::size_t>()->default_value(128), "The number of work requests kept in flight by bandwidth tests.")
+            ("min-size", po::value<std::size_t>()->default_value(2), "The smallest message size swept by latency and bandwidth tests.")
+            ("max-size", po::value<std::size_t>()->default_value(std::size_t{8} << 20), "The largest message size swept by latency and bandwidth tests.")
+            ("connections,c", po::value<std::size_t>()->default_value(256), "The number of connections served by multi-connection tests.")
+            ("mtu", po::value<int>()->default_value(0), "The largest path MTU in bytes (256 to 4096). Zero uses the port's active MTU.")
+            ("control-port", po::value<std::string>()->default_value("18515"), "The local TCP port used by tests that exchange QP information out of band.")
+            ("format,f", po::value<std::string>()->default_value("csv"), "The output format (csv or json).")
+            ("list,l", po::bool_switch(), "List the available benchmarks.")
+            ("help", po::bool_switch(), "Show this message.");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(_argc, _argv, desc), vm);
+        po::notify(vm);
+
+        if (vm["help"].as<bool>()) {
+            std::cout << desc << '\n';
+            return 0;
+        }
+
+        if (vm["list"].as<bool>()) {
+            for (const auto& [name, _] : benchmarks)
+                std::cout << name << '\n';
+
+            return 0;
+        }
+
+        rdma::benchmark::options opts;
+        opts.device_index = vm["device"].as<int>();
+        opts.port_number = static_cast<std::uint8_t>(vm["ib-port"].as<int>());
+        opts.gid_index = vm["gid-index"].as<int>();
+        opts.message_size = vm["size"].as<std::size_t>();
+        opts.iterations = vm["iterations"].as<std::size_t>();
+        opts.region_size = vm["region-size"].as<std::size_t>();
+        opts.queue_depth = vm["queue-depth"].as<std::size_t>();
+        opts.min_message_size = vm["min-size"].as<std::size_t>();
+        opts.max_message_size = vm["max-size"].as<std::size_t>();
+        opts.connections = vm["connections"].as<std::size_t>();
+        opts.mtu = vm["mtu"].as<int>();
+        opts.control_port = vm["control-port"].as<std::string>();
+        opts.format = rdma::benchmark::to_output_format(vm["format"].as<std::string>());
+
+        if (opts.min_message_size == 0 || opts.min_message_size > opts.max_message_size) {
+            std::cerr << "Invalid message size range.\n";
+            return 1;
+        }
+
+        if (opts.mtu != 0)
+            rdma::mtu_from_bytes(opts.mtu); // Throws if the MTU is invalid.
+
+        const auto test = vm["test"].as<std::string>();
+        const auto iter = benchmarks.find(test);
+
+        if (iter == std::end(benchmarks)) {
+            std::cerr << "Unknown benchmark: " << test << '\n';
+            return 1;
+        }
+
+        iter->second(opts);
+
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+    }
+
+    return 1;
+}
@@ -0,0 +1,116 @@
+#ifndef KDD_RDMA_BENCHMARK_MESH_SETUP_HPP
+#define KDD_RDMA_BENCHMARK_MESH_SETUP_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Brings up two queue_pair_meshes of this process that act as two nodes of an
+    // all-to-all job. They are connected through 8 control channels on
+    // --control-port, i.e. each mesh treats the other as 8 peers, and --connections
+    // QPs per mesh are spread evenly over the peers. The bring-up runs once on a
+    // pool of one thread, which creates and transitions the QPs one after another,
+    // and once on a pool of one thread per core. Reports the time spent in each
+    // stage by the first mesh. Both meshes share the device.
+    inline auto run_mesh_setup(const options& _opts) -> void
+    {
+        constexpr std::size_t peers = 8;
+        const auto per_peer = std::max<std::size_t>(1, _opts.connections / peers);
+
+        device_list devices;
+        context ctx{devices[_opts.device_index]};
+        protection_domain pd{ctx};
+        completion_queue cq{1, ctx};
+
+        loopback_config config;
+        const auto attrs = make_queue_pair_init_attributes(cq, config);
+
+        control_listener listener{_opts.control_port};
+
+        report r{std::cout, _opts.format, {"test", "mode", "threads", "peers", "queue_pairs", "create_seconds",
+                                           "init_seconds", "exchange_seconds", "rtr_seconds", "rts_seconds",
+                                           "sync_seconds", "total_seconds", "queue_pairs_per_second"}};
+
+        const auto cores = static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency()));
+
+        for (const auto threads : {std::size_t{1}, cores}) {
+            mesh_config mc;
+            mc.queue_pairs_per_peer = per_peer;
+            mc.port_number = _opts.port_number;
+            mc.gid_index = _opts.gid_index;
+            mc.access_flags = loopback_access_flags;
+            mc.threads = threads;
+
+            std::unique_ptr<queue_pair_mesh> local;
+            std::exception_ptr remote_error;
+
+            // The other node. Accepts its channels in the order the local mesh connects them.
+            std::thread remote_node{[&] {
+                try {
+                    std::vector<std::unique_ptr<control_channel>> channels;
+                    std::vector<control_channel*> channel_ptrs;
+
+                    for (std::size_t p = 0; p < peers; ++p) {
+                        channels.push_back(std::make_unique<control_channel>(listener));
+                        channel_ptrs.push_back(channels.back().get());
+                    }
+
+                    queue_pair_mesh remote{ctx, pd, cq, attrs, peers, mc};
+                    remote.connect(channel_ptrs);
+                }
+                catch (...) {
+                    remote_error = std::current_exception();
+                }
+            }};
+
+            try {
+                std::vector<std::unique_ptr<control_channel>> channels;
+                std::vector<control_channel*> channel_ptrs;
+
+                for (std::size_t p = 0; p < peers; ++p) {
+                    channels.push_back(std::make_unique<control_channel>("127.0.0.1", _opts.control_port));
+                    channel_ptrs.push_back(channels.back().get());
+                }
+
+                local = std::make_unique<queue_pair_mesh>(ctx, pd, cq, attrs, peers, mc);
+                local->connect(channel_ptrs);
+            }
+            catch (...) {
+                // Hanging up the channels makes the other node's reads fail, but it may
+                // still be waiting for channels that were never connected.
+                for (std::size_t p = 0; p < peers; ++p) {
+                    try {
+                        control_channel{"127.0.0.1", _opts.control_port};
+                    }
+                    catch (const std::exception&) {
+                    }
+                }
+
+                remote_node.join();
+                throw;
+            }
+
+            remote_node.join();
+
+            if (remote_error)
+                std::rethrow_exception(remote_error);
+
+            const auto& t = local->timings();
+            const auto total = t.create + t.init + t.exchange + t.rtr + t.rts + t.sync;
+
+            r.row("mesh_setup", threads == 1 ? "serial" : "parallel", threads, peers, local->size(), t.create,
+                  t.init, t.exchange, t.rtr, t.rts, t.sync, total, local->size() / total);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_MESH_SETUP_HPP
@@ -0,0 +1,598 @@
+#ifndef KDD_RDMA_BENCHMARK_PERFTEST_HPP
+#define KDD_RDMA_BENCHMARK_PERFTEST_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Latency and bandwidth tests modeled after the perftest suite (ib_send_lat,
+// ib_send_bw, ib_write_lat, ib_write_bw, ib_read_lat, ib_read_bw,
+// ib_atomic_lat), built entirely from the rdma:: wrappers. Each test sweeps the
+// message size from --min-size to --max-size in powers of two, except for the
+// atomics, which always operate on 8 bytes.
+
+namespace rdma::benchmark
+{
+    // Caps the iteration count for large messages so that a single size moves at
+    // most 1 GiB, which keeps a full sweep on Soft-RoCE within minutes.
+    inline auto iterations_for(const options& _opts, std::size_t _message_size) -> std::size_t
+    {
+        constexpr std::size_t max_bytes_per_size = std::size_t{1} << 30;
+        constexpr std::size_t min_iterations = 100;
+        return std::min(_opts.iterations, std::max(min_iterations, max_bytes_per_size / _message_size));
+    }
+
+    struct latency_summary
+    {
+        double min_us;
+        double median_us;
+        double p99_us;
+        double p999_us;
+        double max_us;
+        double avg_us;
+    };
+
+    inline auto summarize(std::vector<double>& _samples_us) -> latency_summary
+    {
+        std::sort(std::begin(_samples_us), std::end(_samples_us));
+
+        const auto percentile = [&_samples_us](double _p) {
+            const auto index = static_cast<std::size_t>(_p * _samples_us.size());
+            return _samples_us[std::min(index, _samples_us.size() - 1)];
+        };
+
+        const auto sum = std::accumulate(std::begin(_samples_us), std::end(_samples_us), 0.0);
+
+        return {_samples_us.front(), percentile(0.5), percentile(0.99), percentile(0.999),
+                _samples_us.back(), sum / _samples_us.size()};
+    }
+
+    inline auto make_latency_report(const options& _opts) -> report
+    {
+        return {std::cout, _opts.format, {"test", "message_size", "iterations", "min_us", "median_us",
+                                          "p99_us", "p999_us", "max_us", "avg_us"}};
+    }
+
+    inline auto make_bandwidth_report(const options& _opts) -> report
+    {
+        return {std::cout, _opts.format, {"test", "message_size", "queue_depth", "iterations",
+                                          "seconds", "messages_per_second", "bytes_per_second"}};
+    }
+
+    // Send completions and receive completions share a completion queue per QP.
+    // Tracks both for one side of a ping-pong. The send queue holds a single work
+    // request, so the previous send must complete before the slot can be reused.
+    class ping_pong_endpoint
+    {
+    public:
+        ping_pong_endpoint(queue_pair& _qp, completion_queue& _cq, buffer_descriptor _send, buffer_descriptor _recv)
+            : qp_{&_qp}
+            , cq_{&_cq}
+            , send_{_send}
+            , recv_{_recv}
+            , sends_outstanding_{}
+        {
+        }
+
+        auto qp() noexcept -> queue_pair&
+        {
+            return *qp_;
+        }
+
+        auto post_receive(std::uint32_t _length) -> void
+        {
+            auto recv = recv_;
+            recv.length = _length;
+            qp_->post_receive(&recv, 1);
+        }
+
+        auto post_send(std::uint32_t _length) -> void
+        {
+            reserve_send_slot();
+
+            auto send = send_;
+            send.length = _length;
+            qp_->post_send(&send, 1);
+        }
+
+        // Waits for the send queue slot to become free and claims it. Must be called
+        // before posting any work request to the send queue through qp().
+        auto reserve_send_slot() -> void
+        {
+            while (sends_outstanding_ > 0)
+                poll();
+
+            ++sends_outstanding_;
+        }
+
+        auto wait_for_receive() -> void
+        {
+            while (!poll());
+        }
+
+        auto wait_for_send() -> void
+        {
+            while (sends_outstanding_ > 0)
+                poll();
+        }
+
+    private:
+        // Returns true if a receive completed.
+        auto poll() -> bool
+        {
+            ibv_wc wcs[2];
+            bool received = false;
+
+            for (int i = 0, n = cq_->poll(wcs, 2); i < n; ++i) {
+                if (wcs[i].status != IBV_WC_SUCCESS)
+                    throw std::runtime_error{ibv_wc_status_str(wcs[i].status)};
+
+                if (wcs[i].opcode & IBV_WC_RECV)
+                    received = true;
+                else
+                    --sends_outstanding_;
+            }
+
+            return received;
+        }
+
+        queue_pair* qp_;
+        completion_queue* cq_;
+        buffer_descriptor send_;
+        buffer_descriptor recv_;
+        int sends_outstanding_;
+    }; // class ping_pong_endpoint
+
+    // Runs a send/receive ping-pong of _length byte messages and returns half of
+    // each round trip time. The receives of the last iteration are consumed before
+    // returning so that the next measurement starts clean.
+    inline auto measure_send_ping_pong(ping_pong_endpoint& _a,
+                                       ping_pong_endpoint& _b,
+                                       std::uint32_t _length,
+                                       std::size_t _iterations) -> std::vector<double>
+    {
+        std::vector<double> samples_us;
+        samples_us.reserve(_iterations);
+
+        _a.post_receive(_length);
+        _b.post_receive(_length);
+
+        for (std::size_t i = 0; i < _iterations; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+
+            _a.post_send(_length);
+            _b.wait_for_receive();
+            _b.post_receive(_length);
+
+            _b.post_send(_length);
+            _a.wait_for_receive();
+            _a.post_receive(_length);
+
+            const std::chrono::duration<double, std::micro> rtt = std::chrono::steady_clock::now() - start;
+            samples_us.push_back(rtt.count() / 2);
+        }
+
+        _a.post_send(_length);
+        _b.wait_for_receive();
+        _b.post_send(_length);
+        _a.wait_for_receive();
+
+        return samples_us;
+    }
+
+    // Half of the round trip time of a send/receive ping-pong between the two
+    // loopback QPs, like ib_send_lat.
+    inline auto run_send_latency(const options& _opts) -> void
+    {
+        loopback_config config;
+        config.max_send_wr = 1;
+        config.max_recv_wr = 1;
+        config.cqe_size = 2;
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> buffer(4 * _opts.max_message_size);
+        memory_region mr{lb.pd(), buffer, loopback_access_flags};
+
+        const auto max_length = static_cast<std::uint32_t>(_opts.max_message_size);
+        const auto segment = [&](std::size_t _index) {
+            return make_buffer_descriptor(mr, _index * _opts.max_message_size, max_length);
+        };
+
+        ping_pong_endpoint a{lb.sender(), lb.sender_cq(), segment(0), segment(1)};
+        ping_pong_endpoint b{lb.receiver(), lb.receiver_cq(), segment(2), segment(3)};
+
+        auto r = make_latency_report(_opts);
+
+        for (auto size = _opts.min_message_size; size <= _opts.max_message_size; size *= 2) {
+            const auto iterations = iterations_for(_opts, size);
+            auto samples_us = measure_send_ping_pong(a, b, static_cast<std::uint32_t>(size), iterations);
+
+            const auto s = summarize(samples_us);
+            r.row("send_lat", size, iterations, s.min_us, s.median_us, s.p99_us, s.p999_us, s.max_us, s.avg_us);
+        }
+    }
+
+    // send_lat with and without IBV_SEND_INLINE for every message size up to the
+    // max_inline_data granted by the device (256 bytes are requested).
+    inline auto run_inline_latency(const options& _opts) -> void
+    {
+        constexpr std::uint32_t requested_max_inline_data = 256;
+
+        loopback_config config;
+        config.max_send_wr = 1;
+        config.max_recv_wr = 1;
+        config.max_inline_data = requested_max_inline_data;
+        config.cqe_size = 2;
+
+        loopback lb{_opts, config};
+
+        const auto max_inline_data = std::min(lb.sender().max_inline_data(), lb.receiver().max_inline_data());
+
+        if (max_inline_data < _opts.min_message_size)
+            throw std::runtime_error{"max_inline_data is smaller than the minimum message size"};
+        const auto max_length = static_cast<std::uint32_t>(std::min<std::size_t>(_opts.max_message_size, max_inline_data));
+
+        std::vector<std::uint8_t> buffer(4 * max_length);
+        memory_region mr{lb.pd(), buffer, loopback_access_flags};
+
+        const auto segment = [&](std::size_t _index) {
+            return make_buffer_descriptor(mr, _index * max_length, max_length);
+        };
+
+        ping_pong_endpoint a{lb.sender(), lb.sender_cq(), segment(0), segment(1)};
+        ping_pong_endpoint b{lb.receiver(), lb.receiver_cq(), segment(2), segment(3)};
+
+        auto r = make_latency_report(_opts);
+
+        for (const bool use_inline : {false, true}) {
+            lb.sender().set_inline_threshold(use_inline ? max_inline_data : 0);
+            lb.receiver().set_inline_threshold(use_inline ? max_inline_data : 0);
+
+            for (auto size = _opts.min_message_size; size <= max_length; size *= 2) {
+                const auto iterations = iterations_for(_opts, size);
+                auto samples_us = measure_send_ping_pong(a, b, static_cast<std::uint32_t>(size), iterations);
+
+                const auto s = summarize(samples_us);
+                r.row(use_inline ? "inline_lat_inline" : "inline_lat_dma", size, iterations,
+                      s.min_us, s.median_us, s.p99_us, s.p999_us, s.max_us, s.avg_us);
+            }
+        }
+    }
+
+    // Unidirectional streaming sends with --queue-depth work requests in flight, like
+    // ib_send_bw. Only every 16th send is signaled (see queue_pair::set_signal_interval).
+    // Each row is labeled _test.
+    inline auto measure_send_bandwidth(const options& _opts, const std::string& _test) -> void
+    {
+        constexpr std::size_t max_receive_ring_bytes = std::size_t{64} << 20;
+
+        const auto queue_depth = static_cast<std::uint32_t>(_opts.queue_depth);
+
+        loopback_config config;
+        config.max_send_wr = queue_depth;
+        config.max_recv_wr = queue_depth;
+        config.cqe_size = queue_depth;
+        config.sq_sig_all = 0;
+
+        loopback lb{_opts, config};
+
+        auto& sender = lb.sender();
+        sender.set_signal_interval(std::min<std::uint32_t>(16, (queue_depth + 1) / 2));
+
+        std::vector<std::uint8_t> send_buffer(_opts.max_message_size);
+        memory_region send_mr{lb.pd(), send_buffer, loopback_access_flags};
+
+        auto r = make_bandwidth_report(_opts);
+
+        std::vector<buffer_descriptor> sends(queue_depth);
+        std::vector<buffer_descriptor> recvs(queue_depth);
+
+        for (auto size = _opts.min_message_size; size <= _opts.max_message_size; size *= 2) {
+            const auto length = static_cast<std::uint32_t>(size);
+            const auto iterations = iterations_for(_opts, size);
+
+            // The receive ring is registered per message size and capped at
+            // max_receive_ring_bytes. Beyond that, receives share slots, which is
+            // harmless since the payload is never read.
+            const auto slots = std::clamp<std::size_t>(max_receive_ring_bytes / size, 1, queue_depth);
+            std::vector<std::uint8_t> recv_buffer(slots * size);
+            memory_region recv_mr{lb.pd(), recv_buffer, loopback_access_flags};
+
+            for (std::uint32_t i = 0; i < queue_depth; ++i) {
+                sends[i] = make_buffer_descriptor(send_mr, 0, length, i);
+                recvs[i] = make_buffer_descriptor(recv_mr, (i % slots) * size, length, i);
+            }
+
+            std::size_t recv_posted = std::min<std::size_t>(queue_depth, iterations);
+            lb.receiver().post_receive(recvs.data(), recv_posted);
+
+            std::size_t sent = 0;
+            std::size_t received = 0;
+
+            const stopwatch sw;
+
+            while (received < iterations) {
+                // Never send more than the receiver has posted, otherwise the sender
+                // would stall in RNR retries, nor more than fit in the send queue.
+                if (const auto n = std::min<std::size_t>(recv_posted - sent, sender.send_queue_space()); n > 0) {
+                    sender.post_send(sends.data(), n);
+                    sent += n;
+                }
+
+                reclaim_send_slots(lb.sender_cq(), sender);
+
+                const auto n = poll_completions(lb.receiver_cq(), static_cast<int>(queue_depth));
+                received += n;
+
+                if (const auto to_post = std::min<std::size_t>(n, iterations - recv_posted); to_post > 0) {
+                    lb.receiver().post_receive(recvs.data(), to_post);
+                    recv_posted += to_post;
+                }
+            }
+
+            const auto seconds = sw.elapsed_seconds();
+
+            r.row(_test, size, queue_depth, iterations, seconds, iterations / seconds, iterations * size / seconds);
+        }
+    }
+
+    inline auto run_send_bandwidth(const options& _opts) -> void
+    {
+        measure_send_bandwidth(_opts, "send_bw");
+    }
+
+    // send_bw for every path MTU up to the port's active MTU, or --mtu if given. Each
+    // message is split into packets of the path MTU, so small MTUs pay the per-packet
+    // overhead many times per message. Rows are labeled send_bw_mtu_<bytes>.
+    inline auto run_mtu_bandwidth(const options& _opts) -> void
+    {
+        ibv_mtu max_mtu;
+
+        {
+            device_list devices;
+            context ctx{devices[_opts.device_index]};
+            max_mtu = ctx.port_info(_opts.port_number).active_mtu;
+        }
+
+        if (_opts.mtu > 0)
+            max_mtu = std::min(max_mtu, mtu_from_bytes(_opts.mtu));
+
+        for (auto mtu = IBV_MTU_256; mtu <= max_mtu; mtu = static_cast<ibv_mtu>(mtu + 1)) {
+            auto opts = _opts;
+            opts.mtu = mtu_to_bytes(mtu);
+            measure_send_bandwidth(opts, "send_bw_mtu_" + std::to_string(opts.mtu));
+        }
+    }
+
+    // Half of the round trip time of an RDMA WRITE ping-pong, like ib_write_lat. Each
+    // side detects the peer's write by spinning on the last byte of the message,
+    // because writes do not generate completions at the target.
+    inline auto run_write_latency(const options& _opts) -> void
+    {
+        loopback_config config;
+        config.max_send_wr = 1;
+        config.max_recv_wr = 1;
+        config.cqe_size = 1;
+
+        loopback lb{_opts, config};
+
+        // Segments: [0] A's source, [1] A's destination, [2] B's source, [3] B's destination.
+        std::vector<std::uint8_t> buffer(4 * _opts.max_message_size);
+        memory_region mr{lb.pd(), buffer, loopback_access_flags};
+
+        const auto remote = mr.remote_descriptor();
+        const auto max_length = static_cast<std::uint32_t>(_opts.max_message_size);
+        const auto segment = [&](std::size_t _index) {
+            return make_buffer_descriptor(mr, _index * _opts.max_message_size, max_length);
+        };
+
+        ping_pong_endpoint a{lb.sender(), lb.sender_cq(), segment(0), segment(1)};
+        ping_pong_endpoint b{lb.receiver(), lb.receiver_cq(), segment(2), segment(3)};
+
+        auto r = make_latency_report(_opts);
+
+        for (auto size = _opts.min_message_size; size <= _opts.max_message_size; size *= 2) {
+            const auto length = static_cast<std::uint32_t>(size);
+            const auto iterations = iterations_for(_opts, size);
+
+            auto a_src = segment(0);
+            auto b_src = segment(2);
+            a_src.length = length;
+            b_src.length = length;
+
+            auto* a_src_last = static_cast<std::uint8_t*>(a_src.address) + size - 1;
+            auto* b_src_last = static_cast<std::uint8_t*>(b_src.address) + size - 1;
+            const volatile auto* a_dst_last = static_cast<std::uint8_t*>(segment(1).address) + size - 1;
+            const volatile auto* b_dst_last = static_cast<std::uint8_t*>(segment(3).address) + size - 1;
+
+            std::vector<double> samples_us;
+            samples_us.reserve(iterations);
+
+            for (std::size_t i = 0; i < iterations; ++i) {
+                // Never zero, and never equal to the previous iteration's value.
+                const auto tag = static_cast<std::uint8_t>(i % 255 + 1);
+                *a_src_last = tag;
+                *b_src_last = tag;
+
+                const auto start = std::chrono::steady_clock::now();
+
+                a.reserve_send_slot();
+                a.qp().post_write(a_src, remote, 3 * _opts.max_message_size);
+                while (*b_dst_last != tag);
+
+                b.reserve_send_slot();
+                b.qp().post_write(b_src, remote, 1 * _opts.max_message_size);
+                while (*a_dst_last != tag);
+
+                const std::chrono::duration<double, std::micro> rtt = std::chrono::steady_clock::now() - start;
+                samples_us.push_back(rtt.count() / 2);
+            }
+
+            a.wait_for_send();
+            b.wait_for_send();
+
+            const auto s = summarize(samples_us);
+            r.row("write_lat", size, iterations, s.min_us, s.median_us, s.p99_us, s.p999_us, s.max_us, s.avg_us);
+        }
+    }
+
+    // Time from posting an RDMA READ to its completion, like ib_read_lat.
+    inline auto run_read_latency(const options& _opts) -> void
+    {
+        loopback_config config;
+        config.max_send_wr = 1;
+        config.max_recv_wr = 1;
+        config.cqe_size = 1;
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> local_buffer(_opts.max_message_size);
+        std::vector<std::uint8_t> remote_buffer(_opts.max_message_size);
+        memory_region local_mr{lb.pd(), local_buffer, loopback_access_flags};
+        memory_region remote_mr{lb.pd(), remote_buffer, loopback_access_flags};
+
+        const auto remote = remote_mr.remote_descriptor();
+
+        auto r = make_latency_report(_opts);
+
+        for (auto size = _opts.min_message_size; size <= _opts.max_message_size; size *= 2) {
+            const auto local = make_buffer_descriptor(local_mr, 0, static_cast<std::uint32_t>(size));
+            const auto iterations = iterations_for(_opts, size);
+
+            std::vector<double> samples_us;
+            samples_us.reserve(iterations);
+
+            for (std::size_t i = 0; i < iterations; ++i) {
+                const auto start = std::chrono::steady_clock::now();
+
+                lb.sender().post_read(local, remote, 0);
+                wait_for_completions(lb.sender_cq(), 1);
+
+                const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                samples_us.push_back(elapsed.count());
+            }
+
+            const auto s = summarize(samples_us);
+            r.row("read_lat", size, iterations, s.min_us, s.median_us, s.p99_us, s.p999_us, s.max_us, s.avg_us);
+        }
+    }
+
+    // Streams one-sided operations from the sender into (or out of) a region owned
+    // by the receiver with --queue-depth operations in flight. The receiver's CPU
+    // is not involved at all.
+    template <typename PostOperation>
+    auto run_one_sided_bandwidth(const options& _opts, const char* _test_name, PostOperation _post) -> void
+    {
+        const auto queue_depth = static_cast<std::uint32_t>(_opts.queue_depth);
+
+        loopback_config config;
+        config.max_send_wr = queue_depth;
+        config.max_recv_wr = 1;
+        config.cqe_size = queue_depth;
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> local_buffer(_opts.max_message_size);
+        std::vector<std::uint8_t> remote_buffer(_opts.max_message_size);
+        memory_region local_mr{lb.pd(), local_buffer, loopback_access_flags};
+        memory_region remote_mr{lb.pd(), remote_buffer, loopback_access_flags};
+
+        const auto remote = remote_mr.remote_descriptor();
+
+        auto r = make_bandwidth_report(_opts);
+
+        for (auto size = _opts.min_message_size; size <= _opts.max_message_size; size *= 2) {
+            const auto local = make_buffer_descriptor(local_mr, 0, static_cast<std::uint32_t>(size));
+            const auto iterations = iterations_for(_opts, size);
+
+            std::size_t posted = 0;
+            std::size_t completed = 0;
+
+            const stopwatch sw;
+
+            while (completed < iterations) {
+                for (; posted < iterations && posted - completed < queue_depth; ++posted)
+                    _post(lb.sender(), local, remote);
+
+                completed += poll_completions(lb.sender_cq(), static_cast<int>(posted - completed));
+            }
+
+            const auto seconds = sw.elapsed_seconds();
+
+            r.row(_test_name, size, queue_depth, iterations, seconds, iterations / seconds, iterations * size / seconds);
+        }
+    }
+
+    inline auto run_write_bandwidth(const options& _opts) -> void
+    {
+        run_one_sided_bandwidth(_opts, "write_bw", [](queue_pair& _qp, const buffer_descriptor& _local, const remote_memory_region& _remote) {
+            _qp.post_write(_local, _remote, 0);
+        });
+    }
+
+    inline auto run_read_bandwidth(const options& _opts) -> void
+    {
+        run_one_sided_bandwidth(_opts, "read_bw", [](queue_pair& _qp, const buffer_descriptor& _local, const remote_memory_region& _remote) {
+            _qp.post_read(_local, _remote, 0);
+        });
+    }
+
+    // Time from posting an atomic to its completion, like ib_atomic_lat, measured
+    // through the remote_counter and remote_spinlock primitives. The spinlock row
+    // is an uncontended lock() + unlock() pair, i.e. two atomics.
+    inline auto run_atomic_latency(const options& _opts) -> void
+    {
+        loopback lb{_opts, loopback_config{}};
+
+        std::vector<std::uint64_t> words(3);
+        memory_region mr{lb.pd(), words, loopback_access_flags};
+
+        const auto result = make_buffer_descriptor(mr, 0, sizeof(std::uint64_t));
+        const auto remote = mr.remote_descriptor();
+
+        remote_counter counter{lb.sender(), result, remote, 1 * sizeof(std::uint64_t)};
+        remote_spinlock lock{lb.sender(), result, remote, 2 * sizeof(std::uint64_t), 1};
+
+        auto r = make_latency_report(_opts);
+
+        const auto measure = [&](const char* _test_name, auto _operation) {
+            std::vector<double> samples_us;
+            samples_us.reserve(_opts.iterations);
+
+            for (std::size_t i = 0; i < _opts.iterations; ++i) {
+                const auto start = std::chrono::steady_clock::now();
+                _operation(i);
+                const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                samples_us.push_back(elapsed.count());
+            }
+
+            const auto s = summarize(samples_us);
+            r.row(_test_name, sizeof(std::uint64_t), _opts.iterations,
+                  s.min_us, s.median_us, s.p99_us, s.p999_us, s.max_us, s.avg_us);
+        };
+
+        measure("atomic_lat_fetch_add", [&](std::size_t) {
+            counter.fetch_add();
+        });
+
+        // Alternates between succeeding and failing, matching the mix of a contended lock.
+        measure("atomic_lat_compare_swap", [&](std::size_t _i) {
+            counter.compare_exchange(_opts.iterations + _i / 2, _opts.iterations + _i / 2 + 1);
+        });
+
+        measure("atomic_lat_spinlock", [&](std::size_t) {
+            lock.lock();
+            lock.unlock();
+        });
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_PERFTEST_HPP
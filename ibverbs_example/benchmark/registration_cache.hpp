@@ -0,0 +1,68 @@
+#ifndef KDD_RDMA_BENCHMARK_REGISTRATION_CACHE_HPP
+#define KDD_RDMA_BENCHMARK_REGISTRATION_CACHE_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Compares registering a buffer per operation (ibv_reg_mr + ibv_dereg_mr) with
+    // looking it up in a registration_cache. The buffers are visited round-robin,
+    // once with a budget large enough to hold all of them and once with a budget
+    // holding only half of them, which forces an eviction on every miss.
+    inline auto run_registration_cache(const options& _opts) -> void
+    {
+        constexpr std::size_t buffer_count = 64;
+
+        device_list devices;
+        context ctx{devices[_opts.device_index]};
+        protection_domain pd{ctx};
+
+        std::vector<std::vector<std::uint8_t>> buffers;
+        for (std::size_t i = 0; i < buffer_count; ++i)
+            buffers.emplace_back(_opts.message_size);
+
+        const auto iterations = std::min<std::size_t>(_opts.iterations, 100000);
+
+        report r{std::cout, _opts.format, {"test", "mode", "message_size", "operations", "seconds", "operations_per_second", "hits", "misses", "evictions"}};
+
+        {
+            const stopwatch sw;
+
+            for (std::size_t i = 0; i < iterations; ++i)
+                memory_region mr{pd, buffers[i % buffer_count], loopback_access_flags};
+
+            const auto seconds = sw.elapsed_seconds();
+
+            r.row("registration_cache", "per_call", _opts.message_size, iterations, seconds, iterations / seconds, 0, iterations, 0);
+        }
+
+        const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const auto bytes_per_buffer = ((_opts.message_size + page_size - 1) / page_size + 1) * page_size;
+
+        for (const auto& [mode, budget] : {std::pair{"cache_fits", buffer_count * bytes_per_buffer},
+                                           std::pair{"cache_evicts", buffer_count / 2 * bytes_per_buffer}})
+        {
+            registration_cache cache{pd, budget};
+            const stopwatch sw;
+
+            for (std::size_t i = 0; i < iterations; ++i) {
+                const auto& buffer = buffers[i % buffer_count];
+                cache.acquire(buffer.data(), buffer.size(), loopback_access_flags);
+            }
+
+            const auto seconds = sw.elapsed_seconds();
+            const auto stats = cache.statistics();
+
+            r.row("registration_cache", mode, _opts.message_size, iterations, seconds, iterations / seconds,
+                  stats.hits, stats.misses, stats.evictions);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_REGISTRATION_CACHE_HPP
@@ -0,0 +1,103 @@
+#ifndef KDD_RDMA_BENCHMARK_REPORT_HPP
+#define KDD_RDMA_BENCHMARK_REPORT_HPP
+
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma::benchmark
+{
+    enum class output_format
+    {
+        csv,
+        json
+    };
+
+    inline auto to_output_format(const std::string& _name) -> output_format
+    {
+        if (_name == "csv")  return output_format::csv;
+        if (_name == "json") return output_format::json;
+
+        throw std::invalid_argument{"unknown output format: " + _name};
+    }
+
+    // Writes benchmark results in a machine-readable form so that they can be
+    // collected for trend tracking. CSV output is a header line followed by one
+    // line per row. JSON output is an array of objects keyed by column name.
+    class report
+    {
+    public:
+        report(std::ostream& _out, output_format _format, std::vector<std::string> _columns)
+            : out_{_out}
+            , format_{_format}
+            , columns_{std::move(_columns)}
+            , rows_{}
+        {
+            if (output_format::csv == format_) {
+                for (std::size_t i = 0; i < columns_.size(); ++i)
+                    out_ << (i > 0 ? "," : "") << columns_[i];
+
+                out_ << std::endl;
+            }
+            else {
+                out_ << '[';
+            }
+        }
+
+        report(const report&) = delete;
+        auto operator=(const report&) -> report& = delete;
+
+        ~report()
+        {
+            if (output_format::json == format_)
+                out_ << (rows_ > 0 ? "\n]" : "]") << std::endl;
+        }
+
+        template <typename ...Values>
+        auto row(const Values&... _values) -> void
+        {
+            if (sizeof...(_values) != columns_.size())
+                throw std::invalid_argument{"report row does not match the number of columns"};
+
+            std::size_t column = 0;
+
+            if (output_format::csv == format_) {
+                ((out_ << (column++ > 0 ? "," : "") << _values), ...);
+                out_ << std::endl;
+            }
+            else {
+                out_ << (rows_ > 0 ? ",\n  {" : "\n  {");
+                ((out_ << (column > 0 ? ", " : "") << std::quoted(columns_[column]) << ": ",
+                  write_json_value(_values),
+                  ++column), ...);
+                out_ << '}' << std::flush;
+            }
+
+            ++rows_;
+        }
+
+    private:
+        template <typename T>
+        auto write_json_value(const T& _value) -> void
+        {
+            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+                out_ << _value;
+            else if constexpr (std::is_same_v<T, bool>)
+                out_ << (_value ? "true" : "false");
+            else
+                out_ << std::quoted(std::string{_value});
+        }
+
+        std::ostream& out_;
+        output_format format_;
+        std::vector<std::string> columns_;
+        std::size_t rows_;
+    }; // class report
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_REPORT_HPP
@@ -0,0 +1,96 @@
+#ifndef KDD_RDMA_BENCHMARK_SCATTER_GATHER_HPP
+#define KDD_RDMA_BENCHMARK_SCATTER_GATHER_HPP
+
+#include "common.hpp"
+#include "perftest.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Sends messages made of a small header and a payload living in separate
+    // buffers, sweeping the payload size from --min-size to --max-size. The "copy"
+    // mode copies both into a staging buffer and sends it with one SGE. The "gather"
+    // mode sends the header and the payload as two SGEs of one work request.
+    inline auto run_scatter_gather(const options& _opts) -> void
+    {
+        constexpr std::uint32_t header_size = 64;
+        constexpr std::size_t in_flight = 8;
+
+        loopback_config config;
+        config.max_send_wr = in_flight;
+        config.max_recv_wr = in_flight;
+        config.max_send_sge = 2;
+        config.cqe_size = in_flight;
+
+        loopback lb{_opts, config};
+
+        const auto max_message_size = header_size + _opts.max_message_size;
+
+        std::vector<std::uint8_t> header(header_size, 'h');
+        std::vector<std::uint8_t> payload(_opts.max_message_size, 'p');
+        std::vector<std::uint8_t> staging(in_flight * max_message_size);
+        std::vector<std::uint8_t> recv_buffer(max_message_size);
+
+        memory_region header_mr{lb.pd(), header, loopback_access_flags};
+        memory_region payload_mr{lb.pd(), payload, loopback_access_flags};
+        memory_region staging_mr{lb.pd(), staging, loopback_access_flags};
+        memory_region recv_mr{lb.pd(), recv_buffer, loopback_access_flags};
+
+        report r{std::cout, _opts.format, {"test", "mode", "header_size", "payload_size", "messages",
+                                           "seconds", "messages_per_second", "bytes_per_second"}};
+
+        for (const bool gather : {false, true}) {
+            for (auto size = _opts.min_message_size; size <= _opts.max_message_size; size *= 2) {
+                const auto payload_size = static_cast<std::uint32_t>(size);
+                const auto message_size = header_size + payload_size;
+                const auto iterations = iterations_for(_opts, message_size);
+
+                // Every receive lands in the same buffer. Only the transfer is measured.
+                const auto recv = make_buffer_descriptor(recv_mr, 0, message_size);
+                const std::vector<buffer_segment> segments{make_buffer_segment(header_mr, 0, header_size),
+                                                           make_buffer_segment(payload_mr, 0, payload_size)};
+
+                std::size_t posted = 0;
+                std::size_t sent = 0;
+                std::size_t received = 0;
+
+                const stopwatch sw;
+
+                while (received < iterations) {
+                    for (; posted < iterations && posted - sent < in_flight && posted - received < in_flight; ++posted) {
+                        lb.receiver().post_receive(&recv, 1);
+
+                        if (gather) {
+                            lb.sender().post_send(segments);
+                        }
+                        else {
+                            const auto offset = (posted % in_flight) * max_message_size;
+                            std::memcpy(staging.data() + offset, header.data(), header_size);
+                            std::memcpy(staging.data() + offset + header_size, payload.data(), payload_size);
+
+                            const auto send = make_buffer_descriptor(staging_mr, offset, message_size);
+                            lb.sender().post_send(&send, 1);
+                        }
+                    }
+
+                    sent += poll_completions(lb.sender_cq(), static_cast<int>(posted - sent));
+                    received += poll_completions(lb.receiver_cq(), static_cast<int>(posted - received));
+                }
+
+                wait_for_completions(lb.sender_cq(), posted - sent);
+
+                const auto seconds = sw.elapsed_seconds();
+
+                r.row("scatter_gather", gather ? "gather" : "copy", header_size, payload_size, iterations,
+                      seconds, iterations / seconds, iterations * message_size / seconds);
+            }
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_SCATTER_GATHER_HPP
@@ -0,0 +1,97 @@
+#ifndef KDD_RDMA_BENCHMARK_SELECTIVE_SIGNALING_HPP
+#define KDD_RDMA_BENCHMARK_SELECTIVE_SIGNALING_HPP
+
+#include "common.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma::benchmark
+{
+    // Streams single sends through a deliberately small send queue while only
+    // signaling every Nth work request. The queue pair must reclaim send queue
+    // slots from the signaled completions alone. Each run checks that every slot
+    // was reclaimed exactly once.
+    inline auto run_selective_signaling(const options& _opts) -> void
+    {
+        constexpr std::uint32_t send_queue_depth = 16;
+        constexpr std::uint32_t recv_queue_depth = 256;
+
+        loopback_config config;
+        config.max_send_wr = send_queue_depth;
+        config.max_recv_wr = recv_queue_depth;
+        config.cqe_size = recv_queue_depth;
+        config.sq_sig_all = 0;
+
+        loopback lb{_opts, config};
+
+        std::vector<std::uint8_t> send_buffer(_opts.message_size);
+        std::vector<std::uint8_t> recv_buffer(recv_queue_depth * _opts.message_size);
+        memory_region send_mr{lb.pd(), send_buffer, loopback_access_flags};
+        memory_region recv_mr{lb.pd(), recv_buffer, loopback_access_flags};
+
+        std::vector<buffer_descriptor> recvs;
+
+        for (std::size_t i = 0; i < recv_queue_depth; ++i) {
+            const auto length = static_cast<std::uint32_t>(_opts.message_size);
+            recvs.push_back(make_buffer_descriptor(recv_mr, i * _opts.message_size, length, i));
+        }
+
+        const auto send = make_buffer_descriptor(send_mr, 0, static_cast<std::uint32_t>(_opts.message_size));
+
+        report r{std::cout, _opts.format, {"test", "signal_interval", "send_queue_depth", "message_size", "messages", "seconds", "messages_per_second"}};
+
+        for (std::uint32_t interval = 1; interval <= send_queue_depth / 2; interval *= 2) {
+            auto& sender = lb.sender();
+            sender.set_signal_interval(interval);
+
+            // Keep the receive queue full so that the sender never hits RNR.
+            std::size_t recv_posted = std::min<std::size_t>(recv_queue_depth, _opts.iterations);
+            lb.receiver().post_receive(recvs.data(), recv_posted);
+
+            std::size_t received = 0;
+            std::size_t sent = 0;
+
+            // Slots of unsignaled sends at the end of the previous run.
+            const std::size_t carried_over = sender.outstanding_sends();
+            std::size_t reclaimed = 0;
+
+            const stopwatch sw;
+
+            while (received < _opts.iterations) {
+                if (sent < recv_posted && sender.send_queue_space() > 0) {
+                    sender.post_send(&send, 1);
+                    ++sent;
+                }
+
+                reclaimed += reclaim_send_slots(lb.sender_cq(), sender);
+
+                const auto n = poll_completions(lb.receiver_cq(), static_cast<int>(recv_queue_depth));
+                received += n;
+
+                const auto to_post = std::min<std::size_t>(n, _opts.iterations - recv_posted);
+                if (to_post > 0) {
+                    lb.receiver().post_receive(recvs.data(), to_post);
+                    recv_posted += to_post;
+                }
+            }
+
+            const auto seconds = sw.elapsed_seconds();
+
+            // Only the unsignaled sends after the last signaled one may remain. Every
+            // other slot must have been reclaimed exactly once.
+            while (sender.outstanding_sends() >= interval)
+                reclaimed += reclaim_send_slots(lb.sender_cq(), sender);
+
+            if (reclaimed + sender.outstanding_sends() != carried_over + sent)
+                throw std::logic_error{"send queue slots were lost or reclaimed twice"};
+
+            r.row("selective_signaling", interval, send_queue_depth, _opts.message_size, received, seconds, received / seconds);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_SELECTIVE_SIGNALING_HPP
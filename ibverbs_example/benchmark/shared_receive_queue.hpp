@@ -0,0 +1,192 @@
+#ifndef KDD_RDMA_BENCHMARK_SHARED_RECEIVE_QUEUE_HPP
+#define KDD_RDMA_BENCHMARK_SHARED_RECEIVE_QUEUE_HPP
+
+#include "common.hpp"
+
+#include <poll.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rdma::benchmark
+{
+    // Serves --connections receiver QPs, each connected to its own sender QP, first
+    // with a receive queue of --queue-depth buffers per QP and then with a single
+    // shared receive queue of --queue-depth buffers replenished by an srq_replenisher.
+    // The senders stream --iterations messages round-robin over all connections with
+    // at most --queue-depth messages in flight, which is the most receive buffers
+    // either configuration can have in use at a time. With the shared receive queue,
+    // messages in flight are further limited to the receives posted to it, so that
+    // no message waits out an RNR NAK while the replenisher tops the queue up.
+    // Reports the registered memory behind the receive buffers and the message rate
+    // of each configuration.
+    inline auto run_shared_receive_queue(const options& _opts) -> void
+    {
+        const auto connections = _opts.connections;
+        const auto depth = static_cast<std::uint32_t>(_opts.queue_depth);
+        const auto message_size = static_cast<std::uint32_t>(_opts.message_size);
+
+        device_list devices;
+        context ctx{devices[_opts.device_index]};
+        protection_domain pd{ctx};
+
+        report r{std::cout, _opts.format, {"test", "mode", "connections", "message_size", "receive_buffers",
+                                           "registered_bytes", "messages", "seconds", "messages_per_second"}};
+
+        for (const bool use_srq : {false, true}) {
+            const auto buffer_count = use_srq ? depth : static_cast<std::uint32_t>(connections * depth);
+            buffer_pool pool{pd, {{message_size, buffer_count}}, loopback_access_flags};
+
+            completion_queue sender_cq{static_cast<int>(depth), ctx};
+            completion_queue receiver_cq{static_cast<int>(depth), ctx};
+
+            loopback_config config;
+            config.max_send_wr = depth;
+            config.max_recv_wr = depth;
+
+            std::unique_ptr<shared_receive_queue> srq;
+
+            if (use_srq)
+                srq = std::make_unique<shared_receive_queue>(pd, depth);
+
+            std::vector<std::unique_ptr<queue_pair>> senders;
+            std::vector<std::unique_ptr<queue_pair>> receivers;
+            std::unordered_map<std::uint32_t, queue_pair*> receivers_by_qp_num;
+
+            for (std::size_t i = 0; i < connections; ++i) {
+                auto sender_attrs = make_queue_pair_init_attributes(sender_cq, config);
+                auto receiver_attrs = make_queue_pair_init_attributes(receiver_cq, config);
+
+                senders.push_back(std::make_unique<queue_pair>(pd, sender_attrs, sender_cq));
+
+                if (use_srq)
+                    receivers.push_back(std::make_unique<queue_pair>(pd, receiver_attrs, receiver_cq, *srq));
+                else
+                    receivers.push_back(std::make_unique<queue_pair>(pd, receiver_attrs, receiver_cq));
+
+                connect_loopback_queue_pairs(ctx, *senders.back(), *receivers.back(), _opts);
+                receivers_by_qp_num[receivers.back()->queue_pair_number()] = receivers.back().get();
+
+                if (!use_srq) {
+                    std::vector<buffer_descriptor> buffers;
+
+                    for (std::uint32_t j = 0; j < depth; ++j) {
+                        const auto b = pool.allocate(message_size);
+                        buffers.push_back({b.id, b.data, b.size, b.local_key});
+                    }
+
+                    receivers.back()->post_receive(buffers);
+                }
+            }
+
+            std::unique_ptr<srq_replenisher> replenisher;
+            std::atomic<bool> stop{false};
+            std::thread event_thread;
+            std::exception_ptr event_error;
+
+            if (use_srq) {
+                // A watermark of at least one lets release() replenish an empty queue.
+                const auto low_watermark = depth > 1 ? std::max<std::uint32_t>(1, depth / 4) : 0;
+                replenisher = std::make_unique<srq_replenisher>(*srq, pool, message_size, depth, low_watermark);
+
+                // Forwards SRQ limit events to the replenisher. The event file descriptor is
+                // polled with a timeout so that the thread notices when the test is over.
+                event_thread = std::thread{[&] {
+                    try {
+                        pollfd pfd{ctx.handle().async_fd, POLLIN, 0};
+
+                        while (!stop.load(std::memory_order_relaxed)) {
+                            if (poll(&pfd, 1, 10) > 0)
+                                replenisher->handle_async_event(ctx.wait_for_async_event());
+                        }
+                    }
+                    catch (...) {
+                        event_error = std::current_exception();
+                    }
+                }};
+            }
+
+            const auto stop_event_thread = [&] {
+                if (!event_thread.joinable())
+                    return;
+
+                stop.store(true, std::memory_order_relaxed);
+                event_thread.join();
+            };
+
+            std::vector<std::uint8_t> payload(message_size);
+            memory_region payload_mr{pd, payload, loopback_access_flags};
+            const auto send = make_buffer_descriptor(payload_mr, 0, message_size);
+
+            std::size_t posted = 0;
+            std::size_t sent = 0;
+            std::size_t received = 0;
+
+            // Every message in flight needs a posted receive. Receives whose completions
+            // have not been polled yet are still counted by the replenisher, and so are
+            // their messages by posted - received.
+            const auto can_send = [&] {
+                return posted - sent < depth && (!use_srq || posted - received < replenisher->posted());
+            };
+
+            double seconds = 0;
+
+            try {
+                const stopwatch sw;
+
+                while (received < _opts.iterations) {
+                    for (; posted < _opts.iterations && can_send(); ++posted)
+                        senders[posted % connections]->post_send(&send, 1);
+
+                    sent += poll_completions(sender_cq, static_cast<int>(depth));
+
+                    ibv_wc wcs[32];
+
+                    for (int i = 0, n = receiver_cq.poll(wcs, 32); i < n; ++i, ++received) {
+                        if (wcs[i].status != IBV_WC_SUCCESS)
+                            throw std::runtime_error{ibv_wc_status_str(wcs[i].status)};
+
+                        if (use_srq) {
+                            replenisher->release(replenisher->take(wcs[i]));
+                        }
+                        else {
+                            const auto b = pool.buffer_from_id(static_cast<std::uint32_t>(wcs[i].wr_id));
+                            const buffer_descriptor buffer{b.id, b.data, b.size, b.local_key};
+                            receivers_by_qp_num.at(wcs[i].qp_num)->post_receive(&buffer, 1);
+                        }
+                    }
+
+                    // With a single buffer there is no watermark, so nothing else refills
+                    // the queue once its receive has been consumed.
+                    if (use_srq && posted == received && replenisher->posted() == 0)
+                        replenisher->replenish();
+                }
+
+                seconds = sw.elapsed_seconds();
+                wait_for_completions(sender_cq, posted - sent);
+            }
+            catch (...) {
+                stop_event_thread();
+                throw;
+            }
+
+            stop_event_thread();
+
+            if (event_error)
+                std::rethrow_exception(event_error);
+
+            r.row("shared_receive_queue", use_srq ? "srq" : "per_qp", connections, message_size, buffer_count,
+                  pool.registered_bytes(), received, seconds, received / seconds);
+        }
+    }
+} // namespace rdma::benchmark
+
+#endif // KDD_RDMA_BENCHMARK_SHARED_RECEIVE_QUEUE_HPP
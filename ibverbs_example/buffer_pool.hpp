@@ -0,0 +1,335 @@
+#ifndef KDD_RDMA_BUFFER_POOL_HPP
+#define KDD_RDMA_BUFFER_POOL_HPP
+
+#include "protection_domain.hpp"
+#include "memory_region.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma
+{
+    // A fixed-size chunk of registered memory handed out by a buffer_pool.
+    struct pooled_buffer
+    {
+        std::uint8_t* data;
+        std::uint32_t size;
+        std::uint32_t local_key;
+        std::uint32_t remote_key;
+        std::uint32_t id; // Identifies the chunk within the pool. See buffer_pool::buffer_from_id().
+    };
+
+    struct size_class
+    {
+        std::uint32_t chunk_size;
+        std::uint32_t chunk_count;
+    };
+
+    // Registers a single slab of memory once and carves it into fixed-size chunks
+    // of one or more size classes. Allocation and deallocation never register memory
+    // or touch the heap, so buffers can be taken and returned on the data path.
+    //
+    // Each size class keeps its free chunks on a lock-free stack. Threads that
+    // allocate frequently should go through a thread_cache, which moves chunks to
+    // and from the shared stacks in batches so that concurrent threads rarely
+    // touch the same cache line.
+    class buffer_pool
+    {
+    public:
+        class thread_cache;
+
+        buffer_pool(const protection_domain& _pd,
+                    const std::vector<size_class>& _size_classes,
+                    int _access_flags)
+            : classes_(_size_classes.size())
+            , slab_()
+            , mr_{}
+            , base_{}
+        {
+            if (_size_classes.empty() || _size_classes.size() > max_size_classes)
+                throw std::invalid_argument{"invalid number of buffer pool size classes"};
+
+            std::size_t slab_size = 0;
+
+            for (std::size_t i = 0; i < _size_classes.size(); ++i) {
+                const auto& sc = _size_classes[i];
+
+                if (sc.chunk_size == 0 || sc.chunk_count == 0 || sc.chunk_count > max_chunks_per_class)
+                    throw std::invalid_argument{"invalid buffer pool size class"};
+
+                if (i > 0 && sc.chunk_size <= _size_classes[i - 1].chunk_size)
+                    throw std::invalid_argument{"buffer pool size classes must be sorted by increasing chunk size"};
+
+                auto& c = classes_[i];
+                c.chunk_size = sc.chunk_size;
+                c.chunk_count = sc.chunk_count;
+                c.stride = (sc.chunk_size + chunk_alignment - 1) & ~(chunk_alignment - 1);
+                c.offset = slab_size;
+
+                slab_size += static_cast<std::size_t>(c.stride) * c.chunk_count;
+            }
+
+            slab_.resize(slab_size + chunk_alignment);
+            mr_ = std::make_unique<memory_region>(_pd, slab_, _access_flags);
+
+            // Align the first chunk so that no chunk shares a cache line with another.
+            const auto base = reinterpret_cast<std::uintptr_t>(slab_.data());
+            base_ = slab_.data() + (((base + chunk_alignment - 1) & ~(chunk_alignment - 1)) - base);
+
+            for (auto& c : classes_) {
+                c.next = std::make_unique<std::atomic<std::uint32_t>[]>(c.chunk_count);
+
+                // Link every chunk into the free list. Links are stored as index + 1
+                // so that zero can represent the end of the list.
+                for (std::uint32_t j = 0; j < c.chunk_count; ++j)
+                    c.next[j].store(j + 1 < c.chunk_count ? j + 2 : 0, std::memory_order_relaxed);
+
+                c.head.store(1, std::memory_order_release);
+            }
+        }
+
+        buffer_pool(const buffer_pool&) = delete;
+        auto operator=(const buffer_pool&) -> buffer_pool& = delete;
+
+        // Returns a chunk from the smallest size class that can hold _size bytes,
+        // or an empty optional if that size class has no free chunks.
+        auto try_allocate(std::uint32_t _size) -> std::optional<pooled_buffer>
+        {
+            const auto class_index = find_size_class(_size);
+
+            if (const auto index = pop(classes_[class_index]); index)
+                return buffer_from_id(make_id(class_index, *index));
+
+            return std::nullopt;
+        }
+
+        auto allocate(std::uint32_t _size) -> pooled_buffer
+        {
+            if (auto buffer = try_allocate(_size); buffer)
+                return *buffer;
+
+            throw std::bad_alloc{};
+        }
+
+        auto deallocate(const pooled_buffer& _buffer) -> void
+        {
+            const auto index = chunk_index(_buffer.id);
+            push(classes_[size_class_index(_buffer.id)], index, index);
+        }
+
+        // Reconstructs the buffer for a chunk id, e.g. one carried through a work request id.
+        auto buffer_from_id(std::uint32_t _id) const -> pooled_buffer
+        {
+            const auto& c = classes_.at(size_class_index(_id));
+            const auto index = chunk_index(_id);
+
+            if (index >= c.chunk_count)
+                throw std::out_of_range{"invalid buffer pool chunk id"};
+
+            auto* data = base_ + c.offset + static_cast<std::size_t>(c.stride) * index;
+            return {data, c.chunk_size, mr_->local_key(), mr_->remote_key(), _id};
+        }
+
+        auto memory() const noexcept -> const memory_region&
+        {
+            return *mr_;
+        }
+
+        // The number of bytes of pinned memory backing the pool.
+        auto registered_bytes() const noexcept -> std::size_t
+        {
+            return slab_.size();
+        }
+
+    private:
+        static constexpr std::size_t max_size_classes = 256;
+        static constexpr std::uint32_t max_chunks_per_class = 1u << 24;
+        static constexpr std::uint32_t chunk_alignment = 64;
+
+        struct size_class_state
+        {
+            // The free list head packs a modification counter in the upper 32 bits and
+            // (chunk index + 1) in the lower 32 bits. The counter prevents the ABA
+            // problem when a chunk is popped and pushed back between a thread's load
+            // and compare-exchange.
+            alignas(64) std::atomic<std::uint64_t> head{};
+            std::unique_ptr<std::atomic<std::uint32_t>[]> next;
+            std::uint32_t chunk_size{};
+            std::uint32_t chunk_count{};
+            std::uint32_t stride{};
+            std::size_t offset{};
+        };
+
+        static constexpr auto make_id(std::size_t _class_index, std::uint32_t _chunk_index) noexcept -> std::uint32_t
+        {
+            return static_cast<std::uint32_t>(_class_index << 24) | _chunk_index;
+        }
+
+        static constexpr auto size_class_index(std::uint32_t _id) noexcept -> std::size_t
+        {
+            return _id >> 24;
+        }
+
+        static constexpr auto chunk_index(std::uint32_t _id) noexcept -> std::uint32_t
+        {
+            return _id & (max_chunks_per_class - 1);
+        }
+
+        auto find_size_class(std::uint32_t _size) const -> std::size_t
+        {
+            for (std::size_t i = 0; i < classes_.size(); ++i) {
+                if (_size <= classes_[i].chunk_size)
+                    return i;
+            }
+
+            throw std::invalid_argument{"requested size exceeds the largest buffer pool size class"};
+        }
+
+        static auto pop(size_class_state& _c) noexcept -> std::optional<std::uint32_t>
+        {
+            auto head = _c.head.load(std::memory_order_acquire);
+
+            while (true) {
+                const auto link = static_cast<std::uint32_t>(head);
+
+                if (link == 0)
+                    return std::nullopt;
+
+                const auto next = _c.next[link - 1].load(std::memory_order_relaxed);
+                const auto new_head = (((head >> 32) + 1) << 32) | next;
+
+                if (_c.head.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+                    return link - 1;
+            }
+        }
+
+        // Pushes a chain of chunks linked from _first to _last through the next array.
+        static auto push(size_class_state& _c, std::uint32_t _first, std::uint32_t _last) noexcept -> void
+        {
+            auto head = _c.head.load(std::memory_order_relaxed);
+
+            while (true) {
+                _c.next[_last].store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+                const auto new_head = (((head >> 32) + 1) << 32) | (_first + 1);
+
+                if (_c.head.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed))
+                    return;
+            }
+        }
+
+        std::vector<size_class_state> classes_;
+        std::vector<std::uint8_t> slab_;
+        std::unique_ptr<memory_region> mr_;
+        std::uint8_t* base_;
+    }; // class buffer_pool
+
+    // A per-thread front end for a buffer_pool. Chunks are allocated from and
+    // returned to a small local stack per size class. The shared free lists are
+    // only touched to refill or drain the local stacks in batches.
+    //
+    // A thread_cache must only be used by one thread at a time. Chunks held by the
+    // cache are returned to the pool on destruction. Buffers may be deallocated
+    // through any cache of the same pool.
+    class buffer_pool::thread_cache
+    {
+    public:
+        explicit thread_cache(buffer_pool& _pool, std::uint32_t _batch_size = 32)
+            : pool_{&_pool}
+            , batch_size_{std::max<std::uint32_t>(_batch_size, 1)}
+            , stacks_(_pool.classes_.size())
+        {
+            for (auto& s : stacks_)
+                s.reserve(2 * batch_size_);
+        }
+
+        thread_cache(const thread_cache&) = delete;
+        auto operator=(const thread_cache&) -> thread_cache& = delete;
+
+        ~thread_cache()
+        {
+            for (std::size_t i = 0; i < stacks_.size(); ++i)
+                drain(i, stacks_[i].size());
+        }
+
+        auto try_allocate(std::uint32_t _size) -> std::optional<pooled_buffer>
+        {
+            const auto class_index = pool_->find_size_class(_size);
+            auto& stack = stacks_[class_index];
+
+            if (stack.empty()) {
+                auto& c = pool_->classes_[class_index];
+
+                for (std::uint32_t i = 0; i < batch_size_; ++i) {
+                    const auto index = buffer_pool::pop(c);
+
+                    if (!index)
+                        break;
+
+                    stack.push_back(*index);
+                }
+
+                if (stack.empty())
+                    return std::nullopt;
+            }
+
+            const auto index = stack.back();
+            stack.pop_back();
+
+            return pool_->buffer_from_id(buffer_pool::make_id(class_index, index));
+        }
+
+        auto allocate(std::uint32_t _size) -> pooled_buffer
+        {
+            if (auto buffer = try_allocate(_size); buffer)
+                return *buffer;
+
+            throw std::bad_alloc{};
+        }
+
+        auto deallocate(const pooled_buffer& _buffer) -> void
+        {
+            const auto class_index = buffer_pool::size_class_index(_buffer.id);
+            auto& stack = stacks_[class_index];
+
+            stack.push_back(buffer_pool::chunk_index(_buffer.id));
+
+            if (stack.size() >= 2 * batch_size_)
+                drain(class_index, batch_size_);
+        }
+
+    private:
+        // Returns the top _count chunks of the local stack to the pool with a single push.
+        auto drain(std::size_t _class_index, std::size_t _count) -> void
+        {
+            auto& stack = stacks_[_class_index];
+
+            if (_count == 0)
+                return;
+
+            auto& c = pool_->classes_[_class_index];
+            const auto first = stack.size() - _count;
+
+            for (auto i = first; i + 1 < stack.size(); ++i)
+                c.next[stack[i]].store(stack[i + 1] + 1, std::memory_order_relaxed);
+
+            buffer_pool::push(c, stack[first], stack.back());
+            stack.resize(first);
+        }
+
+        buffer_pool* pool_;
+        std::uint32_t batch_size_;
+        std::vector<std::vector<std::uint32_t>> stacks_;
+    }; // class buffer_pool::thread_cache
+} // namespace rdma
+
+#endif // KDD_RDMA_BUFFER_POOL_HPP
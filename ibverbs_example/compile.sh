@@ -7,3 +7,19 @@ g++ -std=c++17 -Wall -Wextra -pthread -o rdma_app main.cpp \
         -lboost_program_options \
         -lboost_system
 
+g++ -std=c++17 -Wall -Wextra -pthread -o rdma_server server.cpp \
+	-I/home/kory/dev/rdma-core/build/include \
+	-L/home/kory/dev/rdma-core/build/lib \
+	-libverbs \
+        -lboost_system
+
+# Benchmarks (C++20 for the coroutine API)
+g++ -std=c++20 -O2 -Wall -Wextra -pthread -o rdma_benchmark benchmark/main.cpp \
+	-I/home/kory/dev/rdma-core/build/include \
+	-L/home/kory/dev/rdma-core/build/lib \
+	-libverbs \
+        -lboost_program_options \
+        -lboost_system
+
+# Device selection and CPU placement checks against sysfs fixture trees (no RDMA device required)
+g++ -std=c++17 -Wall -Wextra -o rdma_sysfs_fixtures sysfs_fixtures.cpp
@@ -8,12 +8,65 @@
 #include <stdio.h>
 #include <errno.h>
 
+#include <cstdint>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
 #include <stdexcept>
 
 namespace rdma
 {
+    // Work request ids dispatched by completion_queue::poll_and_dispatch() carry a
+    // 16-bit handler tag in their upper bits. The remaining 48 bits are free for
+    // the user, e.g. a buffer index.
+    constexpr auto make_work_request_id(std::uint16_t _tag, std::uint64_t _value) noexcept -> std::uint64_t
+    {
+        return (static_cast<std::uint64_t>(_tag) << 48) | (_value & 0xffff'ffff'ffffull);
+    }
+
+    constexpr auto work_request_tag(std::uint64_t _wr_id) noexcept -> std::uint16_t
+    {
+        return static_cast<std::uint16_t>(_wr_id >> 48);
+    }
+
+    constexpr auto work_request_value(std::uint64_t _wr_id) noexcept -> std::uint64_t
+    {
+        return _wr_id & 0xffff'ffff'ffffull;
+    }
+
+    using completion_handler = std::function<void(const ibv_wc&)>;
+
+    // Reports how each call to completion_queue::wait() was satisfied.
+    struct wait_statistics
+    {
+        std::uint64_t spin_waits;     // Completions found while busy-polling.
+        std::uint64_t blocking_waits; // Completions found after blocking on the event channel.
+    };
+
     class completion_queue;
 
+    // Thrown by completion_queue::poll_and_dispatch() for completions whose tag has no
+    // handler. They are the first count() entries of the caller's buffer.
+    class undispatched_completions : public std::logic_error
+    {
+    public:
+        explicit undispatched_completions(std::size_t _count)
+            : std::logic_error{"no completion handler registered for work request tag"}
+            , count_{_count}
+        {
+        }
+
+        auto count() const noexcept -> std::size_t
+        {
+            return count_;
+        }
+
+    private:
+        std::size_t count_;
+    }; // class undispatched_completions
+
     class completion_event_channel
     {
     public:
@@ -48,11 +101,22 @@ namespace rdma
         ibv_comp_channel* evt_ch_;
     }; // completion_event_channel
 
+    // _comp_vector selects the completion vector, i.e. the interrupt, that signals
+    // events of the queue. It must be less than context::num_completion_vectors().
+    // Spreading queues over the vectors (see completion_vector_allocator) spreads
+    // their interrupts over several cores.
     class completion_queue
     {
     public:
-        completion_queue(int _cp_size, const context& _ctx)
-            : cq_{ibv_create_cq(&_ctx.handle(), _cp_size, nullptr, nullptr, 0)}
+        completion_queue(int _cp_size, const context& _ctx, int _comp_vector = 0)
+            : cq_{ibv_create_cq(&_ctx.handle(), _cp_size, nullptr, nullptr, _comp_vector)}
+            , evt_ch_{}
+            , comp_vector_{_comp_vector}
+            , handlers_{}
+            , fallback_handler_{}
+            , spin_budget_{default_spin_budget}
+            , unacked_events_{}
+            , stats_{}
         {
             if (!cq_) {
                 perror("ibv_create_cq");
@@ -60,8 +124,15 @@ namespace rdma
             }
         }
 
-        completion_queue(int _cpe_size, const completion_event_channel& _evt_ch)
-            : cq_{ibv_create_cq(_evt_ch.ctx_, _cpe_size, nullptr, _evt_ch.evt_ch_, 0)}
+        completion_queue(int _cpe_size, const completion_event_channel& _evt_ch, int _comp_vector = 0)
+            : cq_{ibv_create_cq(_evt_ch.ctx_, _cpe_size, nullptr, _evt_ch.evt_ch_, _comp_vector)}
+            , evt_ch_{_evt_ch.evt_ch_}
+            , comp_vector_{_comp_vector}
+            , handlers_{}
+            , fallback_handler_{}
+            , spin_budget_{default_spin_budget}
+            , unacked_events_{}
+            , stats_{}
         {
             if (!cq_) {
                 perror("ibv_create_cq");
@@ -74,8 +145,13 @@ namespace rdma
 
         ~completion_queue()
         {
-            if (cq_)
+            if (cq_) {
+                // ibv_destroy_cq blocks until every event it generated is acknowledged.
+                if (unacked_events_ > 0)
+                    ibv_ack_cq_events(cq_, unacked_events_);
+
                 ibv_destroy_cq(cq_);
+            }
         }
 
         auto handle() const noexcept -> ibv_cq&
@@ -83,6 +159,11 @@ namespace rdma
             return *cq_;
         }
 
+        auto completion_vector() const noexcept -> int
+        {
+            return comp_vector_;
+        }
+
         auto resize(int _new_size) const -> void
         {
             if (_new_size < 1)
@@ -94,8 +175,203 @@ namespace rdma
             }
         }
 
+        // Non-blocking. Drains up to _max completions into the caller's buffer and
+        // returns the number of completions written.
+        auto poll(ibv_wc* _wcs, int _max) const -> int
+        {
+            const auto n = ibv_poll_cq(cq_, _max, _wcs);
+
+            if (n < 0) {
+                perror("ibv_poll_cq");
+                throw std::runtime_error{"ibv_poll_cq error"};
+            }
+
+            return n;
+        }
+
+        // Busy-polls until a single completion is available.
+        auto wait_for_completion() const -> ibv_wc
+        {
+            ibv_wc wc{};
+            while (poll(&wc, 1) == 0);
+            return wc;
+        }
+
+        // Registers the handler invoked by poll_and_dispatch() for completions whose
+        // work request id carries _tag. See make_work_request_id().
+        auto set_handler(std::uint16_t _tag, completion_handler _handler) -> void
+        {
+            if (handlers_.size() <= _tag)
+                handlers_.resize(_tag + 1);
+
+            handlers_[_tag] = std::move(_handler);
+        }
+
+        auto remove_handler(std::uint16_t _tag) -> void
+        {
+            if (_tag < handlers_.size())
+                handlers_[_tag] = nullptr;
+        }
+
+        // Registers the handler invoked by poll_and_dispatch() for completions whose
+        // tag has no handler.
+        auto set_fallback_handler(completion_handler _handler) -> void
+        {
+            fallback_handler_ = std::move(_handler);
+        }
+
+        // Non-blocking. Drains up to _max completions into the caller's buffer and
+        // invokes the handler registered for each completion's work request tag.
+        // This allows a single poll to serve many QPs sharing this completion queue.
+        // Returns the number of completions dispatched.
+        //
+        // The whole batch is dispatched before anything is thrown. If a handler throws,
+        // the first exception is rethrown once every other completion has been handed
+        // out. Completions without a handler go to the fallback handler. Without one,
+        // they are moved to the front of _wcs and reported by an undispatched_completions
+        // error (with the handler's exception nested, if any), so they are never lost.
+        auto poll_and_dispatch(ibv_wc* _wcs, int _max) const -> int
+        {
+            const auto n = poll(_wcs, _max);
+
+            std::exception_ptr error;
+            std::size_t undispatched = 0;
+
+            for (int i = 0; i < n; ++i) {
+                const auto tag = work_request_tag(_wcs[i].wr_id);
+                const auto& handler = tag < handlers_.size() && handlers_[tag] ? handlers_[tag] : fallback_handler_;
+
+                if (!handler) {
+                    _wcs[undispatched++] = _wcs[i];
+                    continue;
+                }
+
+                try {
+                    handler(_wcs[i]);
+                }
+                catch (...) {
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+
+            if (undispatched > 0) {
+                if (!error)
+                    throw undispatched_completions{undispatched};
+
+                // Reports both. The handler's exception is nested in the error.
+                try {
+                    std::rethrow_exception(error);
+                }
+                catch (...) {
+                    std::throw_with_nested(undispatched_completions{undispatched});
+                }
+            }
+
+            if (error)
+                std::rethrow_exception(error);
+
+            return n;
+        }
+
+        // The amount of time wait() busy-polls before blocking on the completion
+        // event channel. Zero means block immediately when the queue is empty.
+        auto set_spin_budget(std::chrono::nanoseconds _budget) noexcept -> void
+        {
+            spin_budget_ = _budget;
+        }
+
+        auto spin_budget() const noexcept -> std::chrono::nanoseconds
+        {
+            return spin_budget_;
+        }
+
+        // Blocks until at least one completion is available and drains up to _max
+        // completions into the caller's buffer. Returns the number of completions written.
+        //
+        // The queue is busy-polled for the spin budget first, keeping latency low for
+        // busy queues. After that, the queue is armed with ibv_req_notify_cq and the
+        // calling thread sleeps in ibv_get_cq_event, so idle queues do not burn a core.
+        // Events are acknowledged in batches because ibv_ack_cq_events takes a lock.
+        //
+        // Completion queues constructed without an event channel spin indefinitely.
+        // The event channel must be dedicated to this completion queue.
+        // Events are raised by the interrupt of the queue's completion vector, so the
+        // waiting thread is best pinned to a core near it (see cpu_for_completion_vector()).
+        auto wait(ibv_wc* _wcs, int _max) -> int
+        {
+            const auto deadline = std::chrono::steady_clock::now() + spin_budget_;
+
+            do {
+                if (const auto n = poll(_wcs, _max); n > 0) {
+                    ++stats_.spin_waits;
+                    return n;
+                }
+            }
+            while (!evt_ch_ || std::chrono::steady_clock::now() < deadline);
+
+            while (true) {
+                if (ibv_req_notify_cq(cq_, 0)) {
+                    perror("ibv_req_notify_cq");
+                    throw std::runtime_error{"ibv_req_notify_cq error"};
+                }
+
+                // A completion may have arrived between the last poll and arming the queue.
+                // It would not generate an event, so check for it before going to sleep.
+                if (const auto n = poll(_wcs, _max); n > 0) {
+                    ++stats_.spin_waits;
+                    return n;
+                }
+
+                ibv_cq* evt_cq{};
+                void* evt_cq_ctx{};
+
+                if (ibv_get_cq_event(evt_ch_, &evt_cq, &evt_cq_ctx)) {
+                    perror("ibv_get_cq_event");
+                    throw std::runtime_error{"ibv_get_cq_event error"};
+                }
+
+                if (evt_cq != cq_) {
+                    ibv_ack_cq_events(evt_cq, 1);
+                    throw std::logic_error{"completion event channel is shared with another completion queue"};
+                }
+
+                if (++unacked_events_ >= event_ack_batch_size) {
+                    ibv_ack_cq_events(cq_, unacked_events_);
+                    unacked_events_ = 0;
+                }
+
+                // The event may be stale (left over from an earlier arm whose completion
+                // was found by polling). In that case, re-arm and sleep again.
+                if (const auto n = poll(_wcs, _max); n > 0) {
+                    ++stats_.blocking_waits;
+                    return n;
+                }
+            }
+        }
+
+        auto statistics() const noexcept -> wait_statistics
+        {
+            return stats_;
+        }
+
+        auto reset_statistics() noexcept -> void
+        {
+            stats_ = {};
+        }
+
     private:
+        static constexpr std::chrono::nanoseconds default_spin_budget{std::chrono::microseconds{50}};
+        static constexpr unsigned int event_ack_batch_size = 64;
+
         ibv_cq* cq_;
+        ibv_comp_channel* evt_ch_;
+        int comp_vector_;
+        std::vector<completion_handler> handlers_;
+        completion_handler fallback_handler_;
+        std::chrono::nanoseconds spin_budget_;
+        unsigned int unacked_events_;
+        wait_statistics stats_;
     }; // class completion_queue
 } // namespace rdma
 
@@ -0,0 +1,220 @@
+#ifndef KDD_RDMA_COMPLETION_VECTOR_HPP
+#define KDD_RDMA_COMPLETION_VECTOR_HPP
+
+#include "context.hpp"
+#include "device_selection.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma
+{
+    // Hands out the completion vectors of a device round-robin, so that completion
+    // queues created with them spread their interrupts evenly, e.g.
+    //
+    //   rdma::completion_vector_allocator vectors{ctx};
+    //   rdma::completion_queue cq{size, evt_ch, vectors.next()};
+    //
+    // Thread-safe.
+    class completion_vector_allocator
+    {
+    public:
+        explicit completion_vector_allocator(const context& _ctx)
+            : size_{_ctx.num_completion_vectors()}
+            , next_{}
+        {
+            if (size_ < 1)
+                throw std::runtime_error{"device has no completion vectors"};
+        }
+
+        // Limits the allocator to the first _size vectors of the device.
+        completion_vector_allocator(const context& _ctx, int _size)
+            : completion_vector_allocator{_ctx}
+        {
+            if (_size < 1 || _size > size_)
+                throw std::invalid_argument{"completion vector count out of range"};
+
+            size_ = _size;
+        }
+
+        completion_vector_allocator(const completion_vector_allocator&) = delete;
+        auto operator=(const completion_vector_allocator&) -> completion_vector_allocator& = delete;
+
+        auto next() noexcept -> int
+        {
+            return static_cast<int>(next_.fetch_add(1, std::memory_order_relaxed) % static_cast<unsigned>(size_));
+        }
+
+        auto size() const noexcept -> int
+        {
+            return size_;
+        }
+
+    private:
+        int size_;
+        std::atomic<unsigned> next_;
+    }; // class completion_vector_allocator
+
+    // Parses a kernel CPU list such as "0-3,8,10-11".
+    inline auto parse_cpu_list(const std::string& _list) -> std::vector<int>
+    {
+        std::vector<int> cpus;
+        std::istringstream in{_list};
+        std::string range;
+
+        while (std::getline(in, range, ',')) {
+            if (range.empty())
+                continue;
+
+            const auto dash = range.find('-');
+            const auto first = std::stoi(range.substr(0, dash));
+            const auto last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+            for (auto cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+
+        return cpus;
+    }
+
+    // The CPUs of the device's NUMA node, or all online CPUs if the device does not
+    // report a node.
+    inline auto device_local_cpus(const std::string& _device_name,
+                                  const std::string& _sysfs_root = default_sysfs_root) -> std::vector<int>
+    {
+        const auto root = std::filesystem::path{_sysfs_root} / "devices" / "system";
+        const auto node = device_numa_node(_device_name, _sysfs_root);
+
+        std::optional<std::string> list;
+
+        if (node >= 0)
+            list = detail::read_first_line(root / "node" / ("node" + std::to_string(node)) / "cpulist");
+
+        if (!list)
+            list = detail::read_first_line(root / "cpu" / "online");
+
+        if (!list)
+            throw std::runtime_error{"could not read the CPU list from sysfs"};
+
+        return parse_cpu_list(*list);
+    }
+
+    inline const std::string default_procfs_root = "/proc";
+
+    namespace detail
+    {
+        // Whether an interrupt action name belongs to completion vector _comp_vector,
+        // e.g. "mlx5_comp3@pci:0000:3b:00.0" or "mlx4-comp-3@pci:0000:04:00.0".
+        inline auto names_completion_vector(const std::string& _action, int _comp_vector) -> bool
+        {
+            const auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+
+            for (auto pos = _action.find("comp"); pos != std::string::npos; pos = _action.find("comp", pos + 1)) {
+                auto first = pos + 4;
+
+                if (first < _action.size() && (_action[first] == '-' || _action[first] == '_'))
+                    ++first;
+
+                auto last = first;
+
+                while (last < _action.size() && is_digit(_action[last]))
+                    ++last;
+
+                if (last > first && last - first < 10 && std::stoi(_action.substr(first, last - first)) == _comp_vector)
+                    return true;
+            }
+
+            return false;
+        }
+    } // namespace detail
+
+    // The interrupt of completion vector _comp_vector, found among the MSI-X
+    // interrupts of the device's PCI function by the action names the driver gave
+    // them (<sysfs>/kernel/irq/<irq>/actions). Returns std::nullopt for devices
+    // without MSI-X interrupts, e.g. rxe, and drivers that name them differently.
+    inline auto completion_vector_irq(const std::string& _device_name,
+                                      int _comp_vector,
+                                      const std::string& _sysfs_root = default_sysfs_root) -> std::optional<int>
+    {
+        const auto irqs = detail::device_path(_device_name, _sysfs_root) / "device" / "msi_irqs";
+
+        for (const auto irq : detail::numbered_entries(irqs)) {
+            const auto action = detail::read_first_line(std::filesystem::path{_sysfs_root} / "kernel" / "irq" /
+                                                        std::to_string(irq) / "actions");
+
+            if (action && detail::names_completion_vector(*action, _comp_vector))
+                return irq;
+        }
+
+        return std::nullopt;
+    }
+
+    // The CPUs the interrupt is delivered to: the effective affinity the interrupt
+    // controller was programmed with if the kernel reports it, otherwise the
+    // configured affinity. Empty if neither can be read.
+    inline auto irq_affinity(int _irq, const std::string& _procfs_root = default_procfs_root) -> std::vector<int>
+    {
+        const auto irq = std::filesystem::path{_procfs_root} / "irq" / std::to_string(_irq);
+
+        for (const auto file : {"effective_affinity_list", "smp_affinity_list"}) {
+            if (const auto list = detail::read_first_line(irq / file); list && !list->empty())
+                return parse_cpu_list(*list);
+        }
+
+        return {};
+    }
+
+    // A core the interrupt of completion vector _comp_vector is delivered to, read
+    // from the interrupt's affinity (see completion_vector_irq() and irq_affinity()).
+    // If the interrupt or its affinity cannot be found, falls back to a guess:
+    // drivers such as mlx5 spread the vectors' interrupts over the cores of the
+    // device's NUMA node in order, so vector i is mapped to the i-th local core,
+    // wrapping around. irqbalance or a manual affinity setting defeats the guess.
+    inline auto cpu_for_completion_vector(const std::string& _device_name,
+                                          int _comp_vector,
+                                          const std::string& _sysfs_root = default_sysfs_root,
+                                          const std::string& _procfs_root = default_procfs_root) -> int
+    {
+        if (const auto irq = completion_vector_irq(_device_name, _comp_vector, _sysfs_root)) {
+            if (const auto affinity = irq_affinity(*irq, _procfs_root); !affinity.empty())
+                return affinity.front();
+        }
+
+        const auto cpus = device_local_cpus(_device_name, _sysfs_root);
+
+        if (cpus.empty())
+            throw std::runtime_error{"device has no local CPUs"};
+
+        return cpus[static_cast<std::size_t>(_comp_vector) % cpus.size()];
+    }
+
+    // Pins the calling thread to _cpu, e.g. the polling thread of a completion queue
+    // to cpu_for_completion_vector() of the queue's vector.
+    inline auto pin_current_thread(int _cpu) -> void
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(_cpu, &set);
+
+        if (const auto ec = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); ec != 0) {
+            fprintf(stderr, "pthread_setaffinity_np: %s\n", std::strerror(ec));
+            throw std::runtime_error{"pthread_setaffinity_np error"};
+        }
+    }
+} // namespace rdma
+
+#endif // KDD_RDMA_COMPLETION_VECTOR_HPP
@@ -12,6 +12,39 @@
 
 namespace rdma
 {
+    // An asynchronous event reported by the device, e.g. IBV_EVENT_SRQ_LIMIT_REACHED or
+    // IBV_EVENT_QP_FATAL. The event is acknowledged on destruction. Destroying the
+    // resource an event refers to blocks until all of its events are acknowledged.
+    class async_event
+    {
+    public:
+        explicit async_event(const ibv_async_event& _event) noexcept
+            : event_{_event}
+        {
+        }
+
+        async_event(const async_event&) = delete;
+        auto operator=(const async_event&) -> async_event& = delete;
+
+        ~async_event()
+        {
+            ibv_ack_async_event(&event_);
+        }
+
+        auto type() const noexcept -> ibv_event_type
+        {
+            return event_.event_type;
+        }
+
+        auto handle() const noexcept -> const ibv_async_event&
+        {
+            return event_;
+        }
+
+    private:
+        ibv_async_event event_;
+    }; // class async_event
+
     class context
     {
     public:
@@ -38,6 +71,13 @@ namespace rdma
             return *ctx_;
         }
 
+        // The number of completion vectors, i.e. interrupt vectors completion queues
+        // can be spread over. See completion_vector_allocator.
+        auto num_completion_vectors() const noexcept -> int
+        {
+            return ctx_->num_comp_vectors;
+        }
+
         auto device_info() const -> ibv_device_attr
         {
             ibv_device_attr attrs{};
@@ -86,6 +126,20 @@ namespace rdma
             return gid;
         }
 
+        // Blocks until the device reports an asynchronous event. Events are typically
+        // consumed by a dedicated thread.
+        auto wait_for_async_event() const -> async_event
+        {
+            ibv_async_event event;
+
+            if (ibv_get_async_event(ctx_, &event)) {
+                perror("ibv_get_async_event");
+                throw std::runtime_error{"ibv_get_async_event error"};
+            }
+
+            return async_event{event};
+        }
+
     private:
         ibv_context* ctx_;
     }; // class context
@@ -0,0 +1,234 @@
+#ifndef KDD_RDMA_CONTROL_CHANNEL_HPP
+#define KDD_RDMA_CONTROL_CHANNEL_HPP
+
+#include "memory_region.hpp"
+#include "utility.hpp"
+
+#include <boost/asio.hpp>
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma
+{
+    // Everything one side needs to know about a queue pair of its peer.
+    struct connection_setup
+    {
+        queue_pair_info qp;
+        remote_memory_region mr; // All zeros if the peer exposes no memory region.
+    };
+
+    // Accepts control channels on a TCP port. Keep the listener around to accept
+    // any number of channels without re-binding the port.
+    class control_listener
+    {
+    public:
+        explicit control_listener(const std::string& _port)
+            : io_context_{}
+            , acceptor_{io_context_, {boost::asio::ip::tcp::v4(), static_cast<unsigned short>(std::stoi(_port))}}
+        {
+        }
+
+        control_listener(const control_listener&) = delete;
+        auto operator=(const control_listener&) -> control_listener& = delete;
+
+        auto acceptor() noexcept -> boost::asio::ip::tcp::acceptor&
+        {
+            return acceptor_;
+        }
+
+    private:
+        boost::asio::io_context io_context_;
+        boost::asio::ip::tcp::acceptor acceptor_;
+    }; // class control_listener
+
+    // A persistent out-of-band TCP connection to a peer used to set up queue pairs.
+    //
+    // exchange_queue_pair_info() and sync_client_and_server() open a new TCP
+    // connection for every call, so connecting one QP costs two TCP handshakes on
+    // top of the two round trips. A control channel is connected once and then
+    // exchanges the information of any number of QPs in one round trip, followed
+    // by one readiness round trip (sync()) once they have reached RTS:
+    //
+    //   control_channel channel{host, port};  // or control_channel channel{listener};
+    //   channel.exchange(setups);             // QP info and MR descriptors of all QPs
+    //   ... transition every QP to RTS ...
+    //   channel.sync();                       // every QP on both sides is ready
+    //
+    // The readiness round trip cannot be folded into the exchange, because a QP must
+    // not be sent to before its peer has reached RTR. Both sides must issue the same
+    // sequence of calls. The server always reads before it writes, so large batches
+    // cannot deadlock on full socket buffers.
+    class control_channel
+    {
+    public:
+        // Connects to the server at _host:_port.
+        control_channel(const std::string& _host, const std::string& _port)
+            : io_context_{}
+            , socket_{io_context_}
+            , is_server_{false}
+            , send_buffer_{}
+            , recv_buffer_{}
+        {
+            using tcp = boost::asio::ip::tcp;
+
+            tcp::resolver resolver{io_context_};
+            boost::system::error_code ec;
+            boost::asio::connect(socket_, resolver.resolve(_host, _port, ec), ec);
+
+            if (ec)
+                throw std::runtime_error{"control_channel connect error: " + ec.message()};
+
+            socket_.set_option(tcp::no_delay{true});
+        }
+
+        // Waits for a client to connect to _listener.
+        explicit control_channel(control_listener& _listener)
+            : io_context_{}
+            , socket_{io_context_}
+            , is_server_{true}
+            , send_buffer_{}
+            , recv_buffer_{}
+        {
+            boost::system::error_code ec;
+            _listener.acceptor().accept(socket_, ec);
+
+            if (ec)
+                throw std::runtime_error{"control_channel accept error: " + ec.message()};
+
+            socket_.set_option(boost::asio::ip::tcp::no_delay{true});
+        }
+
+        control_channel(const control_channel&) = delete;
+        auto operator=(const control_channel&) -> control_channel& = delete;
+
+        // Sends the local setups and replaces them with the peer's, in order. Both
+        // sides must pass the same number of setups.
+        auto exchange(std::vector<connection_setup>& _setups) -> void
+        {
+            exchange(_setups.data(), _setups.size());
+        }
+
+        auto exchange(connection_setup* _setups, std::size_t _count) -> void
+        {
+            const auto count = static_cast<std::uint32_t>(_count);
+
+            encode(_setups, count);
+
+            if (is_server_) {
+                receive(count);
+                write(send_buffer_.data(), send_buffer_.size());
+            }
+            else {
+                write(send_buffer_.data(), send_buffer_.size());
+                receive(count);
+            }
+
+            decode(_setups, count);
+        }
+
+        auto exchange(queue_pair_info& _qp_info, remote_memory_region& _mr_info) -> void
+        {
+            connection_setup setup{_qp_info, _mr_info};
+            exchange(&setup, 1);
+            _qp_info = setup.qp;
+            _mr_info = setup.mr;
+        }
+
+        auto exchange(queue_pair_info& _qp_info) -> void
+        {
+            remote_memory_region mr{};
+            exchange(_qp_info, mr);
+        }
+
+        // Returns once the peer has called sync() as well.
+        auto sync() -> void
+        {
+            std::uint8_t token = 1;
+
+            if (is_server_) {
+                read(&token, sizeof(token));
+                write(&token, sizeof(token));
+            }
+            else {
+                write(&token, sizeof(token));
+                read(&token, sizeof(token));
+            }
+        }
+
+    private:
+        // The message is the number of setups followed by the setups, all in network
+        // byte order.
+        auto encode(const connection_setup* _setups, std::uint32_t _count) -> void
+        {
+            send_buffer_.resize(sizeof(std::uint32_t) + _count * sizeof(connection_setup));
+
+            const auto count = htonl(_count);
+            std::memcpy(send_buffer_.data(), &count, sizeof(count));
+
+            auto* out = send_buffer_.data() + sizeof(count);
+
+            for (std::uint32_t i = 0; i < _count; ++i, out += sizeof(connection_setup)) {
+                auto setup = _setups[i];
+                detail::byte_swap(setup.qp, true);
+                detail::byte_swap(setup.mr, true);
+                std::memcpy(out, &setup, sizeof(setup));
+            }
+        }
+
+        auto decode(connection_setup* _setups, std::uint32_t _count) -> void
+        {
+            const auto* in = recv_buffer_.data();
+
+            for (std::uint32_t i = 0; i < _count; ++i, in += sizeof(connection_setup)) {
+                std::memcpy(&_setups[i], in, sizeof(connection_setup));
+                detail::byte_swap(_setups[i].qp, false);
+                detail::byte_swap(_setups[i].mr, false);
+            }
+        }
+
+        auto receive(std::uint32_t _expected_count) -> void
+        {
+            std::uint32_t count;
+            read(&count, sizeof(count));
+
+            if (ntohl(count) != _expected_count)
+                throw std::runtime_error{"control_channel peer exchanged a different number of queue pairs"};
+
+            recv_buffer_.resize(_expected_count * sizeof(connection_setup));
+            read(recv_buffer_.data(), recv_buffer_.size());
+        }
+
+        auto write(const void* _data, std::size_t _size) -> void
+        {
+            boost::system::error_code ec;
+            boost::asio::write(socket_, boost::asio::buffer(_data, _size), ec);
+
+            if (ec)
+                throw std::runtime_error{"control_channel write error: " + ec.message()};
+        }
+
+        auto read(void* _data, std::size_t _size) -> void
+        {
+            boost::system::error_code ec;
+            boost::asio::read(socket_, boost::asio::buffer(_data, _size), ec);
+
+            if (ec)
+                throw std::runtime_error{"control_channel read error: " + ec.message()};
+        }
+
+        boost::asio::io_context io_context_;
+        boost::asio::ip::tcp::socket socket_;
+        bool is_server_;
+        std::vector<std::uint8_t> send_buffer_;
+        std::vector<std::uint8_t> recv_buffer_;
+    }; // class control_channel
+} // namespace rdma
+
+#endif // KDD_RDMA_CONTROL_CHANNEL_HPP
@@ -0,0 +1,452 @@
+#ifndef KDD_RDMA_COROUTINE_HPP
+#define KDD_RDMA_COROUTINE_HPP
+
+#if __cplusplus < 202002L
+    #error coroutine.hpp requires C++20
+#endif
+
+#include "completion_queue.hpp"
+#include "queue_pair.hpp"
+#include "memory_region.hpp"
+#include "work_request.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+#include <stdexcept>
+
+// Awaitable RDMA operations. A coroutine posts a work request and suspends until a
+// completion_poller sees its completion, so one thread can keep as many operations
+// in flight as the queues allow instead of one per thread:
+//
+//   rdma::completion_poller poller{cq};
+//   rdma::async_queue_pair aqp{qp, poller};
+//
+//   auto copy = [&]() -> rdma::task<> {
+//       co_await aqp.read(local, remote, offset);
+//       co_await aqp.send(local);
+//   };
+//
+//   auto t = copy();
+//   t.start();
+//
+//   while (!t.done())
+//       poller.poll();
+//
+// The wr_id of every work request is the address of the awaiting operation, which
+// lives in the coroutine frame, so completions find their coroutine without a
+// lookup table. Coroutine frames come from a per-thread frame_allocator.
+
+namespace rdma
+{
+    // Recycles coroutine frames. Freed frames are kept on per-thread free lists,
+    // one per 64 byte size class up to 4 KiB, so starting a coroutine does not
+    // touch the heap once a frame of its size has been freed on the thread.
+    // Larger frames use operator new. Frames must be freed on the thread that
+    // allocated them, which holds for coroutines resumed by a single poller.
+    class frame_allocator
+    {
+    public:
+        static auto allocate(std::size_t _size) -> void*
+        {
+            const auto c = size_class(_size);
+
+            if (c >= class_count)
+                return ::operator new(_size);
+
+            auto& head = free_lists()[c];
+
+            if (head) {
+                auto* block = head;
+                head = block->next;
+                return block;
+            }
+
+            return ::operator new((c + 1) * granularity);
+        }
+
+        static auto deallocate(void* _p, std::size_t _size) noexcept -> void
+        {
+            const auto c = size_class(_size);
+
+            if (c >= class_count) {
+                ::operator delete(_p);
+                return;
+            }
+
+            auto& head = free_lists()[c];
+            head = new (_p) free_block{head};
+        }
+
+    private:
+        static constexpr std::size_t granularity = 64;
+        static constexpr std::size_t class_count = 64;
+
+        struct free_block
+        {
+            free_block* next;
+        };
+
+        // The free lists live as long as the thread. Their blocks are never returned
+        // to the heap.
+        static auto free_lists() noexcept -> std::array<free_block*, class_count>&
+        {
+            thread_local std::array<free_block*, class_count> lists{};
+            return lists;
+        }
+
+        static constexpr auto size_class(std::size_t _size) noexcept -> std::size_t
+        {
+            return (std::max<std::size_t>(_size, 1) - 1) / granularity;
+        }
+    }; // class frame_allocator
+
+    template <typename T>
+    class task;
+
+    namespace detail
+    {
+        struct task_promise_base
+        {
+            // Resumes whoever awaited the task when it finishes.
+            struct final_awaiter
+            {
+                auto await_ready() const noexcept -> bool
+                {
+                    return false;
+                }
+
+                template <typename Promise>
+                auto await_suspend(std::coroutine_handle<Promise> _h) noexcept -> std::coroutine_handle<>
+                {
+                    if (auto c = _h.promise().continuation_; c)
+                        return c;
+
+                    return std::noop_coroutine();
+                }
+
+                auto await_resume() const noexcept -> void
+                {
+                }
+            };
+
+            static auto operator new(std::size_t _size) -> void*
+            {
+                return frame_allocator::allocate(_size);
+            }
+
+            static auto operator delete(void* _p, std::size_t _size) noexcept -> void
+            {
+                frame_allocator::deallocate(_p, _size);
+            }
+
+            auto initial_suspend() const noexcept -> std::suspend_always
+            {
+                return {};
+            }
+
+            auto final_suspend() const noexcept -> final_awaiter
+            {
+                return {};
+            }
+
+            auto unhandled_exception() noexcept -> void
+            {
+                exception_ = std::current_exception();
+            }
+
+            std::coroutine_handle<> continuation_;
+            std::exception_ptr exception_;
+        };
+
+        template <typename T>
+        struct task_promise : task_promise_base
+        {
+            auto get_return_object() noexcept -> task<T>;
+
+            template <typename U>
+            auto return_value(U&& _value) -> void
+            {
+                value_.emplace(std::forward<U>(_value));
+            }
+
+            auto result() -> T
+            {
+                if (exception_)
+                    std::rethrow_exception(exception_);
+
+                return std::move(*value_);
+            }
+
+            std::optional<T> value_;
+        };
+
+        template <>
+        struct task_promise<void> : task_promise_base
+        {
+            auto get_return_object() noexcept -> task<void>;
+
+            auto return_void() noexcept -> void
+            {
+            }
+
+            auto result() -> void
+            {
+                if (exception_)
+                    std::rethrow_exception(exception_);
+            }
+        };
+    } // namespace detail
+
+    // A lazily started coroutine. Awaiting a task runs it and resumes the awaiting
+    // coroutine when it finishes. A top-level task is started with start() and
+    // driven by polling until done(). The frame is destroyed with the task.
+    template <typename T = void>
+    class task
+    {
+    public:
+        using promise_type = detail::task_promise<T>;
+
+        explicit task(std::coroutine_handle<promise_type> _h) noexcept
+            : h_{_h}
+        {
+        }
+
+        task(task&& _other) noexcept
+            : h_{std::exchange(_other.h_, nullptr)}
+        {
+        }
+
+        task(const task&) = delete;
+        auto operator=(const task&) -> task& = delete;
+
+        auto operator=(task&& _other) noexcept -> task&
+        {
+            if (this != &_other) {
+                if (h_)
+                    h_.destroy();
+
+                h_ = std::exchange(_other.h_, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~task()
+        {
+            if (h_)
+                h_.destroy();
+        }
+
+        // Runs the task until its first suspension point.
+        auto start() -> void
+        {
+            h_.resume();
+        }
+
+        auto done() const noexcept -> bool
+        {
+            return h_.done();
+        }
+
+        // The value the task returned. Rethrows the exception it ended with.
+        auto result() -> T
+        {
+            return h_.promise().result();
+        }
+
+        auto operator co_await() noexcept
+        {
+            struct awaiter
+            {
+                auto await_ready() const noexcept -> bool
+                {
+                    return h_.done();
+                }
+
+                auto await_suspend(std::coroutine_handle<> _awaiting) noexcept -> std::coroutine_handle<>
+                {
+                    h_.promise().continuation_ = _awaiting;
+                    return h_;
+                }
+
+                auto await_resume() -> T
+                {
+                    return h_.promise().result();
+                }
+
+                std::coroutine_handle<promise_type> h_;
+            };
+
+            return awaiter{h_};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> h_;
+    }; // class task
+
+    namespace detail
+    {
+        template <typename T>
+        auto task_promise<T>::get_return_object() noexcept -> task<T>
+        {
+            return task<T>{std::coroutine_handle<task_promise<T>>::from_promise(*this)};
+        }
+
+        inline auto task_promise<void>::get_return_object() noexcept -> task<void>
+        {
+            return task<void>{std::coroutine_handle<task_promise<void>>::from_promise(*this)};
+        }
+    } // namespace detail
+
+    // A work request a coroutine is suspended on. Its address is the wr_id.
+    struct pending_operation
+    {
+        std::coroutine_handle<> handle;
+        ibv_wc wc;
+    };
+
+    // Resumes the coroutines whose work requests complete on a completion queue.
+    // Every work request reaching the queue must come from an async_queue_pair
+    // using this poller.
+    class completion_poller
+    {
+    public:
+        explicit completion_poller(const completion_queue& _cq)
+            : cq_{&_cq}
+        {
+        }
+
+        completion_poller(const completion_poller&) = delete;
+        auto operator=(const completion_poller&) -> completion_poller& = delete;
+
+        // Non-blocking. Polls up to _max completions and resumes their coroutines.
+        // Returns the number of completions.
+        auto poll(int _max = poll_batch_size) -> int
+        {
+            ibv_wc wcs[poll_batch_size];
+            const auto n = cq_->poll(wcs, std::min(_max, poll_batch_size));
+
+            for (int i = 0; i < n; ++i) {
+                auto* op = reinterpret_cast<pending_operation*>(static_cast<std::uintptr_t>(wcs[i].wr_id));
+                op->wc = wcs[i];
+                op->handle.resume();
+            }
+
+            return n;
+        }
+
+    private:
+        static constexpr int poll_batch_size = 32;
+
+        const completion_queue* cq_;
+    }; // class completion_poller
+
+    // Awaitable operations on a queue pair. co_await returns the work completion
+    // and throws std::runtime_error if it carries an error status.
+    //
+    // Every send work request must generate a completion, so the QP must not use
+    // selective signaling (see queue_pair::set_signal_interval()). The caller is
+    // responsible for not posting more operations than the queues hold.
+    class async_queue_pair
+    {
+    public:
+        async_queue_pair(queue_pair& _qp, completion_poller& _poller)
+            : qp_{&_qp}
+            , poller_{&_poller}
+        {
+        }
+
+        template <typename Post>
+        class operation : private pending_operation
+        {
+        public:
+            explicit operation(Post _post)
+                : pending_operation{}
+                , post_{std::move(_post)}
+            {
+            }
+
+            auto await_ready() const noexcept -> bool
+            {
+                return false;
+            }
+
+            // Posts the work request after suspending, so the completion can never
+            // arrive before the coroutine is ready to be resumed.
+            auto await_suspend(std::coroutine_handle<> _h) -> void
+            {
+                handle = _h;
+                post_(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(static_cast<pending_operation*>(this))));
+            }
+
+            auto await_resume() const -> ibv_wc
+            {
+                if (wc.status != IBV_WC_SUCCESS)
+                    throw std::runtime_error{ibv_wc_status_str(wc.status)};
+
+                return wc;
+            }
+
+        private:
+            Post post_;
+        }; // class operation
+
+        auto send(buffer_descriptor _buffer)
+        {
+            return make_operation([qp = qp_, _buffer](std::uint64_t _wr_id) mutable {
+                _buffer.wr_id = _wr_id;
+                qp->post_send(&_buffer, 1);
+            });
+        }
+
+        auto receive(buffer_descriptor _buffer)
+        {
+            return make_operation([qp = qp_, _buffer](std::uint64_t _wr_id) mutable {
+                _buffer.wr_id = _wr_id;
+                qp->post_receive(&_buffer, 1);
+            });
+        }
+
+        auto write(buffer_descriptor _local, const remote_memory_region& _remote, std::uint64_t _remote_offset)
+        {
+            return make_operation([qp = qp_, _local, _remote, _remote_offset](std::uint64_t _wr_id) mutable {
+                _local.wr_id = _wr_id;
+                qp->post_write(_local, _remote, _remote_offset);
+            });
+        }
+
+        auto read(buffer_descriptor _local, const remote_memory_region& _remote, std::uint64_t _remote_offset)
+        {
+            return make_operation([qp = qp_, _local, _remote, _remote_offset](std::uint64_t _wr_id) mutable {
+                _local.wr_id = _wr_id;
+                qp->post_read(_local, _remote, _remote_offset);
+            });
+        }
+
+        auto poller() noexcept -> completion_poller&
+        {
+            return *poller_;
+        }
+
+    private:
+        template <typename Post>
+        static auto make_operation(Post _post) -> operation<Post>
+        {
+            return operation<Post>{std::move(_post)};
+        }
+
+        queue_pair* qp_;
+        completion_poller* poller_;
+    }; // class async_queue_pair
+} // namespace rdma
+
+#endif // KDD_RDMA_COROUTINE_HPP
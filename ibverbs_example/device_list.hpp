@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <errno.h>
 
+#include <cstring>
 #include <stdexcept>
 
 namespace rdma
@@ -72,6 +73,17 @@ namespace rdma
             return device{*devices_[_index]};
         }
 
+        // Looks a device up by name, e.g. one chosen by select_port().
+        auto operator[](const char* _name) const -> device
+        {
+            for (int i = 0; i < num_devices_; ++i) {
+                if (std::strcmp(ibv_get_device_name(devices_[i]), _name) == 0)
+                    return device{*devices_[i]};
+            }
+
+            throw std::out_of_range{"device not found"};
+        }
+
         auto size() const noexcept -> int
         {
             return num_devices_;
@@ -0,0 +1,263 @@
+#ifndef KDD_RDMA_DEVICE_SELECTION_HPP
+#define KDD_RDMA_DEVICE_SELECTION_HPP
+
+#include <infiniband/verbs.h>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Picks the RDMA device, port and GID to use from the device tree the kernel
+// exposes in sysfs, so that a process does not have to be told which device is
+// attached to its socket or which GID index holds the RoCE v2 address:
+//
+//   <sysfs>/class/infiniband/<device>/device/numa_node
+//   <sysfs>/class/infiniband/<device>/ports/<port>/state
+//   <sysfs>/class/infiniband/<device>/ports/<port>/link_layer
+//   <sysfs>/class/infiniband/<device>/ports/<port>/gids/<index>
+//   <sysfs>/class/infiniband/<device>/ports/<port>/gid_attrs/types/<index>
+//
+// Every function takes the sysfs mount point, so selection can be run against a
+// directory tree laid out like the one above instead of the live system.
+
+namespace rdma
+{
+    inline const std::string default_sysfs_root = "/sys";
+
+    // The RDMA port chosen by select_port(). Open the device with
+    // device_list::operator[](device_name.c_str()).
+    struct port_selection
+    {
+        std::string device_name;
+        int numa_node;            // -1 if the device does not report one.
+        std::uint8_t port_number;
+        int gid_index;
+        bool roce;                // The port's link layer is Ethernet.
+    };
+
+    namespace detail
+    {
+        inline auto read_first_line(const std::filesystem::path& _path) -> std::optional<std::string>
+        {
+            std::ifstream in{_path};
+            std::string line;
+
+            // Unset entries of the GID attribute tables fail to read.
+            if (!std::getline(in, line))
+                return std::nullopt;
+
+            return line;
+        }
+
+        // The numeric names in _dir, e.g. the port numbers or GID indexes, sorted.
+        inline auto numbered_entries(const std::filesystem::path& _dir) -> std::vector<int>
+        {
+            std::vector<int> entries;
+            std::error_code ec;
+
+            for (const auto& e : std::filesystem::directory_iterator{_dir, ec}) {
+                const auto name = e.path().filename().string();
+
+                if (!name.empty() && std::all_of(name.begin(), name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+                    entries.push_back(std::stoi(name));
+            }
+
+            std::sort(entries.begin(), entries.end());
+            return entries;
+        }
+
+        inline auto device_path(const std::string& _device_name, const std::string& _sysfs_root) -> std::filesystem::path
+        {
+            return std::filesystem::path{_sysfs_root} / "class" / "infiniband" / _device_name;
+        }
+
+        inline auto parse_gid(const std::string& _text) -> std::optional<ibv_gid>
+        {
+            // sysfs prints GIDs as eight groups of four hex digits, which inet_pton accepts.
+            ibv_gid gid{};
+
+            if (inet_pton(AF_INET6, _text.c_str(), gid.raw) != 1)
+                return std::nullopt;
+
+            return gid;
+        }
+
+        inline auto is_zero(const ibv_gid& _gid) noexcept -> bool
+        {
+            return std::all_of(std::begin(_gid.raw), std::end(_gid.raw), [](std::uint8_t b) { return b == 0; });
+        }
+
+        inline auto is_ipv4_mapped(const ibv_gid& _gid) noexcept -> bool
+        {
+            return std::all_of(_gid.raw, _gid.raw + 10, [](std::uint8_t b) { return b == 0; }) &&
+                   _gid.raw[10] == 0xff && _gid.raw[11] == 0xff;
+        }
+
+        inline auto is_link_local(const ibv_gid& _gid) noexcept -> bool
+        {
+            return _gid.raw[0] == 0xfe && (_gid.raw[1] & 0xc0) == 0x80;
+        }
+    } // namespace detail
+
+    // The NUMA node of the CPU the calling thread is running on, or -1 if it cannot
+    // be determined. Threads that are not pinned may move to another node later.
+    inline auto current_numa_node() -> int
+    {
+        unsigned cpu = 0;
+        unsigned node = 0;
+
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+            return -1;
+
+        return static_cast<int>(node);
+    }
+
+    // The names of all RDMA devices, sorted.
+    inline auto rdma_device_names(const std::string& _sysfs_root = default_sysfs_root) -> std::vector<std::string>
+    {
+        std::vector<std::string> names;
+        std::error_code ec;
+
+        for (const auto& e : std::filesystem::directory_iterator{std::filesystem::path{_sysfs_root} / "class" / "infiniband", ec})
+            names.push_back(e.path().filename().string());
+
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    // The NUMA node the device is attached to, or -1 if unknown (e.g. single node
+    // systems and software devices such as rxe).
+    inline auto device_numa_node(const std::string& _device_name, const std::string& _sysfs_root = default_sysfs_root) -> int
+    {
+        const auto line = detail::read_first_line(detail::device_path(_device_name, _sysfs_root) / "device" / "numa_node");
+        return line ? std::stoi(*line) : -1;
+    }
+
+    // The ports of the device in the ACTIVE state, in order.
+    inline auto find_active_ports(const std::string& _device_name,
+                                  const std::string& _sysfs_root = default_sysfs_root) -> std::vector<std::uint8_t>
+    {
+        const auto ports = detail::device_path(_device_name, _sysfs_root) / "ports";
+        std::vector<std::uint8_t> active;
+
+        for (const auto port : detail::numbered_entries(ports)) {
+            // The state reads like "4: ACTIVE".
+            const auto state = detail::read_first_line(ports / std::to_string(port) / "state");
+
+            if (state && std::stoi(*state) == IBV_PORT_ACTIVE)
+                active.push_back(static_cast<std::uint8_t>(port));
+        }
+
+        return active;
+    }
+
+    // The first port of the device in the ACTIVE state.
+    inline auto find_active_port(const std::string& _device_name,
+                                 const std::string& _sysfs_root = default_sysfs_root) -> std::optional<std::uint8_t>
+    {
+        const auto ports = find_active_ports(_device_name, _sysfs_root);
+
+        if (ports.empty())
+            return std::nullopt;
+
+        return ports.front();
+    }
+
+    // The GID index to use on the port. InfiniBand ports use index 0. On RoCE ports
+    // the RoCE v2 entries are preferred, IPv4 addresses over global IPv6 addresses
+    // over link-local ones. Ports without a RoCE v2 entry fall back to the first
+    // valid RoCE v1 entry. Returns std::nullopt if the GID table holds no usable entry.
+    inline auto find_gid_index(const std::string& _device_name,
+                               std::uint8_t _port_number,
+                               const std::string& _sysfs_root = default_sysfs_root) -> std::optional<int>
+    {
+        const auto port = detail::device_path(_device_name, _sysfs_root) / "ports" / std::to_string(_port_number);
+
+        if (detail::read_first_line(port / "link_layer").value_or("") != "Ethernet")
+            return 0;
+
+        std::optional<int> best;
+        int best_rank = 0;
+
+        for (const auto index : detail::numbered_entries(port / "gids")) {
+            const auto text = detail::read_first_line(port / "gids" / std::to_string(index));
+            const auto gid = text ? detail::parse_gid(*text) : std::nullopt;
+
+            if (!gid || detail::is_zero(*gid))
+                continue;
+
+            const auto type = detail::read_first_line(port / "gid_attrs" / "types" / std::to_string(index));
+
+            if (!type)
+                continue;
+
+            int rank = 1;
+
+            if (*type == "RoCE v2") {
+                if (detail::is_ipv4_mapped(*gid))
+                    rank = 4;
+                else if (!detail::is_link_local(*gid))
+                    rank = 3;
+                else
+                    rank = 2;
+            }
+
+            if (rank > best_rank) {
+                best = index;
+                best_rank = rank;
+            }
+        }
+
+        return best;
+    }
+
+    // Selects the first device (by name) on _numa_node that has an active port with
+    // a usable GID, together with that port and GID. All active ports of a device
+    // are tried in order, so a port without an address (e.g. a RoCE port with no IP
+    // configured) does not rule out the device. Devices on other nodes, or
+    // whose node is unknown, are only considered if no device on _numa_node
+    // qualifies. Pass current_numa_node() to stay local to the calling thread.
+    inline auto select_port(int _numa_node, const std::string& _sysfs_root = default_sysfs_root) -> port_selection
+    {
+        std::optional<port_selection> remote;
+
+        for (const auto& name : rdma_device_names(_sysfs_root)) {
+            for (const auto port : find_active_ports(name, _sysfs_root)) {
+                const auto gid_index = find_gid_index(name, port, _sysfs_root);
+
+                if (!gid_index)
+                    continue;
+
+                const auto link_layer = detail::read_first_line(detail::device_path(name, _sysfs_root) / "ports" /
+                                                                std::to_string(port) / "link_layer");
+
+                port_selection s{name, device_numa_node(name, _sysfs_root), port, *gid_index,
+                                 link_layer.value_or("") == "Ethernet"};
+
+                if (s.numa_node == _numa_node && _numa_node >= 0)
+                    return s;
+
+                if (!remote)
+                    remote = s;
+
+                break;
+            }
+        }
+
+        if (!remote)
+            throw std::runtime_error{"no RDMA device with an active port found"};
+
+        return *remote;
+    }
+} // namespace rdma
+
+#endif // KDD_RDMA_DEVICE_SELECTION_HPP
@@ -0,0 +1,377 @@
+#ifndef KDD_RDMA_ENGINE_HPP
+#define KDD_RDMA_ENGINE_HPP
+
+#include "context.hpp"
+#include "protection_domain.hpp"
+#include "completion_queue.hpp"
+#include "completion_vector.hpp"
+#include "queue_pair.hpp"
+#include "buffer_pool.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma
+{
+    struct engine_config
+    {
+        std::size_t workers = 0; // Zero uses one worker per core of the device's NUMA node.
+        int cqe_size = 4096;     // Shared by all QPs of a worker.
+        std::vector<size_class> buffer_classes = {{4096, 1024}};
+        int access_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+        bool pin_threads = true; // Pins worker i to the i-th core of the device's NUMA node.
+    };
+
+    class engine;
+
+    // One shard of an engine: a thread with its own completion queue, queue pairs
+    // and buffer pool. Everything a worker owns is only touched by its thread, so
+    // the data path takes no locks. Other threads hand work to it through
+    // engine::run_on(). If the worker stops because of an exception, its pending
+    // and later tasks complete with that exception until the engine is restarted.
+    class engine_worker
+    {
+    public:
+        using completion_handler = std::function<void(engine_worker&, const ibv_wc&)>;
+
+        engine_worker(const engine_worker&) = delete;
+        auto operator=(const engine_worker&) -> engine_worker& = delete;
+
+        auto index() const noexcept -> std::size_t
+        {
+            return index_;
+        }
+
+        // The core the worker is pinned to, or -1.
+        auto cpu() const noexcept -> int
+        {
+            return cpu_;
+        }
+
+        auto cq() noexcept -> completion_queue&
+        {
+            return cq_;
+        }
+
+        auto pool() noexcept -> buffer_pool&
+        {
+            return pool_;
+        }
+
+        // Creates a QP whose send and receive completions go to this worker's
+        // completion queue. Call it on the worker's thread (see engine::run_on()),
+        // or before the engine is started.
+        auto create_queue_pair(ibv_qp_init_attr _attrs) -> queue_pair&
+        {
+            _attrs.send_cq = &cq_.handle();
+            _attrs.recv_cq = &cq_.handle();
+
+            qps_.push_back(std::make_unique<queue_pair>(*pd_, _attrs, cq_));
+            return *qps_.back();
+        }
+
+        auto queue_pair_count() const noexcept -> std::size_t
+        {
+            return qps_.size();
+        }
+
+        auto queue_pair_at(std::size_t _index) -> queue_pair&
+        {
+            return *qps_.at(_index);
+        }
+
+        // Called on the worker's thread for every completion of its queue. Set it
+        // before the engine is started, or from the worker's thread.
+        auto set_completion_handler(completion_handler _handler) -> void
+        {
+            handler_ = std::move(_handler);
+        }
+
+        friend class engine;
+
+    private:
+        engine_worker(std::size_t _index,
+                      const context& _ctx,
+                      const protection_domain& _pd,
+                      const engine_config& _config,
+                      int _cpu)
+            : index_{_index}
+            , cpu_{_cpu}
+            , pd_{&_pd}
+            , cq_{_config.cqe_size, _ctx, static_cast<int>(_index % static_cast<std::size_t>(std::max(1, _ctx.num_completion_vectors())))}
+            , pool_{_pd, _config.buffer_classes, _config.access_flags}
+            , qps_{}
+            , handler_{}
+            , tasks_mutex_{}
+            , tasks_{}
+            , has_tasks_{false}
+            , error_{}
+        {
+        }
+
+        // Called with a null exception_ptr to run the task on the worker's thread, or
+        // with the worker's error to complete it without running it.
+        using task = std::function<void(engine_worker&, std::exception_ptr)>;
+
+        auto post(task _task) -> void
+        {
+            std::unique_lock<std::mutex> lock{tasks_mutex_};
+
+            if (error_) {
+                const auto error = error_;
+                lock.unlock();
+                _task(*this, error);
+                return;
+            }
+
+            tasks_.push_back(std::move(_task));
+            has_tasks_.store(true, std::memory_order_release);
+        }
+
+        auto run_tasks() -> void
+        {
+            std::vector<task> tasks;
+
+            {
+                std::lock_guard<std::mutex> lock{tasks_mutex_};
+                tasks.swap(tasks_);
+                has_tasks_.store(false, std::memory_order_relaxed);
+            }
+
+            for (auto& t : tasks)
+                t(*this, nullptr);
+        }
+
+        // Completes the pending tasks with _error, and every task posted until the
+        // worker runs again.
+        auto fail_tasks(std::exception_ptr _error) -> void
+        {
+            std::vector<task> tasks;
+
+            {
+                std::lock_guard<std::mutex> lock{tasks_mutex_};
+                error_ = _error;
+                tasks.swap(tasks_);
+                has_tasks_.store(false, std::memory_order_relaxed);
+            }
+
+            for (auto& t : tasks)
+                t(*this, _error);
+        }
+
+        // Lets the worker take tasks again after it failed. Called before it is restarted.
+        auto clear_error() -> void
+        {
+            std::lock_guard<std::mutex> lock{tasks_mutex_};
+            error_ = nullptr;
+        }
+
+        auto run(const std::atomic<bool>& _running) -> void
+        {
+            try {
+                if (cpu_ >= 0)
+                    pin_current_thread(cpu_);
+
+                constexpr int poll_batch_size = 32;
+                ibv_wc wcs[poll_batch_size];
+
+                while (_running.load(std::memory_order_relaxed)) {
+                    // A single load on the data path. The lock is only taken if there is work.
+                    if (has_tasks_.load(std::memory_order_acquire))
+                        run_tasks();
+
+                    const auto n = cq_.poll(wcs, poll_batch_size);
+
+                    for (int i = 0; i < n && handler_; ++i)
+                        handler_(*this, wcs[i]);
+                }
+            }
+            catch (...) {
+                // Nobody would run the queued tasks, so their futures would never be ready.
+                fail_tasks(std::current_exception());
+                throw;
+            }
+
+            // Tasks posted after the last iteration still complete their futures.
+            run_tasks();
+        }
+
+        std::size_t index_;
+        int cpu_;
+        const protection_domain* pd_;
+        completion_queue cq_;
+        buffer_pool pool_;
+        std::vector<std::unique_ptr<queue_pair>> qps_;
+        completion_handler handler_;
+
+        std::mutex tasks_mutex_;
+        std::vector<task> tasks_;
+        std::atomic<bool> has_tasks_;
+        std::exception_ptr error_;      // Why the worker stopped, if it failed.
+    }; // class engine_worker
+
+    // A shared-nothing threading model for the wrappers. The engine starts one
+    // busy-polling worker thread per shard, pinned to a core near the device. Each
+    // worker owns its completion queue, queue pairs and buffer pool, and
+    // connections are spread over the workers by assign(). Since no two threads
+    // ever share a QP or a CQ, the single caller assumptions of queue_pair hold
+    // and the message rate scales with the number of workers.
+    //
+    //   rdma::engine eng{ctx, pd};
+    //   auto& w = eng.assign();
+    //   auto& qp = w.create_queue_pair(attrs);
+    //   // Connect qp, set w's completion handler ...
+    //   eng.start();
+    //   eng.run_on(w.index(), [&](rdma::engine_worker&) { qp.post_send(...); });
+    class engine
+    {
+    public:
+        engine(const context& _ctx, const protection_domain& _pd, const engine_config& _config = {})
+            : workers_{}
+            , threads_{}
+            , errors_{}
+            , running_{false}
+            , failed_{false}
+            , next_{}
+        {
+            std::vector<int> cpus;
+
+            if (_config.pin_threads || _config.workers == 0)
+                cpus = device_local_cpus(ibv_get_device_name(_ctx.handle().device));
+
+            const auto count = _config.workers > 0 ? _config.workers : std::max<std::size_t>(1, cpus.size());
+
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto cpu = _config.pin_threads && !cpus.empty() ? cpus[i % cpus.size()] : -1;
+                workers_.push_back(std::unique_ptr<engine_worker>{new engine_worker{i, _ctx, _pd, _config, cpu}});
+            }
+        }
+
+        engine(const engine&) = delete;
+        auto operator=(const engine&) -> engine& = delete;
+
+        ~engine()
+        {
+            try {
+                stop();
+            }
+            catch (...) {
+                // Worker errors are only reported by an explicit stop().
+            }
+        }
+
+        auto start() -> void
+        {
+            if (running_.exchange(true))
+                return;
+
+            errors_.assign(workers_.size(), nullptr);
+
+            for (auto& w : workers_)
+                w->clear_error();
+
+            for (std::size_t i = 0; i < workers_.size(); ++i) {
+                threads_.emplace_back([this, i] {
+                    try {
+                        workers_[i]->run(running_);
+                    }
+                    catch (...) {
+                        errors_[i] = std::current_exception();
+                        failed_.store(true);
+                    }
+                });
+            }
+        }
+
+        // True once a worker has stopped because of an exception. The other workers
+        // keep running until stop(). Tasks given to the failed worker by run_on()
+        // complete with its exception.
+        auto failed() const noexcept -> bool
+        {
+            return failed_.load();
+        }
+
+        // Stops and joins all workers. Rethrows the first exception a worker or one
+        // of its completion handlers threw. Tasks given to run_on() afterwards are
+        // run by the next start().
+        auto stop() -> void
+        {
+            running_.store(false);
+
+            for (auto& t : threads_)
+                t.join();
+
+            threads_.clear();
+            failed_.store(false);
+
+            for (auto& e : errors_) {
+                if (e)
+                    std::rethrow_exception(std::exchange(e, nullptr));
+            }
+        }
+
+        auto size() const noexcept -> std::size_t
+        {
+            return workers_.size();
+        }
+
+        auto at(std::size_t _index) -> engine_worker&
+        {
+            return *workers_.at(_index);
+        }
+
+        // The worker that should own the next connection. Connections are spread
+        // round-robin.
+        auto assign() noexcept -> engine_worker&
+        {
+            return *workers_[next_.fetch_add(1, std::memory_order_relaxed) % workers_.size()];
+        }
+
+        // Runs _f(worker) on the worker's thread and returns its result through a future.
+        // If the worker has stopped or stops because of an exception before running
+        // _f, the future holds that exception instead.
+        template <typename F>
+        auto run_on(std::size_t _index, F _f) -> std::future<std::invoke_result_t<F, engine_worker&>>
+        {
+            using result_type = std::invoke_result_t<F, engine_worker&>;
+
+            auto task = std::make_shared<std::packaged_task<result_type(engine_worker&, std::exception_ptr)>>(
+                [f = std::move(_f)](engine_worker& _w, std::exception_ptr _error) mutable -> result_type {
+                    if (_error)
+                        std::rethrow_exception(_error);
+
+                    return f(_w);
+                });
+
+            auto result = task->get_future();
+
+            workers_.at(_index)->post([task](engine_worker& _w, std::exception_ptr _error) { (*task)(_w, _error); });
+
+            return result;
+        }
+
+    private:
+        std::vector<std::unique_ptr<engine_worker>> workers_;
+        std::vector<std::thread> threads_;
+        std::vector<std::exception_ptr> errors_;
+        std::atomic<bool> running_;
+        std::atomic<bool> failed_;
+        std::atomic<std::size_t> next_;
+    }; // class engine
+} // namespace rdma
+
+#endif // KDD_RDMA_ENGINE_HPP
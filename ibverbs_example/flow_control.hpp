@@ -0,0 +1,217 @@
+#ifndef KDD_RDMA_FLOW_CONTROL_HPP
+#define KDD_RDMA_FLOW_CONTROL_HPP
+
+#include "context.hpp"
+#include "queue_pair.hpp"
+#include "work_request.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <stdexcept>
+
+namespace rdma
+{
+    struct flow_control_counters
+    {
+        std::uint64_t sends;          // Messages posted to the send queue.
+        std::uint64_t credit_stalls;  // Messages queued locally because the peer had no receive to spare.
+        std::uint64_t credit_updates; // Credit-only messages sent because no message was going out.
+        std::size_t max_queued;       // The most messages queued locally at once.
+    };
+
+    // Credit-based flow control for SENDs over an RC queue pair. Every receive the
+    // peer has posted is one credit. A message is only posted while a credit is
+    // available, so it always finds a receive and the QP never goes through the
+    // RNR NAK and min_rnr_timer backoff of the NIC. Without credits, messages are
+    // queued locally and posted as soon as the peer returns credits.
+    //
+    // Credits are returned in the immediate data of every message: bit 31 marks a
+    // credit-only message, bits 0 to 30 hold the number of receives re-posted since
+    // the last message. If nothing is going out, a zero-length credit-only message
+    // is sent once update_threshold receives of data messages have been re-posted,
+    // or right away if the peer is about to run out. Receives of credit-only
+    // messages do not count toward update_threshold, so two idle peers never answer
+    // each other's updates with updates; their credits travel with the next message.
+    // The last credit is reserved for these updates, so two peers can never wait for
+    // each other's credits.
+    //
+    // Both sides of the QP must use a credit_flow_control and send everything
+    // through it. Receives are re-posted through post_receive(), and every receive
+    // completion must be handed to on_receive(). Send completions of credit updates
+    // carry credit_update_wr_id. The send queue must hold send_credits work
+    // requests. Not thread-safe.
+    class credit_flow_control
+    {
+    public:
+        static constexpr std::uint64_t credit_update_wr_id = ~std::uint64_t{0};
+
+        // _send_credits is the number of receives the peer posts before the QP is
+        // connected, _receive_credits the number this side posts. The initial
+        // receives are posted directly on the QP, not through post_receive().
+        credit_flow_control(queue_pair& _qp,
+                            std::uint32_t _send_credits,
+                            std::uint32_t _receive_credits,
+                            std::uint32_t _update_threshold)
+            : qp_{&_qp}
+            , credits_{_send_credits}
+            , peer_credits_{_receive_credits}
+            , pending_returns_{}
+            , update_returns_{}
+            , update_threshold_{_update_threshold}
+            , queued_{}
+            , counters_{}
+        {
+            if (_send_credits < 2 || _receive_credits < 2)
+                throw std::invalid_argument{"credit flow control needs at least two receives per side"};
+
+            if (_update_threshold == 0 || _update_threshold > _receive_credits)
+                throw std::invalid_argument{"credit update threshold out of range"};
+        }
+
+        credit_flow_control(const credit_flow_control&) = delete;
+        auto operator=(const credit_flow_control&) -> credit_flow_control& = delete;
+
+        // Posts the message if the peer has a receive to spare, otherwise queues it.
+        // The buffer must stay valid until the send completes. Returns false if the
+        // message was queued.
+        auto send(const buffer_descriptor& _buffer) -> bool
+        {
+            if (!queued_.empty() || credits_ <= 1) {
+                queued_.push_back(_buffer);
+                counters_.max_queued = std::max(counters_.max_queued, queued_.size());
+                ++counters_.credit_stalls;
+                return false;
+            }
+
+            post(_buffer, 0);
+            return true;
+        }
+
+        // Re-posts receives whose messages have been consumed and returns them to
+        // the peer as credits.
+        auto post_receive(const buffer_descriptor* _buffers, std::size_t _count) -> void
+        {
+            qp_->post_receive(_buffers, _count);
+            pending_returns_ += static_cast<std::uint32_t>(_count);
+            maybe_send_update();
+        }
+
+        // Takes the credits returned by a receive completion and posts queued
+        // messages they allow. Returns false if the completion belongs to a
+        // credit-only message, whose buffer holds no data but must be re-posted
+        // like any other.
+        auto on_receive(const ibv_wc& _wc) -> bool
+        {
+            const auto imm = (_wc.wc_flags & IBV_WC_WITH_IMM) ? ntohl(_wc.imm_data) : 0;
+
+            --peer_credits_;
+            credits_ += imm & credit_count_mask;
+
+            if (imm & credit_only_flag)
+                ++update_returns_;
+
+            flush();
+            maybe_send_update();
+
+            return (imm & credit_only_flag) == 0;
+        }
+
+        // The number of receives the peer has posted that this side may still use.
+        auto credits() const noexcept -> std::uint32_t
+        {
+            return credits_;
+        }
+
+        auto queued() const noexcept -> std::size_t
+        {
+            return queued_.size();
+        }
+
+        auto counters() const noexcept -> const flow_control_counters&
+        {
+            return counters_;
+        }
+
+    private:
+        static constexpr std::uint32_t credit_only_flag = std::uint32_t{1} << 31;
+        static constexpr std::uint32_t credit_count_mask = credit_only_flag - 1;
+
+        // Posts a message carrying all pending credit returns.
+        auto post(const buffer_descriptor& _buffer, std::uint32_t _flags) -> void
+        {
+            qp_->post_send_with_imm(_buffer, _flags | pending_returns_);
+
+            --credits_;
+            peer_credits_ += pending_returns_;
+            update_returns_ -= std::min(update_returns_, pending_returns_);
+            pending_returns_ = 0;
+
+            if (_flags == 0)
+                ++counters_.sends;
+        }
+
+        auto flush() -> void
+        {
+            while (!queued_.empty() && credits_ > 1) {
+                post(queued_.front(), 0);
+                queued_.pop_front();
+            }
+        }
+
+        auto maybe_send_update() -> void
+        {
+            if (pending_returns_ == 0 || credits_ == 0)
+                return;
+
+            // Which of the re-posted receives held updates is unknown, so they are
+            // assumed to be re-posted first. That can only delay the update.
+            const auto data_returns = pending_returns_ - std::min(pending_returns_, update_returns_);
+
+            if (data_returns >= update_threshold_ || peer_credits_ <= 1) {
+                post({credit_update_wr_id, nullptr, 0, 0}, credit_only_flag);
+                ++counters_.credit_updates;
+            }
+        }
+
+        queue_pair* qp_;
+        std::uint32_t credits_;         // Receives the peer has posted for this side.
+        std::uint32_t peer_credits_;    // Receives this side has posted for the peer, as far as the peer knows.
+        std::uint32_t pending_returns_; // Receives re-posted but not yet returned to the peer.
+        std::uint32_t update_returns_;  // Receives of credit-only messages not yet returned to the peer.
+        std::uint32_t update_threshold_;
+        std::deque<buffer_descriptor> queued_;
+        flow_control_counters counters_;
+    }; // class credit_flow_control
+
+    // Reads the device's count of RNR NAKs from its port's hardware counters in
+    // sysfs. Not every driver exposes one: rxe counts the RNR NAKs it received
+    // (rcvd_rnr_err) and sent (send_rnr_err), mlx5 counts the messages that found
+    // no receive posted (out_of_buffer). Returns the first counter found, or
+    // std::nullopt if there is none.
+    inline auto read_rnr_nak_counter(const context& _ctx, std::uint8_t _port_number) -> std::optional<std::uint64_t>
+    {
+        const auto dir = std::string{"/sys/class/infiniband/"} + ibv_get_device_name(_ctx.handle().device) +
+                         "/ports/" + std::to_string(_port_number) + "/hw_counters/";
+
+        for (const auto* name : {"rcvd_rnr_err", "send_rnr_err", "out_of_buffer"}) {
+            std::ifstream in{dir + name};
+            std::uint64_t value;
+
+            if (in >> value)
+                return value;
+        }
+
+        return std::nullopt;
+    }
+} // namespace rdma
+
+#endif // KDD_RDMA_FLOW_CONTROL_HPP
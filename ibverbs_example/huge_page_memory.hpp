@@ -0,0 +1,167 @@
+#ifndef KDD_RDMA_HUGE_PAGE_MEMORY_HPP
+#define KDD_RDMA_HUGE_PAGE_MEMORY_HPP
+
+#include "numa_memory.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <errno.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+namespace rdma
+{
+    enum class page_size
+    {
+        normal,   // Base pages (usually 4 KiB).
+        huge_2mb,
+        huge_1gb
+    };
+
+    // Describes the pages that actually back a huge_page_memory allocation.
+    enum class page_backing
+    {
+        normal,      // Base pages. Transparent huge pages could not be requested.
+        transparent, // Base pages with MADV_HUGEPAGE. The kernel may promote them to 2 MiB pages.
+        hugetlb_2mb,
+        hugetlb_1gb
+    };
+
+    inline
+    constexpr auto to_string(page_backing _backing) noexcept -> const char*
+    {
+        switch (_backing) {
+            case page_backing::normal:      return "normal";
+            case page_backing::transparent: return "transparent";
+            case page_backing::hugetlb_2mb: return "hugetlb_2mb";
+            case page_backing::hugetlb_1gb: return "hugetlb_1gb";
+            default:                        return "?";
+        }
+    }
+
+    // Anonymous memory intended to be registered as a single memory region, e.g.
+    //
+    //   rdma::huge_page_memory mem{size, rdma::page_size::huge_2mb};
+    //   rdma::memory_region mr{pd, mem.data(), mem.size(), access_flags};
+    //
+    // Large registrations backed by base pages need one NIC address translation
+    // entry per 4 KiB. Once they no longer fit in the NIC's translation cache,
+    // random accesses miss and bandwidth drops. Huge pages reduce the number of
+    // entries by a factor of 512 (2 MiB) or 262144 (1 GiB).
+    //
+    // Huge pages are taken from the hugetlbfs pool (MAP_HUGETLB). If the pool is
+    // empty or the page size is not supported, the memory falls back to base pages
+    // advised for transparent huge pages. backing() reports what was obtained.
+    // The size is rounded up to a multiple of the requested page size.
+    //
+    // If _numa_node is not negative, the pages are allocated on that NUMA node,
+    // e.g. the node of the device the memory will be registered with (see
+    // select_port()). Otherwise the kernel places them on first touch.
+    class huge_page_memory
+    {
+    public:
+        huge_page_memory(std::size_t _size, page_size _page_size, int _numa_node = -1)
+            : data_{MAP_FAILED}
+            , size_{}
+            , backing_{page_backing::normal}
+        {
+            if (_size == 0)
+                throw std::invalid_argument{"huge page memory size must be greater than 0."};
+
+            if (page_size::huge_1gb == _page_size) {
+                if (map_hugetlb(_size, 30))
+                    backing_ = page_backing::hugetlb_1gb;
+            }
+            else if (page_size::huge_2mb == _page_size) {
+                if (map_hugetlb(_size, 21))
+                    backing_ = page_backing::hugetlb_2mb;
+            }
+
+            if (MAP_FAILED == data_)
+                map_base_pages(_size, page_size::normal != _page_size);
+
+            if (_numa_node >= 0) {
+                try {
+                    detail::bind_to_numa_node(data_, size_, _numa_node);
+                }
+                catch (...) {
+                    munmap(data_, size_);
+                    throw;
+                }
+            }
+        }
+
+        huge_page_memory(const huge_page_memory&) = delete;
+        auto operator=(const huge_page_memory&) -> huge_page_memory& = delete;
+
+        ~huge_page_memory()
+        {
+            if (MAP_FAILED != data_)
+                munmap(data_, size_);
+        }
+
+        auto data() const noexcept -> std::uint8_t*
+        {
+            return static_cast<std::uint8_t*>(data_);
+        }
+
+        auto size() const noexcept -> std::size_t
+        {
+            return size_;
+        }
+
+        auto backing() const noexcept -> page_backing
+        {
+            return backing_;
+        }
+
+    private:
+        static constexpr auto round_up(std::size_t _size, std::size_t _alignment) noexcept -> std::size_t
+        {
+            return (_size + _alignment - 1) & ~(_alignment - 1);
+        }
+
+        // _page_shift is log2 of the huge page size, e.g. 21 for 2 MiB pages.
+        auto map_hugetlb(std::size_t _size, int _page_shift) -> bool
+        {
+            const auto size = round_up(_size, std::size_t{1} << _page_shift);
+            const auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (_page_shift << MAP_HUGE_SHIFT);
+            data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+            if (MAP_FAILED == data_)
+                return false;
+
+            size_ = size;
+            return true;
+        }
+
+        auto map_base_pages(std::size_t _size, bool _transparent_huge_pages) -> void
+        {
+            // Round to 2 MiB when falling back from huge pages so that the kernel is
+            // able to back the whole range with transparent huge pages.
+            const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            const auto size = round_up(_size, _transparent_huge_pages ? std::size_t{1} << 21 : page);
+            data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (MAP_FAILED == data_) {
+                perror("mmap");
+                throw std::runtime_error{"mmap error"};
+            }
+
+            size_ = size;
+
+            if (_transparent_huge_pages && 0 == madvise(data_, size_, MADV_HUGEPAGE))
+                backing_ = page_backing::transparent;
+        }
+
+        void* data_;
+        std::size_t size_;
+        page_backing backing_;
+    }; // class huge_page_memory
+} // namespace rdma
+
+#endif // KDD_RDMA_HUGE_PAGE_MEMORY_HPP
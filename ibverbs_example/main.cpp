@@ -13,6 +13,7 @@
 #include <vector>
 #include <utility>
 #include <iterator>
+#include <memory>
 #include <algorithm>
 
 namespace po = boost::program_options;
@@ -25,7 +26,7 @@ auto main(int _argc, char* _argv[]) -> int
             ("server,s", po::bool_switch(), "Launches server.")
             ("host,h", po::value<std::string>(), "The host to connect to. Ignored if -s is used.")
             ("port,p", po::value<std::string>()->default_value("9900"), "The port to connect to.")
-            ("gid-index,g", po::value<int>()->default_value(0), "The index of the GID to use.")
+            ("gid-index,g", po::value<int>()->default_value(-1), "The index of the GID to use. -1 selects one from the GID table.")
             ("skip-rdma,x", po::bool_switch(), "Skips RDMA message passing steps.")
             ("help", po::bool_switch(), "Show this message.");
 
@@ -48,11 +49,20 @@ auto main(int _argc, char* _argv[]) -> int
         }
         std::cout << '\n';
 
-        rdma::context context{devices[0]};
+        // Use the device attached to the NUMA node this thread runs on, its first
+        // active port and the best GID of that port (RoCE v2 if available).
+        const auto selection = rdma::select_port(rdma::current_numa_node());
+        std::cout << "Selected device: " << selection.device_name
+                  << ", NUMA node: " << selection.numa_node
+                  << ", port: " << static_cast<int>(selection.port_number)
+                  << ", GID index: " << selection.gid_index << '\n';
+        std::cout << '\n';
+
+        rdma::context context{devices[selection.device_name.c_str()]};
         rdma::print_device_info(context);
         std::cout << '\n';
 
-        constexpr auto port_number = 1; // Normally one (1).
+        const auto port_number = selection.port_number;
         rdma::print_port_info(context, port_number);
         std::cout << '\n';
 
@@ -81,7 +91,7 @@ auto main(int _argc, char* _argv[]) -> int
         // Exchange QP information.
         const auto sq_psn = rdma::generate_random_int();
         const auto port_info = context.port_info(port_number);
-        const auto gid_index = vm["gid-index"].as<int>();
+        const auto gid_index = vm["gid-index"].as<int>() >= 0 ? vm["gid-index"].as<int>() : selection.gid_index;
 
         rdma::queue_pair_info qp_info{};
         qp_info.qp_num = qp.queue_pair_number();
@@ -89,6 +99,11 @@ auto main(int _argc, char* _argv[]) -> int
         qp_info.lid = port_info.lid;
         qp_info.gid = context.gid(port_number, gid_index);
 
+        const auto local_atomic_limits = rdma::query_atomic_limits(context);
+        qp_info.max_rd_atomic = local_atomic_limits.max_rd_atomic;
+        qp_info.max_dest_rd_atomic = local_atomic_limits.max_dest_rd_atomic;
+        qp_info.mtu = port_info.active_mtu;
+
         constexpr auto local_info = true;
         rdma::print_queue_pair_info(qp_info, local_info);
         std::cout << '\n';
@@ -97,10 +112,29 @@ auto main(int _argc, char* _argv[]) -> int
         const auto host = run_server ? "" : vm["host"].as<std::string>();
         const auto port = vm["port"].as<std::string>();
 
+        // A single control connection carries every out-of-band message needed to
+        // connect the QPs.
+        std::unique_ptr<rdma::control_listener> listener;
+        std::unique_ptr<rdma::control_channel> channel;
+
+        if (run_server) {
+            std::cout << "Waiting for client to connect ... ";
+            listener = std::make_unique<rdma::control_listener>(port);
+            channel = std::make_unique<rdma::control_channel>(*listener);
+        }
+        else {
+            std::cout << "Connecting to server ... ";
+            channel = std::make_unique<rdma::control_channel>(host, port);
+        }
+
+        std::cout << "connected!\n";
+
         // Exchange the required QP information between the client and server.
         // This is required so that the QPs can be transistioned through the proper
         // states and connected for data communication.
-        rdma::exchange_queue_pair_info(host, port, qp_info, run_server);
+        std::cout << "Exchanging QP information ... ";
+        channel->exchange(qp_info);
+        std::cout << "done!\n";
         std::cout << '\n';
 
         // Transition the QP's state from IBV_QPS_INIT to IBV_QPS_RTS.
@@ -111,32 +145,48 @@ auto main(int _argc, char* _argv[]) -> int
         std::cout << '\n';
 
         constexpr auto access_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+        std::cout << "Changing QP state to INIT ...\n";
         rdma::change_queue_pair_state_to_init(qp, port_number, pkey_index, access_flags);
+        std::cout << "QP state changed successfully!\n";
 
         // Memory Regions can be registered at any time. However, doing this in the
         // data path could negatively affect performance.
-        std::vector<std::uint8_t> buffer(128);
-        rdma::memory_region mr{pd, buffer, access_flags};
+        // The buffer lives on the device's NUMA node so the NIC does not reach
+        // across the socket interconnect for it.
+        constexpr std::uint32_t message_size = 128;
+        rdma::numa_memory buffer{message_size, selection.numa_node};
+        rdma::memory_region mr{pd, buffer.data(), buffer.size(), access_flags};
+        const auto message = rdma::make_buffer_descriptor(mr, 0, message_size);
 
         // The client is responsible for driving the conversation with the server.
         // If we are running as a server, then post a receive request. RDMA requires that the responder
         // posts a receive work request before the sender actually posts the send request.
         if (run_server) {
             std::cout << "Posting receive request ... ";
-            qp.post_receive(buffer, mr);
+            qp.post_receive(&message, 1);
             std::cout << "done!\n";
         }
 
         const auto grh_required = (port_info.flags & IBV_QPF_GRH_REQUIRED) == IBV_QPF_GRH_REQUIRED;
-        rdma::change_queue_pair_state_to_rtr(qp, qp_info, port_number, gid_index, grh_required);
-
-        rdma::change_queue_pair_state_to_rts(qp, sq_psn);
+        std::cout << "Changing QP state to RTR ...\n";
+        const auto atomic_limits = rdma::negotiate_atomic_limits(local_atomic_limits, qp_info);
+        const auto path_mtu = rdma::negotiate_path_mtu(port_info.active_mtu, qp_info);
+        std::cout << "Path MTU: " << rdma::to_string(path_mtu) << '\n';
+        rdma::change_queue_pair_state_to_rtr(qp, qp_info, port_number, gid_index, grh_required,
+                                             atomic_limits.max_dest_rd_atomic, path_mtu);
+        std::cout << "QP state changed successfully!\n";
+
+        std::cout << "Changing QP state to RTS ...\n";
+        rdma::change_queue_pair_state_to_rts(qp, sq_psn, atomic_limits.max_rd_atomic);
+        std::cout << "QP state changed successfully!\n";
         std::cout << '\n';
 
-        // Echo a message between the sender and responder. This call acts as a point of
+        // Exchange a token between the sender and responder. This call acts as a point of
         // synchronization between the sender and responder and guarantees that each side's
         // QP is up and ready for processing.
-        rdma::sync_client_and_server(host, port, run_server, rdma::generate_random_int());
+        std::cout << "Syncing client and server ... ";
+        channel->sync();
+        std::cout << "done!\n";
 
         std::cout << '\n';
         const auto [qp_attrs, q_attrs] = qp.query_attribute(IBV_QP_RQ_PSN | IBV_QP_AV);
@@ -153,7 +203,7 @@ auto main(int _argc, char* _argv[]) -> int
 
                 if (wc.status == IBV_WC_SUCCESS) {
                     std::cout << "Message received: ";
-                    std::cout.write((char*) buffer.data(), buffer.size());
+                    std::cout.write((char*) buffer.data(), message_size);
                     std::cout << '\n';
                 }
                 else {
@@ -165,7 +215,7 @@ auto main(int _argc, char* _argv[]) -> int
                 std::copy(msg, msg + strlen(msg), buffer.data() + (grh_required ? 40 : 0));
 
                 std::cout << "Posting send request ... ";
-                qp.post_send(buffer, mr);
+                qp.post_send(&message, 1);
                 std::cout << "done!\n";
 
                 std::cout << "Waiting for completion ... ";
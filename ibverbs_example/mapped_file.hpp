@@ -0,0 +1,89 @@
+#ifndef KDD_RDMA_MAPPED_FILE_HPP
+#define KDD_RDMA_MAPPED_FILE_HPP
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <errno.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+
+namespace rdma
+{
+    // A read-only memory mapping of an entire file. The mapping can be registered
+    // directly as a read-only memory region so that file contents are sent without
+    // being copied into a buffer first, e.g.
+    //
+    //   rdma::mapped_file file{"/path/to/export"};
+    //   rdma::memory_region mr{pd, file, IBV_ACCESS_REMOTE_READ};
+    class mapped_file
+    {
+    public:
+        explicit mapped_file(const std::string& _path)
+            : data_{MAP_FAILED}
+            , size_{}
+        {
+            const auto fd = open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (fd == -1) {
+                perror("open");
+                throw std::runtime_error{"mapped_file open error"};
+            }
+
+            struct stat st{};
+
+            if (fstat(fd, &st) == -1) {
+                perror("fstat");
+                close(fd);
+                throw std::runtime_error{"mapped_file fstat error"};
+            }
+
+            if (st.st_size == 0) {
+                close(fd);
+                throw std::invalid_argument{"cannot map an empty file"};
+            }
+
+            size_ = static_cast<std::size_t>(st.st_size);
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+
+            // The mapping holds its own reference to the file.
+            close(fd);
+
+            if (MAP_FAILED == data_) {
+                perror("mmap");
+                throw std::runtime_error{"mapped_file mmap error"};
+            }
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        auto operator=(const mapped_file&) -> mapped_file& = delete;
+
+        ~mapped_file()
+        {
+            if (MAP_FAILED != data_)
+                munmap(data_, size_);
+        }
+
+        auto data() const noexcept -> const std::uint8_t*
+        {
+            return static_cast<const std::uint8_t*>(data_);
+        }
+
+        auto size() const noexcept -> std::size_t
+        {
+            return size_;
+        }
+
+    private:
+        void* data_;
+        std::size_t size_;
+    }; // class mapped_file
+} // namespace rdma
+
+#endif // KDD_RDMA_MAPPED_FILE_HPP
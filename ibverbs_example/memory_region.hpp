@@ -9,23 +9,74 @@
 #include <stdio.h>
 #include <errno.h>
 
-#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <utility>
 #include <stdexcept>
 
 namespace rdma
 {
+    // Everything a peer needs to target a memory region with one-sided operations
+    // (RDMA WRITE, RDMA READ and atomics). Exchange it alongside queue_pair_info.
+    struct remote_memory_region
+    {
+        std::uint64_t address;
+        std::uint64_t length;
+        std::uint32_t remote_key;
+    };
+
     class memory_region
     {
     public:
+        // Registers any contiguous range that supports std::data and std::size, e.g.
+        // std::vector, std::string, std::array, std::span, numa_memory, huge_page_memory
+        // or mapped_file. The memory is registered in place, so data can be sent without
+        // copying it into an intermediate buffer first. Const ranges are registered
+        // read-only (see below).
+        template <typename ContiguousRange,
+                  typename = decltype(std::data(std::declval<ContiguousRange&>())),
+                  typename = decltype(std::size(std::declval<ContiguousRange&>()))>
+        memory_region(const protection_domain& _pd,
+                      ContiguousRange& _buffer,
+                      int _access_flags)
+            : memory_region{_pd,
+                            std::data(_buffer),
+                            std::size(_buffer) * sizeof(*std::data(_buffer)),
+                            _access_flags}
+        {
+        }
+
+        memory_region(const protection_domain& _pd,
+                      void* _address,
+                      std::size_t _size,
+                      int _access_flags)
+            : mr_{ibv_reg_mr(&_pd.handle(), _address, _size, _access_flags)}
+        {
+            if (!mr_) {
+                perror("ibv_reg_mr");
+                throw std::runtime_error{"ibv_reg_mr error"};
+            }
+        }
+
+        // Registers read-only memory, e.g. a file mapped with PROT_READ. The region can be
+        // the source of sends and RDMA reads, but the device must never write to it, so the
+        // access flags must not contain IBV_ACCESS_LOCAL_WRITE, IBV_ACCESS_REMOTE_WRITE or
+        // IBV_ACCESS_REMOTE_ATOMIC. Registering with write access would make the kernel
+        // pin the pages for writing, which fails for read-only mappings.
         memory_region(const protection_domain& _pd,
-                      /*const*/ std::vector<std::uint8_t>& _buffer,
+                      const void* _address,
+                      std::size_t _size,
                       int _access_flags)
-            : mr_{ibv_reg_mr(&_pd.handle(),
-                             //const_cast<std::uint8_t*>(_buffer.data()),
-                             _buffer.data(),
-                             _buffer.size(),
-                             _access_flags)}
+            : mr_{}
         {
+            constexpr auto write_access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_ATOMIC;
+
+            if (_access_flags & write_access)
+                throw std::invalid_argument{"read-only memory cannot be registered with write access"};
+
+            mr_ = ibv_reg_mr(&_pd.handle(), const_cast<void*>(_address), _size, _access_flags);
+
             if (!mr_) {
                 perror("ibv_reg_mr");
                 throw std::runtime_error{"ibv_reg_mr error"};
@@ -61,6 +112,11 @@ namespace rdma
             return mr_->length;
         }
 
+        auto remote_descriptor() const -> remote_memory_region
+        {
+            return {reinterpret_cast<std::uintptr_t>(mr_->addr), mr_->length, mr_->rkey};
+        }
+
     private:
         ibv_mr* mr_;
     }; // class memory_region
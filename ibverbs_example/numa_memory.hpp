@@ -0,0 +1,106 @@
+#ifndef KDD_RDMA_NUMA_MEMORY_HPP
+#define KDD_RDMA_NUMA_MEMORY_HPP
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/mempolicy.h>
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <stdexcept>
+
+namespace rdma
+{
+    namespace detail
+    {
+        // Binds the pages of the mapping to _numa_node. Must run before the pages are
+        // touched, since mbind does not move pages that are already allocated.
+        inline auto bind_to_numa_node(void* _data, std::size_t _size, int _numa_node) -> void
+        {
+            constexpr auto bits_per_word = sizeof(unsigned long) * CHAR_BIT;
+            constexpr auto max_nodes = std::size_t{1024};
+
+            if (_numa_node < 0 || static_cast<std::size_t>(_numa_node) >= max_nodes)
+                throw std::invalid_argument{"NUMA node out of range."};
+
+            unsigned long node_mask[max_nodes / bits_per_word]{};
+            node_mask[_numa_node / bits_per_word] = 1ul << (_numa_node % bits_per_word);
+
+            // The kernel expects the number of bits in the mask plus one.
+            if (syscall(SYS_mbind, _data, _size, MPOL_BIND, node_mask, max_nodes + 1, 0) != 0) {
+                perror("mbind");
+                throw std::runtime_error{"mbind error"};
+            }
+        }
+    } // namespace detail
+
+    // Anonymous memory backed by base pages on a given NUMA node, for buffers that
+    // are registered with a device and should live on the device's node (see
+    // select_port()), so the NIC does not reach across the socket interconnect:
+    //
+    //   rdma::numa_memory mem{size, selection.numa_node};
+    //   rdma::memory_region mr{pd, mem.data(), mem.size(), access_flags};
+    //
+    // The size is rounded up to a multiple of the page size. If _numa_node is
+    // negative (e.g. the device does not report a node), the kernel places the pages
+    // on first touch. Use huge_page_memory for large registrations.
+    class numa_memory
+    {
+    public:
+        numa_memory(std::size_t _size, int _numa_node)
+            : data_{MAP_FAILED}
+            , size_{}
+        {
+            if (_size == 0)
+                throw std::invalid_argument{"NUMA memory size must be greater than 0."};
+
+            const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            size_ = (_size + page - 1) & ~(page - 1);
+            data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (MAP_FAILED == data_) {
+                perror("mmap");
+                throw std::runtime_error{"mmap error"};
+            }
+
+            if (_numa_node >= 0) {
+                try {
+                    detail::bind_to_numa_node(data_, size_, _numa_node);
+                }
+                catch (...) {
+                    munmap(data_, size_);
+                    throw;
+                }
+            }
+        }
+
+        numa_memory(const numa_memory&) = delete;
+        auto operator=(const numa_memory&) -> numa_memory& = delete;
+
+        ~numa_memory()
+        {
+            munmap(data_, size_);
+        }
+
+        auto data() const noexcept -> std::uint8_t*
+        {
+            return static_cast<std::uint8_t*>(data_);
+        }
+
+        auto size() const noexcept -> std::size_t
+        {
+            return size_;
+        }
+
+    private:
+        void* data_;
+        std::size_t size_;
+    }; // class numa_memory
+} // namespace rdma
+
+#endif // KDD_RDMA_NUMA_MEMORY_HPP
@@ -5,12 +5,19 @@
 #include "protection_domain.hpp"
 #include "completion_queue.hpp"
 #include "memory_region.hpp"
+#include "work_request.hpp"
+#include "shared_receive_queue.hpp"
 
 #include <infiniband/verbs.h>
 
+#include <arpa/inet.h>
+
 #include <stdio.h>
 #include <errno.h>
 
+#include <cstddef>
+#include <algorithm>
+#include <deque>
 #include <iostream>
 #include <tuple>
 #include <vector>
@@ -26,13 +33,47 @@ namespace rdma
                    const completion_queue& _cq)
             : qp_{ibv_create_qp(&_pd.handle(), &_attrs)}
             , cq_{&_cq.handle()}
+            , max_send_sge_{}
+            , max_recv_sge_{}
+            , max_inline_data_{}
+            , inline_threshold_{}
+            , send_queue_depth_{_attrs.cap.max_send_wr}
+            , sq_sig_all_{_attrs.sq_sig_all != 0}
+            , signal_interval_{}
+            , outstanding_sends_{}
+            , unsignaled_sends_{}
+            , signaled_batches_{}
+            , send_wrs_{}
+            , send_sges_{}
+            , recv_wrs_{}
+            , recv_sges_{}
         {
             if (!qp_) {
                 perror("ibv_create_qp");
                 throw std::runtime_error{"ibv_create_qp error"};
             }
+
+            // ibv_create_qp updates the capabilities with the values actually granted.
+            max_send_sge_ = _attrs.cap.max_send_sge;
+            max_recv_sge_ = _attrs.cap.max_recv_sge;
+            max_inline_data_ = _attrs.cap.max_inline_data;
+            inline_threshold_ = max_inline_data_;
+        }
+
+        // Creates a queue pair that takes its receive buffers from _srq instead of its
+        // own receive queue. Receives must be posted to the SRQ. The receive queue
+        // capacities in _attrs are ignored.
+        queue_pair(const protection_domain& _pd,
+                   ibv_qp_init_attr& _attrs,
+                   const completion_queue& _cq,
+                   const shared_receive_queue& _srq)
+            : queue_pair{_pd, attach_shared_receive_queue(_attrs, _srq), _cq}
+        {
         }
 
+        queue_pair(const queue_pair&) = delete;
+        auto operator=(const queue_pair&) -> queue_pair& = delete;
+
         ~queue_pair()
         {
             if (qp_)
@@ -74,23 +115,12 @@ namespace rdma
             // by removing the need for users to create memory regions outside
             // of the queue pair. This also applies to post_receive().
 
-            ibv_sge sg_list{};
-            sg_list.addr = reinterpret_cast<std::uintptr_t>(_buffer.data());
-            sg_list.length = _buffer.size();
-            sg_list.lkey = _mr.local_key();
-
-            ibv_send_wr wr{};
-            wr.opcode = IBV_WR_SEND;
-            wr.send_flags = IBV_SEND_SIGNALED;
-            wr.sg_list = &sg_list;
-            wr.num_sge = 1;
-
-            ibv_send_wr* bad_wr{};
+            buffer_descriptor buffer{};
+            buffer.address = const_cast<std::uint8_t*>(_buffer.data());
+            buffer.length = _buffer.size();
+            buffer.local_key = _mr.local_key();
 
-            if (ibv_post_send(qp_, &wr, &bad_wr)) {
-                perror("ibv_post_send");
-                throw std::runtime_error{"ibv_post_send error"};
-            }
+            post_send(&buffer, 1);
         }
 
         auto post_receive(std::vector<std::uint8_t>& _buffer, const memory_region& _mr) -> void
@@ -117,10 +147,366 @@ namespace rdma
             }
         }
 
+        // Chains the buffers into a single linked list of send work requests and
+        // posts the entire list with one call to ibv_post_send, i.e. one doorbell
+        // for the whole batch. On failure, a post_error is thrown identifying the
+        // first work request that was not posted.
+        //
+        // If selective signaling is enabled, lists longer than the signal interval
+        // are posted in chunks of at most signal interval work requests. A chunk that
+        // does not fit into the send queue is not posted. See set_signal_interval().
+        auto post_send(const buffer_descriptor* _buffers, std::size_t _count) -> void
+        {
+            if (_count == 0)
+                return;
+
+            if (send_wrs_.size() < _count) {
+                send_wrs_.resize(_count);
+                send_sges_.resize(_count);
+            }
+
+            for (std::size_t i = 0; i < _count; ++i) {
+                auto& sge = send_sges_[i];
+                sge.addr = reinterpret_cast<std::uintptr_t>(_buffers[i].address);
+                sge.length = _buffers[i].length;
+                sge.lkey = _buffers[i].local_key;
+
+                auto& wr = send_wrs_[i];
+                wr = {};
+                wr.wr_id = _buffers[i].wr_id;
+                wr.opcode = IBV_WR_SEND;
+                wr.sg_list = &sge;
+                wr.num_sge = 1;
+            }
+
+            post_send_list(_count);
+        }
+
+        auto post_send(const std::vector<buffer_descriptor>& _buffers) -> void
+        {
+            post_send(_buffers.data(), _buffers.size());
+        }
+
+        // Sends the buffer along with _imm_data, which the receiver finds in its receive
+        // completion. The immediate data is given in host byte order. Receivers recover
+        // it with ntohl(wc.imm_data). A zero-length buffer sends the immediate data only.
+        auto post_send_with_imm(const buffer_descriptor& _buffer, std::uint32_t _imm_data) -> void
+        {
+            if (send_wrs_.empty()) {
+                send_wrs_.resize(1);
+                send_sges_.resize(1);
+            }
+
+            auto& sge = send_sges_[0];
+            sge.addr = reinterpret_cast<std::uintptr_t>(_buffer.address);
+            sge.length = _buffer.length;
+            sge.lkey = _buffer.local_key;
+
+            auto& wr = send_wrs_[0];
+            wr = {};
+            wr.wr_id = _buffer.wr_id;
+            wr.opcode = IBV_WR_SEND_WITH_IMM;
+            wr.sg_list = &sge;
+            wr.num_sge = _buffer.length > 0 ? 1 : 0;
+            wr.imm_data = htonl(_imm_data);
+
+            post_send_list(1);
+        }
+
+        // Chains the buffers into a single linked list of receive work requests and
+        // posts the entire list with one call to ibv_post_recv. On failure, a post_error
+        // is thrown identifying the first work request that was not posted.
+        auto post_receive(const buffer_descriptor* _buffers, std::size_t _count) -> void
+        {
+            if (_count == 0)
+                return;
+
+            if (recv_wrs_.size() < _count) {
+                recv_wrs_.resize(_count);
+                recv_sges_.resize(_count);
+            }
+
+            for (std::size_t i = 0; i < _count; ++i) {
+                auto& sge = recv_sges_[i];
+                sge.addr = reinterpret_cast<std::uintptr_t>(_buffers[i].address);
+                sge.length = _buffers[i].length;
+                sge.lkey = _buffers[i].local_key;
+
+                auto& wr = recv_wrs_[i];
+                wr = {};
+                wr.wr_id = _buffers[i].wr_id;
+                wr.sg_list = &sge;
+                wr.num_sge = 1;
+                wr.next = (i + 1 < _count) ? &recv_wrs_[i + 1] : nullptr;
+            }
+
+            ibv_recv_wr* bad_wr{};
+
+            if (ibv_post_recv(qp_, recv_wrs_.data(), &bad_wr)) {
+                perror("ibv_post_recv");
+                throw post_error{"ibv_post_recv error", bad_wr ? static_cast<std::size_t>(bad_wr - recv_wrs_.data()) : 0};
+            }
+        }
+
+        auto post_receive(const std::vector<buffer_descriptor>& _buffers) -> void
+        {
+            post_receive(_buffers.data(), _buffers.size());
+        }
+
+        // Sends a single message gathered from the segments in order, e.g. a header and
+        // a payload living in different buffers, without copying them together first.
+        // The number of segments must not exceed the QP's max_send_sge capability.
+        auto post_send(const buffer_segment* _segments, std::size_t _count, std::uint64_t _wr_id = 0) -> void
+        {
+            if (_count == 0)
+                throw std::invalid_argument{"a send needs at least one segment"};
+
+            if (_count > max_send_sge_)
+                throw std::invalid_argument{"segment count exceeds the QP's max_send_sge"};
+
+            if (send_wrs_.empty())
+                send_wrs_.resize(1);
+
+            if (send_sges_.size() < _count)
+                send_sges_.resize(_count);
+
+            fill_sges(send_sges_.data(), _segments, _count);
+
+            auto& wr = send_wrs_[0];
+            wr = {};
+            wr.wr_id = _wr_id;
+            wr.opcode = IBV_WR_SEND;
+            wr.sg_list = send_sges_.data();
+            wr.num_sge = static_cast<int>(_count);
+
+            post_send_list(1);
+        }
+
+        auto post_send(const std::vector<buffer_segment>& _segments, std::uint64_t _wr_id = 0) -> void
+        {
+            post_send(_segments.data(), _segments.size(), _wr_id);
+        }
+
+        // Posts a single receive work request whose incoming message is scattered over the
+        // segments in order. The number of segments must not exceed the QP's max_recv_sge
+        // capability.
+        auto post_receive(const buffer_segment* _segments, std::size_t _count, std::uint64_t _wr_id = 0) -> void
+        {
+            if (_count == 0)
+                throw std::invalid_argument{"a receive needs at least one segment"};
+
+            if (_count > max_recv_sge_)
+                throw std::invalid_argument{"segment count exceeds the QP's max_recv_sge"};
+
+            if (recv_wrs_.empty())
+                recv_wrs_.resize(1);
+
+            if (recv_sges_.size() < _count)
+                recv_sges_.resize(_count);
+
+            fill_sges(recv_sges_.data(), _segments, _count);
+
+            auto& wr = recv_wrs_[0];
+            wr = {};
+            wr.wr_id = _wr_id;
+            wr.sg_list = recv_sges_.data();
+            wr.num_sge = static_cast<int>(_count);
+
+            ibv_recv_wr* bad_wr{};
+
+            if (ibv_post_recv(qp_, &wr, &bad_wr)) {
+                perror("ibv_post_recv");
+                throw post_error{"ibv_post_recv error", 0};
+            }
+        }
+
+        auto post_receive(const std::vector<buffer_segment>& _segments, std::uint64_t _wr_id = 0) -> void
+        {
+            post_receive(_segments.data(), _segments.size(), _wr_id);
+        }
+
+        auto max_send_sge() const noexcept -> std::uint32_t
+        {
+            return max_send_sge_;
+        }
+
+        auto max_recv_sge() const noexcept -> std::uint32_t
+        {
+            return max_recv_sge_;
+        }
+
+        // Writes the local buffer to _remote at _remote_offset without involving the
+        // remote CPU. The remote memory region must have been registered with
+        // IBV_ACCESS_REMOTE_WRITE.
+        auto post_write(const buffer_descriptor& _local,
+                        const remote_memory_region& _remote,
+                        std::uint64_t _remote_offset) -> void
+        {
+            prepare_one_sided(_local, _remote, _remote_offset, IBV_WR_RDMA_WRITE);
+            post_send_list(1);
+        }
+
+        // Like post_write(), but also consumes a receive work request at the remote QP
+        // and generates a receive completion carrying _imm_data. The immediate data is
+        // given in host byte order. Receivers recover it with ntohl(wc.imm_data).
+        auto post_write_with_imm(const buffer_descriptor& _local,
+                                 const remote_memory_region& _remote,
+                                 std::uint64_t _remote_offset,
+                                 std::uint32_t _imm_data) -> void
+        {
+            auto& wr = prepare_one_sided(_local, _remote, _remote_offset, IBV_WR_RDMA_WRITE_WITH_IMM);
+            wr.imm_data = htonl(_imm_data);
+            post_send_list(1);
+        }
+
+        // Reads from _remote at _remote_offset into the local buffer without involving the
+        // remote CPU. The remote memory region must have been registered with
+        // IBV_ACCESS_REMOTE_READ and the local one with IBV_ACCESS_LOCAL_WRITE.
+        auto post_read(const buffer_descriptor& _local,
+                       const remote_memory_region& _remote,
+                       std::uint64_t _remote_offset) -> void
+        {
+            prepare_one_sided(_local, _remote, _remote_offset, IBV_WR_RDMA_READ);
+            post_send_list(1);
+        }
+
+        // Atomically adds _value to the 64-bit integer at _remote_offset and writes the
+        // original value to the local buffer, which must be exactly 8 bytes. The remote
+        // address must be 8-byte aligned and the remote memory region must have been
+        // registered with IBV_ACCESS_REMOTE_ATOMIC. Atomics are only atomic with respect
+        // to other atomics issued through the same device.
+        auto post_fetch_add(const buffer_descriptor& _local,
+                            const remote_memory_region& _remote,
+                            std::uint64_t _remote_offset,
+                            std::uint64_t _value) -> void
+        {
+            auto& wr = prepare_atomic(_local, _remote, _remote_offset, IBV_WR_ATOMIC_FETCH_AND_ADD);
+            wr.wr.atomic.compare_add = _value;
+            post_send_list(1);
+        }
+
+        // Atomically replaces the 64-bit integer at _remote_offset with _swap if it equals
+        // _compare. The original value is written to the local buffer either way, so the
+        // operation succeeded if that value equals _compare. Has the same requirements
+        // as post_fetch_add().
+        auto post_compare_swap(const buffer_descriptor& _local,
+                               const remote_memory_region& _remote,
+                               std::uint64_t _remote_offset,
+                               std::uint64_t _compare,
+                               std::uint64_t _swap) -> void
+        {
+            auto& wr = prepare_atomic(_local, _remote, _remote_offset, IBV_WR_ATOMIC_CMP_AND_SWP);
+            wr.wr.atomic.compare_add = _compare;
+            wr.wr.atomic.swap = _swap;
+            post_send_list(1);
+        }
+
+        // Sends and RDMA writes whose payload is at most _threshold bytes are posted with
+        // IBV_SEND_INLINE. The CPU copies the payload into the work request, which saves
+        // the NIC a DMA read of the buffer and skips the local key check. The buffers of
+        // an inlined work request may be reused as soon as the post call returns.
+        //
+        // Defaults to the max_inline_data granted at QP creation (request it through
+        // ibv_qp_init_attr::cap). A threshold of zero disables inlining.
+        auto set_inline_threshold(std::uint32_t _threshold) -> void
+        {
+            if (_threshold > max_inline_data_)
+                throw std::invalid_argument{"inline threshold exceeds the QP's max_inline_data"};
+
+            inline_threshold_ = _threshold;
+        }
+
+        auto inline_threshold() const noexcept -> std::uint32_t
+        {
+            return inline_threshold_;
+        }
+
+        auto max_inline_data() const noexcept -> std::uint32_t
+        {
+            return max_inline_data_;
+        }
+
+        // Enables selective signaling. Only every _interval'th send work request
+        // is posted with IBV_SEND_SIGNALED. When its completion arrives, the send
+        // queue slots of all unsignaled work requests preceding it are reclaimed
+        // as well (RC send queues complete in order). A value of zero disables
+        // selective signaling and every send work request is signaled.
+        //
+        // Requires the QP to have been created with sq_sig_all set to zero. The
+        // interval must not exceed half of the send queue depth (rounded up). This
+        // guarantees there is always a signaled work request to wait on when the
+        // send queue is full. This should be called before any sends are posted.
+        //
+        // While enabled, the QP does not poll its completion queue itself. Whoever
+        // consumes the queue (wait_for_completion(), a poll_and_dispatch() handler, an
+        // engine worker's handler, ...) must pass every completion of this QP to
+        // on_send_completion(), which reclaims the slots. Posts that do not fit into
+        // the send queue throw a post_error (see send_queue_space()).
+        auto set_signal_interval(std::uint32_t _interval) -> void
+        {
+            if (_interval > 0 && sq_sig_all_)
+                throw std::logic_error{"selective signaling requires sq_sig_all to be zero"};
+
+            if (_interval > (send_queue_depth_ + 1) / 2)
+                throw std::invalid_argument{"signal interval exceeds half of the send queue depth"};
+
+            signal_interval_ = _interval;
+        }
+
+        auto signal_interval() const noexcept -> std::uint32_t
+        {
+            return signal_interval_;
+        }
+
+        // The number of send work requests (signaled or not) whose send queue slots
+        // have not been reclaimed yet. Only tracked when selective signaling is enabled.
+        auto outstanding_sends() const noexcept -> std::uint32_t
+        {
+            return outstanding_sends_;
+        }
+
+        // The number of send work requests that can be posted without overflowing the
+        // send queue. Only tracked when selective signaling is enabled.
+        auto send_queue_space() const noexcept -> std::uint32_t
+        {
+            return 0 == signal_interval_ ? send_queue_depth_ : send_queue_depth_ - outstanding_sends_;
+        }
+
+        // Reclaims the send queue slots covered by a signaled send completion of this QP.
+        // Completions of other QPs, receive completions and completions while selective
+        // signaling is disabled are ignored, so every completion polled from the QP's
+        // completion queue may be passed in. An error completion reclaims all slots,
+        // because the QP's outstanding work requests are flushed. Returns the number of
+        // send queue slots reclaimed.
+        auto on_send_completion(const ibv_wc& _wc) noexcept -> std::uint32_t
+        {
+            if (0 == signal_interval_ || _wc.qp_num != qp_->qp_num)
+                return 0;
+
+            if (_wc.status != IBV_WC_SUCCESS) {
+                const auto reclaimed = outstanding_sends_;
+                outstanding_sends_ = 0;
+                unsignaled_sends_ = 0;
+                signaled_batches_.clear();
+                return reclaimed;
+            }
+
+            if ((_wc.opcode & IBV_WC_RECV) || signaled_batches_.empty())
+                return 0;
+
+            const auto reclaimed = signaled_batches_.front();
+            outstanding_sends_ -= reclaimed;
+            signaled_batches_.pop_front();
+
+            return reclaimed;
+        }
+
+        // Busy-polls the completion queue until a completion is available and returns
+        // it. Send completions of this QP also reclaim their send queue slots.
         auto wait_for_completion() -> ibv_wc
         {
-            int n_comp = 0;
             ibv_wc wc{};
+            int n_comp = 0;
 
             do {
                 n_comp = ibv_poll_cq(cq_, 1, &wc);
@@ -132,12 +518,201 @@ namespace rdma
             }
             while (n_comp == 0);
 
+            on_send_completion(wc);
+
             return wc;
         }
 
     private:
+        static auto attach_shared_receive_queue(ibv_qp_init_attr& _attrs,
+                                                const shared_receive_queue& _srq) noexcept -> ibv_qp_init_attr&
+        {
+            _attrs.srq = &_srq.handle();
+            _attrs.cap.max_recv_wr = 0;
+            _attrs.cap.max_recv_sge = 0;
+            return _attrs;
+        }
+
+        static auto fill_sges(ibv_sge* _sges, const buffer_segment* _segments, std::size_t _count) noexcept -> void
+        {
+            for (std::size_t i = 0; i < _count; ++i) {
+                _sges[i].addr = reinterpret_cast<std::uintptr_t>(_segments[i].address);
+                _sges[i].length = _segments[i].length;
+                _sges[i].lkey = _segments[i].local_key;
+            }
+        }
+
+        // Fills in the first entry of send_wrs_ for a one-sided operation.
+        auto prepare_one_sided(const buffer_descriptor& _local,
+                               const remote_memory_region& _remote,
+                               std::uint64_t _remote_offset,
+                               ibv_wr_opcode _opcode) -> ibv_send_wr&
+        {
+            if (_remote_offset + _local.length > _remote.length)
+                throw std::out_of_range{"one-sided operation exceeds remote memory region"};
+
+            if (send_wrs_.empty()) {
+                send_wrs_.resize(1);
+                send_sges_.resize(1);
+            }
+
+            auto& sge = send_sges_[0];
+            sge.addr = reinterpret_cast<std::uintptr_t>(_local.address);
+            sge.length = _local.length;
+            sge.lkey = _local.local_key;
+
+            auto& wr = send_wrs_[0];
+            wr = {};
+            wr.wr_id = _local.wr_id;
+            wr.opcode = _opcode;
+            wr.sg_list = &sge;
+            wr.num_sge = 1;
+            wr.wr.rdma.remote_addr = _remote.address + _remote_offset;
+            wr.wr.rdma.rkey = _remote.remote_key;
+
+            return wr;
+        }
+
+        auto prepare_atomic(const buffer_descriptor& _local,
+                            const remote_memory_region& _remote,
+                            std::uint64_t _remote_offset,
+                            ibv_wr_opcode _opcode) -> ibv_send_wr&
+        {
+            if (_local.length != sizeof(std::uint64_t))
+                throw std::invalid_argument{"atomic operations require an 8 byte local buffer"};
+
+            if ((_remote.address + _remote_offset) % sizeof(std::uint64_t) != 0)
+                throw std::invalid_argument{"atomic operations require an 8 byte aligned remote address"};
+
+            auto& wr = prepare_one_sided(_local, _remote, _remote_offset, _opcode);
+
+            // wr.rdma and wr.atomic share storage but are laid out differently.
+            wr.wr.atomic = {};
+            wr.wr.atomic.remote_addr = _remote.address + _remote_offset;
+            wr.wr.atomic.rkey = _remote.remote_key;
+
+            return wr;
+        }
+
+        // Marks the work requests carrying at most inline_threshold_ bytes as inline.
+        auto apply_inline_policy(std::size_t _count) noexcept -> void
+        {
+            if (0 == inline_threshold_)
+                return;
+
+            for (std::size_t i = 0; i < _count; ++i) {
+                auto& wr = send_wrs_[i];
+
+                switch (wr.opcode) {
+                    case IBV_WR_SEND:
+                    case IBV_WR_SEND_WITH_IMM:
+                    case IBV_WR_RDMA_WRITE:
+                    case IBV_WR_RDMA_WRITE_WITH_IMM:
+                        break;
+
+                    default:
+                        continue;
+                }
+
+                std::uint64_t length = 0;
+
+                for (int j = 0; j < wr.num_sge; ++j)
+                    length += wr.sg_list[j].length;
+
+                if (length <= inline_threshold_)
+                    wr.send_flags |= IBV_SEND_INLINE;
+            }
+        }
+
+        // Posts the first _count entries of send_wrs_, applying the inline and
+        // signaling policies.
+        auto post_send_list(std::size_t _count) -> void
+        {
+            apply_inline_policy(_count);
+
+            if (0 == signal_interval_) {
+                for (std::size_t i = 0; i < _count; ++i) {
+                    send_wrs_[i].send_flags |= IBV_SEND_SIGNALED;
+                    send_wrs_[i].next = (i + 1 < _count) ? &send_wrs_[i + 1] : nullptr;
+                }
+
+                ibv_send_wr* bad_wr{};
+
+                if (ibv_post_send(qp_, send_wrs_.data(), &bad_wr)) {
+                    perror("ibv_post_send");
+                    throw post_error{"ibv_post_send error", bad_wr ? static_cast<std::size_t>(bad_wr - send_wrs_.data()) : 0};
+                }
+
+                return;
+            }
+
+            for (std::size_t first = 0; first < _count; first += signal_interval_) {
+                const auto n = std::min<std::size_t>(signal_interval_, _count - first);
+                auto* chunk = &send_wrs_[first];
+
+                // Never overflow the send queue. Slots are only reclaimed by
+                // on_send_completion(), which the caller drives.
+                if (outstanding_sends_ + n > send_queue_depth_)
+                    throw post_error{"send queue full", first};
+
+                auto run = unsignaled_sends_;
+
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (++run == signal_interval_) {
+                        chunk[i].send_flags |= IBV_SEND_SIGNALED;
+                        run = 0;
+                    }
+
+                    chunk[i].next = (i + 1 < n) ? &chunk[i + 1] : nullptr;
+                }
+
+                ibv_send_wr* bad_wr{};
+
+                if (ibv_post_send(qp_, chunk, &bad_wr)) {
+                    const auto posted = bad_wr ? static_cast<std::size_t>(bad_wr - chunk) : 0;
+                    track_posted_sends(chunk, posted);
+                    perror("ibv_post_send");
+                    throw post_error{"ibv_post_send error", first + posted};
+                }
+
+                track_posted_sends(chunk, n);
+            }
+        }
+
+        auto track_posted_sends(const ibv_send_wr* _wrs, std::size_t _count) -> void
+        {
+            for (std::size_t i = 0; i < _count; ++i) {
+                ++outstanding_sends_;
+                ++unsignaled_sends_;
+
+                if (_wrs[i].send_flags & IBV_SEND_SIGNALED) {
+                    signaled_batches_.push_back(unsignaled_sends_);
+                    unsignaled_sends_ = 0;
+                }
+            }
+        }
+
         ibv_qp* qp_;
         ibv_cq* cq_;
+        std::uint32_t max_send_sge_;
+        std::uint32_t max_recv_sge_;
+        std::uint32_t max_inline_data_;
+        std::uint32_t inline_threshold_;
+
+        // Selective signaling state.
+        std::uint32_t send_queue_depth_;
+        bool sq_sig_all_;
+        std::uint32_t signal_interval_;
+        std::uint32_t outstanding_sends_;
+        std::uint32_t unsignaled_sends_;
+        std::deque<std::uint32_t> signaled_batches_;
+
+        // Scratch storage reused across batched posts so that the data path
+        // does not allocate once the largest batch size has been seen.
+        std::vector<ibv_send_wr> send_wrs_;
+        std::vector<ibv_sge> send_sges_;
+        std::vector<ibv_recv_wr> recv_wrs_;
+        std::vector<ibv_sge> recv_sges_;
     }; // class queue_pair
 } // namespace rdma
 
@@ -0,0 +1,273 @@
+#ifndef KDD_RDMA_QUEUE_PAIR_MESH_HPP
+#define KDD_RDMA_QUEUE_PAIR_MESH_HPP
+
+#include "context.hpp"
+#include "protection_domain.hpp"
+#include "completion_queue.hpp"
+#include "queue_pair.hpp"
+#include "memory_region.hpp"
+#include "utility.hpp"
+#include "control_channel.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/post.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma
+{
+    namespace detail
+    {
+        // Calls _f(i) for every i in [0, _count), split into one contiguous chunk per
+        // thread of _pool, and waits for all chunks. Rethrows the first exception.
+        template <typename F>
+        auto parallel_for(boost::asio::thread_pool& _pool, std::size_t _threads, std::size_t _count, F _f) -> void
+        {
+            const auto chunks = std::min(_threads, _count);
+            std::vector<std::future<void>> done;
+
+            for (std::size_t c = 0; c < chunks; ++c) {
+                const auto first = _count * c / chunks;
+                const auto last = _count * (c + 1) / chunks;
+
+                auto task = std::make_shared<std::packaged_task<void()>>([first, last, &_f] {
+                    for (auto i = first; i < last; ++i)
+                        _f(i);
+                });
+
+                done.push_back(task->get_future());
+                boost::asio::post(_pool, [task] { (*task)(); });
+            }
+
+            // Wait for every chunk before rethrowing, since they all reference _f.
+            std::exception_ptr error;
+
+            for (auto& d : done) {
+                try {
+                    d.get();
+                }
+                catch (...) {
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+
+            if (error)
+                std::rethrow_exception(error);
+        }
+    } // namespace detail
+
+    struct mesh_config
+    {
+        std::size_t queue_pairs_per_peer = 1;
+        std::uint8_t port_number = 1;
+        int gid_index = 0;
+        int pkey_index = 0;
+        int access_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+        std::size_t threads = 0; // The size of the thread pool. Zero uses one thread per core.
+        connection_parameters parameters;
+    };
+
+    // The wall clock time of each stage of a mesh bring-up, in seconds.
+    struct mesh_timings
+    {
+        double create;
+        double init;
+        double exchange;
+        double rtr;
+        double rts;
+        double sync;
+    };
+
+    // The RC queue pairs connecting this node to each of its peers, e.g. one row of
+    // an all-to-all job. Bringing a mesh up runs every stage for all QPs at once: the
+    // QPs are created and transitioned on a thread pool, and the information of all
+    // QPs to a peer is exchanged in a single message over that peer's control channel.
+    //
+    // Every peer must build a mesh with the same number of QPs per peer and call
+    // connect() with its channel to this node at the same position as this node
+    // passes its channel to that peer. QP i to a peer is connected to QP i of the
+    // peer's mesh.
+    class queue_pair_mesh
+    {
+    public:
+        // Creates queue_pairs_per_peer QPs for each of _peers peers. _attrs is used for
+        // every QP, so its completion queues are shared by the whole mesh and must be
+        // large enough for all of them.
+        queue_pair_mesh(const context& _ctx,
+                        const protection_domain& _pd,
+                        const completion_queue& _cq,
+                        const ibv_qp_init_attr& _attrs,
+                        std::size_t _peers,
+                        const mesh_config& _config = {})
+            : ctx_{&_ctx}
+            , config_{_config}
+            , peers_{_peers}
+            , threads_{_config.threads > 0 ? _config.threads : std::max(1u, std::thread::hardware_concurrency())}
+            , pool_{threads_}
+            , qps_(_peers * _config.queue_pairs_per_peer)
+            , psns_(qps_.size())
+            , remote_(qps_.size())
+            , timings_{}
+        {
+            if (_config.queue_pairs_per_peer == 0)
+                throw std::invalid_argument{"a mesh needs at least one queue pair per peer"};
+
+            const auto start = std::chrono::steady_clock::now();
+
+            detail::parallel_for(pool_, threads_, qps_.size(), [&](std::size_t i) {
+                auto attrs = _attrs;
+                qps_[i] = std::make_unique<queue_pair>(_pd, attrs, _cq);
+                psns_[i] = generate_random_int();
+            });
+
+            timings_.create = seconds_since(start);
+        }
+
+        queue_pair_mesh(const queue_pair_mesh&) = delete;
+        auto operator=(const queue_pair_mesh&) -> queue_pair_mesh& = delete;
+
+        ~queue_pair_mesh()
+        {
+            pool_.join();
+        }
+
+        // Brings every QP to RTS. _channels[p] is the control channel to peer p.
+        // _local_mr is advertised to every peer (see remote_memory()).
+        //
+        // The exchange and sync stages wait for the peers, so they talk to all peers
+        // at once on a thread per peer. Otherwise, nodes working through their peers
+        // in different orders could wait for each other in a cycle.
+        auto connect(const std::vector<control_channel*>& _channels,
+                     const remote_memory_region& _local_mr = {}) -> void
+        {
+            if (_channels.size() != peers_)
+                throw std::invalid_argument{"a mesh needs one control channel per peer"};
+
+            const auto port_info = ctx_->port_info(config_.port_number);
+            const auto grh_required = (port_info.flags & IBV_QPF_GRH_REQUIRED) == IBV_QPF_GRH_REQUIRED;
+            const auto gid = ctx_->gid(config_.port_number, config_.gid_index);
+            const auto limits = query_atomic_limits(*ctx_);
+
+            auto start = std::chrono::steady_clock::now();
+
+            detail::parallel_for(pool_, threads_, qps_.size(), [&](std::size_t i) {
+                change_queue_pair_state_to_init(*qps_[i], config_.port_number, config_.pkey_index, config_.access_flags);
+            });
+
+            timings_.init = seconds_since(start);
+            start = std::chrono::steady_clock::now();
+
+            for (std::size_t i = 0; i < qps_.size(); ++i) {
+                remote_[i] = {{qps_[i]->queue_pair_number(), psns_[i], port_info.lid,
+                               limits.max_rd_atomic, limits.max_dest_rd_atomic,
+                               static_cast<std::uint8_t>(port_info.active_mtu), gid}, _local_mr};
+            }
+
+            const auto per_peer = config_.queue_pairs_per_peer;
+
+            for_each_peer([&](std::size_t p) {
+                _channels[p]->exchange(&remote_[p * per_peer], per_peer);
+            });
+
+            timings_.exchange = seconds_since(start);
+            start = std::chrono::steady_clock::now();
+
+            detail::parallel_for(pool_, threads_, qps_.size(), [&](std::size_t i) {
+                const auto negotiated = negotiate_atomic_limits(limits, remote_[i].qp);
+                const auto path_mtu = negotiate_path_mtu(port_info.active_mtu, remote_[i].qp, config_.parameters);
+                change_queue_pair_state_to_rtr(*qps_[i], remote_[i].qp, config_.port_number, config_.gid_index,
+                                               grh_required, negotiated.max_dest_rd_atomic, path_mtu, config_.parameters);
+            });
+
+            timings_.rtr = seconds_since(start);
+            start = std::chrono::steady_clock::now();
+
+            detail::parallel_for(pool_, threads_, qps_.size(), [&](std::size_t i) {
+                const auto negotiated = negotiate_atomic_limits(limits, remote_[i].qp);
+                change_queue_pair_state_to_rts(*qps_[i], psns_[i], negotiated.max_rd_atomic, config_.parameters);
+            });
+
+            timings_.rts = seconds_since(start);
+            start = std::chrono::steady_clock::now();
+
+            for_each_peer([&](std::size_t p) {
+                _channels[p]->sync();
+            });
+
+            timings_.sync = seconds_since(start);
+        }
+
+        auto at(std::size_t _peer, std::size_t _index) -> queue_pair&
+        {
+            return *qps_.at(_peer * config_.queue_pairs_per_peer + _index);
+        }
+
+        // The memory region the peer advertised on QP _index.
+        auto remote_memory(std::size_t _peer, std::size_t _index) const -> const remote_memory_region&
+        {
+            return remote_.at(_peer * config_.queue_pairs_per_peer + _index).mr;
+        }
+
+        auto peers() const noexcept -> std::size_t
+        {
+            return peers_;
+        }
+
+        auto queue_pairs_per_peer() const noexcept -> std::size_t
+        {
+            return config_.queue_pairs_per_peer;
+        }
+
+        auto size() const noexcept -> std::size_t
+        {
+            return qps_.size();
+        }
+
+        auto timings() const noexcept -> const mesh_timings&
+        {
+            return timings_;
+        }
+
+    private:
+        static auto seconds_since(std::chrono::steady_clock::time_point _start) -> double
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        }
+
+        template <typename F>
+        auto for_each_peer(F _f) -> void
+        {
+            std::vector<std::future<void>> done;
+
+            for (std::size_t p = 0; p < peers_; ++p)
+                done.push_back(std::async(std::launch::async, [&_f, p] { _f(p); }));
+
+            for (auto& d : done)
+                d.get();
+        }
+
+        const context* ctx_;
+        mesh_config config_;
+        std::size_t peers_;
+        std::size_t threads_;
+        boost::asio::thread_pool pool_;
+        std::vector<std::unique_ptr<queue_pair>> qps_;
+        std::vector<std::uint32_t> psns_;
+        std::vector<connection_setup> remote_; // Local information until the exchange, the peer's after it.
+        mesh_timings timings_;
+    }; // class queue_pair_mesh
+} // namespace rdma
+
+#endif // KDD_RDMA_QUEUE_PAIR_MESH_HPP
@@ -0,0 +1,191 @@
+#ifndef KDD_RDMA_REGISTRATION_CACHE_HPP
+#define KDD_RDMA_REGISTRATION_CACHE_HPP
+
+#include "protection_domain.hpp"
+#include "memory_region.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace rdma
+{
+    struct registration_cache_statistics
+    {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;
+        std::size_t pinned_bytes; // Bytes currently registered by the cache.
+    };
+
+    // Caches memory regions so that registering a buffer (ibv_reg_mr) can be
+    // removed from the data path. A lookup returns an existing registration that
+    // covers the requested address range with at least the requested access flags.
+    // On a miss, the page-aligned range is registered and cached. When the amount
+    // of registered memory exceeds the pinned memory budget, the least recently
+    // used registrations are evicted.
+    //
+    // Registrations are handed out as shared pointers. An evicted registration is
+    // not deregistered until the last user releases it, so it is always safe to
+    // post work requests using a region returned by the cache.
+    //
+    // The cache cannot detect memory being freed. Call invalidate() before freeing
+    // or unmapping memory that may have been registered through the cache. Otherwise,
+    // a later allocation at the same address could be matched to stale pages.
+    //
+    // This class is not thread-safe.
+    class registration_cache
+    {
+    public:
+        registration_cache(const protection_domain& _pd, std::size_t _pinned_memory_budget)
+            : pd_{&_pd}
+            , budget_{_pinned_memory_budget}
+            , page_size_{static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE))}
+            , max_length_{}
+            , lru_{}
+            , index_{}
+            , stats_{}
+        {
+        }
+
+        registration_cache(const registration_cache&) = delete;
+        auto operator=(const registration_cache&) -> registration_cache& = delete;
+
+        // Returns a memory region covering [_address, _address + _size) registered with
+        // (at least) _access_flags, registering the buffer if no such region is cached.
+        auto acquire(const void* _address, std::size_t _size, int _access_flags) -> std::shared_ptr<const memory_region>
+        {
+            if (_size == 0)
+                throw std::invalid_argument{"cannot register an empty buffer"};
+
+            const auto begin = reinterpret_cast<std::uintptr_t>(_address);
+            const auto end = begin + _size;
+
+            if (const auto iter = find(begin, end, _access_flags); iter != std::end(lru_)) {
+                // Move the entry to the front of the LRU list. Splicing keeps the
+                // iterators stored in the index valid.
+                lru_.splice(std::begin(lru_), lru_, iter);
+                ++stats_.hits;
+                return iter->mr;
+            }
+
+            ++stats_.misses;
+
+            const auto aligned_begin = begin & ~(page_size_ - 1);
+            const auto aligned_end = (end + page_size_ - 1) & ~(page_size_ - 1);
+            const auto length = aligned_end - aligned_begin;
+
+            if (length > budget_)
+                throw std::invalid_argument{"buffer exceeds the pinned memory budget"};
+
+            while (!lru_.empty() && stats_.pinned_bytes + length > budget_)
+                erase(std::prev(std::end(lru_)), true);
+
+            auto mr = std::make_shared<memory_region>(*pd_, reinterpret_cast<void*>(aligned_begin), length, _access_flags);
+
+            lru_.push_front({aligned_begin, aligned_end, _access_flags, std::move(mr)});
+            index_.emplace(aligned_begin, std::begin(lru_));
+
+            stats_.pinned_bytes += length;
+
+            if (length > max_length_)
+                max_length_ = length;
+
+            return lru_.front().mr;
+        }
+
+        // Drops every cached registration overlapping [_address, _address + _size).
+        auto invalidate(const void* _address, std::size_t _size) -> void
+        {
+            const auto begin = reinterpret_cast<std::uintptr_t>(_address);
+            const auto end = begin + _size;
+
+            for (auto iter = std::begin(lru_); iter != std::end(lru_);) {
+                auto current = iter++;
+
+                if (current->begin < end && begin < current->end)
+                    erase(current, false);
+            }
+        }
+
+        auto clear() -> void
+        {
+            lru_.clear();
+            index_.clear();
+            stats_.pinned_bytes = 0;
+            max_length_ = 0;
+        }
+
+        auto statistics() const noexcept -> registration_cache_statistics
+        {
+            return stats_;
+        }
+
+    private:
+        struct entry
+        {
+            std::uintptr_t begin;
+            std::uintptr_t end;
+            int access_flags;
+            std::shared_ptr<memory_region> mr;
+        };
+
+        using lru_list = std::list<entry>;
+
+        auto find(std::uintptr_t _begin, std::uintptr_t _end, int _access_flags) -> lru_list::iterator
+        {
+            // Walk backwards over the registrations starting at or before _begin. No
+            // registration starting before (_end - max_length_) can reach _end.
+            for (auto iter = index_.upper_bound(_begin); iter != std::begin(index_);) {
+                --iter;
+
+                if (iter->first + max_length_ < _end)
+                    break;
+
+                const auto& e = *iter->second;
+
+                if (e.end >= _end && (e.access_flags & _access_flags) == _access_flags)
+                    return iter->second;
+            }
+
+            return std::end(lru_);
+        }
+
+        auto erase(lru_list::iterator _iter, bool _evicted) -> void
+        {
+            auto [first, last] = index_.equal_range(_iter->begin);
+
+            for (; first != last; ++first) {
+                if (first->second == _iter) {
+                    index_.erase(first);
+                    break;
+                }
+            }
+
+            stats_.pinned_bytes -= _iter->end - _iter->begin;
+
+            if (_evicted)
+                ++stats_.evictions;
+
+            lru_.erase(_iter);
+        }
+
+        const protection_domain* pd_;
+        std::size_t budget_;
+        std::uintptr_t page_size_;
+        std::uintptr_t max_length_;
+        lru_list lru_;                                          // Most recently used first.
+        std::multimap<std::uintptr_t, lru_list::iterator> index_; // Keyed by the start of each registration.
+        registration_cache_statistics stats_;
+    }; // class registration_cache
+} // namespace rdma
+
+#endif // KDD_RDMA_REGISTRATION_CACHE_HPP
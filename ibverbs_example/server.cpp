@@ -6,6 +6,7 @@
 
 #include <cstdint>
 #include <cstring>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 #include <string>
@@ -14,8 +15,8 @@
 
 auto main(int _argc, char* _argv[]) -> int
 {
-    if (_argc != 3) {
-        std::cout << "USAGE: server <port> <gid_index>\n";
+    if (_argc != 2 && _argc != 3) {
+        std::cout << "USAGE: server <port> [gid_index]\n";
         return 1;
     }
 
@@ -29,11 +30,19 @@ auto main(int _argc, char* _argv[]) -> int
         }
         std::cout << '\n';
 
-        rdma::context context{devices[0]};
+        // Use the device on this thread's NUMA node, its first active port and the
+        // best GID of that port unless a GID index is given.
+        const auto selection = rdma::select_port(rdma::current_numa_node());
+        std::cout << "Selected device: " << selection.device_name
+                  << ", NUMA node: " << selection.numa_node
+                  << ", port: " << static_cast<int>(selection.port_number)
+                  << ", GID index: " << selection.gid_index << "\n\n";
+
+        rdma::context context{devices[selection.device_name.c_str()]};
         rdma::print_device_info(context);
         std::cout << '\n';
 
-        constexpr auto port_number = 1;
+        const auto port_number = selection.port_number;
         rdma::print_port_info(context, port_number);
         std::cout << '\n';
 
@@ -42,11 +51,13 @@ auto main(int _argc, char* _argv[]) -> int
         std::cout << '\n';
 
         rdma::protection_domain pd{context};
-        //rdma::completion_event_channel evt_ch{context};
+        rdma::completion_event_channel evt_ch{context};
 
+        // The server may wait a long time for the client. Spin briefly, then sleep on
+        // the event channel instead of burning a core.
         constexpr auto cqe_size = 1;
-        rdma::completion_queue cq{cqe_size, context};
-        //rdma::completion_queue cq{cqe_size, evt_ch};
+        rdma::completion_queue cq{cqe_size, evt_ch};
+        cq.set_spin_budget(std::chrono::microseconds{50});
 
         ibv_qp_init_attr qp_init_attrs{};
         qp_init_attrs.qp_type = IBV_QPT_RC;
@@ -69,7 +80,7 @@ auto main(int _argc, char* _argv[]) -> int
 
         const auto sq_psn = rdma::generate_random_int();
         const auto port_info = context.port_info(port_number);
-        const auto gid_index = std::stoi(_argv[2]);
+        const auto gid_index = _argc == 3 ? std::stoi(_argv[2]) : selection.gid_index;
 
         rdma::queue_pair_info qp_info{};
         qp_info.qp_num = qp.queue_pair_number();
@@ -77,22 +88,26 @@ auto main(int _argc, char* _argv[]) -> int
         qp_info.lid = port_info.lid;
         qp_info.gid = context.gid(port_number, gid_index);
 
-        std::cout << "Server Queue Pair Info\n";
-        std::cout << "----------------------\n";
-        rdma::print_queue_pair_info(qp_info);
+        const auto local_atomic_limits = rdma::query_atomic_limits(context);
+        qp_info.max_rd_atomic = local_atomic_limits.max_rd_atomic;
+        qp_info.max_dest_rd_atomic = local_atomic_limits.max_dest_rd_atomic;
+        qp_info.mtu = port_info.active_mtu;
+
+        constexpr auto local_info = true;
+        rdma::print_queue_pair_info(qp_info, local_info);
         std::cout << '\n';
 
         const auto* port = _argv[1];
         constexpr auto is_server = true;
         rdma::exchange_queue_pair_info("", port, qp_info, is_server);
 
-        std::cout << "Client Queue Pair Info\n";
-        std::cout << "----------------------\n";
-        rdma::print_queue_pair_info(qp_info);
+        rdma::print_queue_pair_info(qp_info, !local_info);
         std::cout << '\n';
 
         constexpr auto access_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+        std::cout << "Changing QP state to INIT ...\n";
         rdma::change_queue_pair_state_to_init(qp, port_number, pkey_index, access_flags);
+        std::cout << "QP state changed successfully!\n";
 
         // This is not necessary for initialization. Memory Regions can be registered at
         // any time following initialization.
@@ -101,16 +116,17 @@ auto main(int _argc, char* _argv[]) -> int
         qp.post_receive(buffer, mr);
 
         const auto grh_required = (port_info.flags & IBV_QPF_GRH_REQUIRED) == IBV_QPF_GRH_REQUIRED;
-        rdma::change_queue_pair_state_to_rtr(qp,
-                                             qp_info.qp_num,
-                                             qp_info.rq_psn,
-                                             qp_info.lid,
-                                             qp_info.gid,
-                                             port_number,
-                                             gid_index,
-                                             grh_required);
-
-        rdma::change_queue_pair_state_to_rts(qp, sq_psn);
+        std::cout << "Changing QP state to RTR ...\n";
+        const auto atomic_limits = rdma::negotiate_atomic_limits(local_atomic_limits, qp_info);
+        const auto path_mtu = rdma::negotiate_path_mtu(port_info.active_mtu, qp_info);
+        std::cout << "Path MTU: " << rdma::to_string(path_mtu) << '\n';
+        rdma::change_queue_pair_state_to_rtr(qp, qp_info, port_number, gid_index, grh_required,
+                                             atomic_limits.max_dest_rd_atomic, path_mtu);
+        std::cout << "QP state changed successfully!\n";
+
+        std::cout << "Changing QP state to RTS ...\n";
+        rdma::change_queue_pair_state_to_rts(qp, sq_psn, atomic_limits.max_rd_atomic);
+        std::cout << "QP state changed successfully!\n";
 
         {
             const auto [qp_attrs, q_attrs] = qp.query_attribute(IBV_QP_RQ_PSN | IBV_QP_AV);
@@ -119,7 +135,8 @@ auto main(int _argc, char* _argv[]) -> int
             std::cout << '\n';
         }
 
-        const auto wc = qp.wait_for_completion();
+        ibv_wc wc{};
+        cq.wait(&wc, 1);
         std::cout << "WC Status: " << ibv_wc_status_str(wc.status) << ", Code: " << wc.status << '\n';
 
         if (wc.status == IBV_WC_SUCCESS) {
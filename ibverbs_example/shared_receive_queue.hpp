@@ -0,0 +1,271 @@
+#ifndef KDD_RDMA_SHARED_RECEIVE_QUEUE_HPP
+#define KDD_RDMA_SHARED_RECEIVE_QUEUE_HPP
+
+#include "context.hpp"
+#include "protection_domain.hpp"
+#include "completion_queue.hpp"
+#include "work_request.hpp"
+#include "buffer_pool.hpp"
+
+#include <infiniband/verbs.h>
+
+#include <stdio.h>
+#include <errno.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+namespace rdma
+{
+    // A receive queue that any number of queue pairs can draw receive buffers from.
+    // Queue pairs are attached at construction (see queue_pair). A server with many
+    // mostly idle connections only needs enough posted buffers for the aggregate
+    // message rate instead of a full receive queue per connection.
+    //
+    // The receive completions of every attached QP go to that QP's completion
+    // queue. Use ibv_wc::qp_num to tell the connections apart.
+    class shared_receive_queue
+    {
+    public:
+        shared_receive_queue(const protection_domain& _pd,
+                             std::uint32_t _max_wr,
+                             std::uint32_t _max_sge = 1)
+            : srq_{}
+            , capacity_{}
+            , recv_wrs_{}
+            , recv_sges_{}
+        {
+            ibv_srq_init_attr attrs{};
+            attrs.attr.max_wr = _max_wr;
+            attrs.attr.max_sge = _max_sge;
+
+            srq_ = ibv_create_srq(&_pd.handle(), &attrs);
+
+            if (!srq_) {
+                perror("ibv_create_srq");
+                throw std::runtime_error{"ibv_create_srq error"};
+            }
+
+            // The device may round the queue size up.
+            capacity_ = attrs.attr.max_wr;
+        }
+
+        shared_receive_queue(const shared_receive_queue&) = delete;
+        auto operator=(const shared_receive_queue&) -> shared_receive_queue& = delete;
+
+        ~shared_receive_queue()
+        {
+            if (srq_)
+                ibv_destroy_srq(srq_);
+        }
+
+        auto handle() const noexcept -> ibv_srq&
+        {
+            return *srq_;
+        }
+
+        auto capacity() const noexcept -> std::uint32_t
+        {
+            return capacity_;
+        }
+
+        // Chains the buffers into a single linked list of receive work requests and
+        // posts the entire list with one call to ibv_post_srq_recv. On failure, a
+        // post_error is thrown identifying the first work request that was not posted.
+        auto post_receive(const buffer_descriptor* _buffers, std::size_t _count) -> void
+        {
+            if (_count == 0)
+                return;
+
+            if (recv_wrs_.size() < _count) {
+                recv_wrs_.resize(_count);
+                recv_sges_.resize(_count);
+            }
+
+            for (std::size_t i = 0; i < _count; ++i) {
+                auto& sge = recv_sges_[i];
+                sge.addr = reinterpret_cast<std::uintptr_t>(_buffers[i].address);
+                sge.length = _buffers[i].length;
+                sge.lkey = _buffers[i].local_key;
+
+                auto& wr = recv_wrs_[i];
+                wr = {};
+                wr.wr_id = _buffers[i].wr_id;
+                wr.sg_list = &sge;
+                wr.num_sge = 1;
+                wr.next = (i + 1 < _count) ? &recv_wrs_[i + 1] : nullptr;
+            }
+
+            ibv_recv_wr* bad_wr{};
+
+            if (ibv_post_srq_recv(srq_, recv_wrs_.data(), &bad_wr)) {
+                perror("ibv_post_srq_recv");
+                throw post_error{"ibv_post_srq_recv error", bad_wr ? static_cast<std::size_t>(bad_wr - recv_wrs_.data()) : 0};
+            }
+        }
+
+        auto post_receive(const std::vector<buffer_descriptor>& _buffers) -> void
+        {
+            post_receive(_buffers.data(), _buffers.size());
+        }
+
+        // Requests an IBV_EVENT_SRQ_LIMIT_REACHED asynchronous event once fewer than
+        // _limit receive work requests remain posted. The limit is disarmed when the
+        // event fires and must be armed again. A limit of zero disarms it.
+        auto arm_limit(std::uint32_t _limit) -> void
+        {
+            ibv_srq_attr attrs{};
+            attrs.srq_limit = _limit;
+
+            if (ibv_modify_srq(srq_, &attrs, IBV_SRQ_LIMIT)) {
+                perror("ibv_modify_srq");
+                throw std::runtime_error{"ibv_modify_srq error"};
+            }
+        }
+
+    private:
+        ibv_srq* srq_;
+        std::uint32_t capacity_;
+        std::vector<ibv_recv_wr> recv_wrs_;
+        std::vector<ibv_sge> recv_sges_;
+    }; // class shared_receive_queue
+
+    // Keeps a shared receive queue stocked with buffers taken from a buffer_pool.
+    //
+    // The replenisher posts buffers until _depth receive work requests are posted
+    // and arms the SRQ limit at _low_watermark. Forward asynchronous events to
+    // handle_async_event(). When the limit event fires, the queue is topped up again,
+    // so the thread polling for receive completions never has to post buffers.
+    //
+    // Work request ids carry _tag and the buffer's pool id (see make_work_request_id),
+    // so a receive completion maps back to its buffer through take(). Buffers must be
+    // handed back through release() once their contents have been consumed.
+    //
+    // take() and release() may be called concurrently with handle_async_event(). The
+    // SRQ must not be posted to by anything but the replenisher.
+    class srq_replenisher
+    {
+    public:
+        srq_replenisher(shared_receive_queue& _srq,
+                        buffer_pool& _pool,
+                        std::uint32_t _buffer_size,
+                        std::uint32_t _depth,
+                        std::uint32_t _low_watermark,
+                        std::uint16_t _tag = 0)
+            : srq_{&_srq}
+            , pool_{&_pool}
+            , buffer_size_{_buffer_size}
+            , depth_{_depth}
+            , low_watermark_{_low_watermark}
+            , tag_{_tag}
+            , posted_{}
+            , mutex_{}
+            , buffers_{}
+        {
+            if (_depth == 0 || _depth > _srq.capacity())
+                throw std::invalid_argument{"replenish depth must be between one and the SRQ capacity"};
+
+            if (_low_watermark >= _depth)
+                throw std::invalid_argument{"low watermark must be less than the replenish depth"};
+
+            buffers_.reserve(_depth);
+            replenish();
+        }
+
+        srq_replenisher(const srq_replenisher&) = delete;
+        auto operator=(const srq_replenisher&) -> srq_replenisher& = delete;
+
+        // Posts buffers until depth() receive work requests are posted, or the pool runs
+        // out of buffers, and re-arms the SRQ limit. Returns the number of buffers posted.
+        auto replenish() -> std::uint32_t
+        {
+            std::lock_guard lock{mutex_};
+
+            buffers_.clear();
+
+            for (auto n = depth_ - std::min(depth_, posted_.load(std::memory_order_acquire)); n > 0; --n) {
+                const auto buffer = pool_->try_allocate(buffer_size_);
+
+                if (!buffer)
+                    break;
+
+                buffers_.push_back({make_work_request_id(tag_, buffer->id), buffer->data, buffer_size_, buffer->local_key});
+            }
+
+            try {
+                srq_->post_receive(buffers_);
+            }
+            catch (const post_error& e) {
+                for (auto i = e.failed_index(); i < buffers_.size(); ++i)
+                    pool_->deallocate(pool_->buffer_from_id(static_cast<std::uint32_t>(work_request_value(buffers_[i].wr_id))));
+
+                posted_.fetch_add(static_cast<std::uint32_t>(e.failed_index()), std::memory_order_release);
+                throw;
+            }
+
+            posted_.fetch_add(static_cast<std::uint32_t>(buffers_.size()), std::memory_order_release);
+
+            if (low_watermark_ > 0)
+                srq_->arm_limit(low_watermark_);
+
+            return static_cast<std::uint32_t>(buffers_.size());
+        }
+
+        // Replenishes the SRQ if _event is its limit event. Returns true if the event
+        // was handled.
+        auto handle_async_event(const async_event& _event) -> bool
+        {
+            if (_event.type() != IBV_EVENT_SRQ_LIMIT_REACHED || _event.handle().element.srq != &srq_->handle())
+                return false;
+
+            replenish();
+            return true;
+        }
+
+        // Returns the buffer filled by a successful receive completion.
+        auto take(const ibv_wc& _wc) -> pooled_buffer
+        {
+            posted_.fetch_sub(1, std::memory_order_acq_rel);
+            return pool_->buffer_from_id(static_cast<std::uint32_t>(work_request_value(_wc.wr_id)));
+        }
+
+        // Returns a buffer to the pool. If the SRQ ran low because the pool was
+        // exhausted, the buffer is posted right away.
+        auto release(const pooled_buffer& _buffer) -> void
+        {
+            pool_->deallocate(_buffer);
+
+            if (posted_.load(std::memory_order_acquire) < low_watermark_)
+                replenish();
+        }
+
+        // The number of receive work requests currently posted to the SRQ.
+        auto posted() const noexcept -> std::uint32_t
+        {
+            return posted_.load(std::memory_order_acquire);
+        }
+
+        auto depth() const noexcept -> std::uint32_t
+        {
+            return depth_;
+        }
+
+    private:
+        shared_receive_queue* srq_;
+        buffer_pool* pool_;
+        std::uint32_t buffer_size_;
+        std::uint32_t depth_;
+        std::uint32_t low_watermark_;
+        std::uint16_t tag_;
+        std::atomic<std::uint32_t> posted_;
+        std::mutex mutex_;
+        std::vector<buffer_descriptor> buffers_;
+    }; // class srq_replenisher
+} // namespace rdma
+
+#endif // KDD_RDMA_SHARED_RECEIVE_QUEUE_HPP
@@ -0,0 +1,317 @@
+// Runs the sysfs based device selection and CPU placement against fixture trees
+// laid out like /sys and /proc, so they can be checked without an RDMA device:
+//
+//   - find_gid_index() ranks RoCE v2 IPv4 over RoCE v2 global IPv6 over RoCE v2
+//     link-local over RoCE v1, skips zero GIDs and entries without a type, and
+//     uses index 0 on InfiniBand ports.
+//   - find_active_port() skips ports that are not ACTIVE.
+//   - select_port() prefers devices on the requested NUMA node, tries every active
+//     port of a device, falls back to other nodes when the local device has no
+//     usable port, and throws without any.
+//   - parse_cpu_list() expands kernel CPU lists, and device_local_cpus() reads the
+//     CPUs of the device's node or falls back to all online CPUs.
+//   - cpu_for_completion_vector() finds the vector's interrupt by its action name
+//     and reads its effective or configured affinity, and falls back to the i-th
+//     local CPU without one.
+//
+// The fixture trees are created under a temporary directory, which is removed
+// unless a check fails.
+
+#include "device_selection.hpp"
+#include "completion_vector.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    int failures = 0;
+
+    auto check(bool _condition, const std::string& _what) -> void
+    {
+        std::cout << (_condition ? "ok   " : "FAIL ") << _what << '\n';
+
+        if (!_condition)
+            ++failures;
+    }
+
+    auto write_file(const fs::path& _path, const std::string& _content) -> void
+    {
+        fs::create_directories(_path.parent_path());
+        std::ofstream out{_path};
+        out << _content << '\n';
+
+        if (!out)
+            throw std::runtime_error{"cannot write " + _path.string()};
+    }
+
+    // A device under <root>/class/infiniband.
+    class fixture_device
+    {
+    public:
+        fixture_device(const fs::path& _root, const std::string& _name, int _numa_node)
+            : path_{_root / "class" / "infiniband" / _name}
+        {
+            write_file(path_ / "device" / "numa_node", std::to_string(_numa_node));
+        }
+
+        // _state is the sysfs text, e.g. "4: ACTIVE" or "1: DOWN".
+        auto add_port(int _port, const std::string& _state, const std::string& _link_layer) -> fixture_device&
+        {
+            write_file(port(_port) / "state", _state);
+            write_file(port(_port) / "link_layer", _link_layer);
+            fs::create_directories(port(_port) / "gids");
+            return *this;
+        }
+
+        // _gid is in the sysfs format of eight groups of four hex digits. An empty
+        // _type leaves the attribute unset, like the kernel does for unused entries.
+        auto add_gid(int _port, int _index, const std::string& _gid, const std::string& _type) -> fixture_device&
+        {
+            write_file(port(_port) / "gids" / std::to_string(_index), _gid);
+
+            if (!_type.empty())
+                write_file(port(_port) / "gid_attrs" / "types" / std::to_string(_index), _type);
+
+            return *this;
+        }
+
+        auto remove_gid(int _port, int _index) -> fixture_device&
+        {
+            fs::remove(port(_port) / "gids" / std::to_string(_index));
+            fs::remove(port(_port) / "gid_attrs" / "types" / std::to_string(_index));
+            return *this;
+        }
+
+        // An MSI-X interrupt of the device's PCI function, named _action.
+        auto add_irq(const fs::path& _root, int _irq, const std::string& _action) -> fixture_device&
+        {
+            write_file(path_ / "device" / "msi_irqs" / std::to_string(_irq), "msix");
+            write_file(_root / "kernel" / "irq" / std::to_string(_irq) / "actions", _action);
+            return *this;
+        }
+
+    private:
+        auto port(int _port) const -> fs::path
+        {
+            return path_ / "ports" / std::to_string(_port);
+        }
+
+        fs::path path_;
+    }; // class fixture_device
+
+    const std::string zero_gid = "0000:0000:0000:0000:0000:0000:0000:0000";
+    const std::string link_local_gid = "fe80:0000:0000:0000:0202:c9ff:fe00:0001";
+    const std::string global_gid = "2001:0db8:0000:0000:0000:0000:0000:0001";
+    const std::string ipv4_gid = "0000:0000:0000:0000:0000:ffff:c0a8:0102";
+
+    auto check_gid_ranking(const fs::path& _root) -> void
+    {
+        const auto root = (_root / "gid_ranking").string();
+        fixture_device dev{root, "mlx5_0", 0};
+
+        dev.add_port(1, "4: ACTIVE", "Ethernet")
+           .add_gid(1, 0, link_local_gid, "IB/RoCE v1")
+           .add_gid(1, 1, link_local_gid, "RoCE v2")
+           .add_gid(1, 2, ipv4_gid, "IB/RoCE v1")
+           .add_gid(1, 3, global_gid, "RoCE v2")
+           .add_gid(1, 4, zero_gid, "RoCE v2")
+           .add_gid(1, 5, ipv4_gid, "RoCE v2")
+           .add_gid(1, 6, ipv4_gid, "");
+
+        check(rdma::find_gid_index("mlx5_0", 1, root) == 5, "RoCE v2 IPv4 is preferred over everything else");
+
+        dev.remove_gid(1, 5);
+        check(rdma::find_gid_index("mlx5_0", 1, root) == 3, "RoCE v2 global IPv6 is preferred over link-local and v1");
+
+        dev.remove_gid(1, 3);
+        check(rdma::find_gid_index("mlx5_0", 1, root) == 1, "RoCE v2 link-local is preferred over v1");
+
+        dev.remove_gid(1, 1);
+        check(rdma::find_gid_index("mlx5_0", 1, root) == 0, "the first RoCE v1 entry is used without v2 entries");
+
+        dev.remove_gid(1, 0).remove_gid(1, 2);
+        check(!rdma::find_gid_index("mlx5_0", 1, root), "zero GIDs and entries without a type are skipped");
+
+        fixture_device ib{root, "mlx4_0", 0};
+        ib.add_port(1, "4: ACTIVE", "InfiniBand");
+        check(rdma::find_gid_index("mlx4_0", 1, root) == 0, "InfiniBand ports use GID index 0");
+    }
+
+    auto check_port_selection(const fs::path& _root) -> void
+    {
+        const auto root = (_root / "port_selection").string();
+
+        // mlx5_0 and mlx5_1 are on node 1, mlx5_2 on node 0. mlx5_0 has no active
+        // port and mlx5_1 only its second one.
+        fixture_device{root, "mlx5_0", 1}
+            .add_port(1, "1: DOWN", "Ethernet")
+            .add_gid(1, 0, ipv4_gid, "RoCE v2");
+
+        fixture_device{root, "mlx5_1", 1}
+            .add_port(1, "2: INIT", "Ethernet")
+            .add_gid(1, 0, ipv4_gid, "RoCE v2")
+            .add_port(2, "4: ACTIVE", "Ethernet")
+            .add_gid(2, 0, link_local_gid, "IB/RoCE v1")
+            .add_gid(2, 1, ipv4_gid, "RoCE v2");
+
+        fixture_device{root, "mlx5_2", 0}
+            .add_port(1, "4: ACTIVE", "InfiniBand")
+            .add_gid(1, 0, link_local_gid, "");
+
+        check(!rdma::find_active_port("mlx5_0", root), "a device without an active port has none");
+        check(rdma::find_active_port("mlx5_1", root) == 2, "inactive ports are skipped");
+
+        const auto local = rdma::select_port(1, root);
+        check(local.device_name == "mlx5_1" && local.port_number == 2 && local.gid_index == 1 &&
+              local.numa_node == 1 && local.roce,
+              "the local device with an active port is selected");
+
+        const auto other_node = rdma::select_port(0, root);
+        check(other_node.device_name == "mlx5_2" && other_node.port_number == 1 && other_node.gid_index == 0 &&
+              !other_node.roce,
+              "a device on the requested node is preferred");
+
+        const auto unknown_node = rdma::select_port(-1, root);
+        check(unknown_node.device_name == "mlx5_1", "without a node the first usable device is selected");
+
+        // With the only active device on node 1 gone, node 1 falls back to node 0.
+        fs::remove_all(fs::path{root} / "class" / "infiniband" / "mlx5_1");
+        const auto fallback = rdma::select_port(1, root);
+        check(fallback.device_name == "mlx5_2" && fallback.numa_node == 0,
+              "a device on another node is selected if no local port is active");
+
+        fs::remove_all(fs::path{root} / "class" / "infiniband" / "mlx5_2");
+        bool threw = false;
+
+        try {
+            rdma::select_port(1, root);
+        }
+        catch (const std::runtime_error&) {
+            threw = true;
+        }
+
+        check(threw, "selection fails without an active port");
+    }
+
+    auto check_dual_port(const fs::path& _root) -> void
+    {
+        const auto root = (_root / "dual_port").string();
+
+        // Both ports of mlx5_0 are active, but port 1 has no address configured.
+        // mlx5_1 on the other node would be usable.
+        fixture_device{root, "mlx5_0", 0}
+            .add_port(1, "4: ACTIVE", "Ethernet")
+            .add_gid(1, 0, zero_gid, "IB/RoCE v1")
+            .add_gid(1, 1, zero_gid, "RoCE v2")
+            .add_port(2, "4: ACTIVE", "Ethernet")
+            .add_gid(2, 0, link_local_gid, "IB/RoCE v1")
+            .add_gid(2, 1, ipv4_gid, "RoCE v2");
+
+        fixture_device{root, "mlx5_1", 1}
+            .add_port(1, "4: ACTIVE", "Ethernet")
+            .add_gid(1, 0, ipv4_gid, "RoCE v2");
+
+        check(rdma::find_active_ports("mlx5_0", root) == std::vector<std::uint8_t>{1, 2}, "all active ports are listed");
+
+        const auto s = rdma::select_port(0, root);
+        check(s.device_name == "mlx5_0" && s.port_number == 2 && s.gid_index == 1,
+              "an active port without a usable GID does not rule out the device");
+    }
+
+    auto check_cpu_lists(const fs::path& _root) -> void
+    {
+        const auto root = (_root / "cpu_lists").string();
+
+        check(rdma::parse_cpu_list("0-3,8,10-11") == std::vector<int>{0, 1, 2, 3, 8, 10, 11}, "CPU ranges are expanded");
+        check(rdma::parse_cpu_list("5") == std::vector<int>{5}, "a single CPU is parsed");
+        check(rdma::parse_cpu_list("").empty(), "an empty CPU list is empty");
+
+        write_file(fs::path{root} / "devices" / "system" / "node" / "node1" / "cpulist", "8-11");
+        write_file(fs::path{root} / "devices" / "system" / "cpu" / "online", "0-11");
+
+        fixture_device{root, "mlx5_0", 1};
+        fixture_device{root, "mlx5_1", 2};
+        fixture_device{root, "rxe0", -1};
+
+        check(rdma::device_local_cpus("mlx5_0", root) == std::vector<int>{8, 9, 10, 11},
+              "the CPUs of the device's node are local");
+        check(rdma::device_local_cpus("rxe0", root).size() == 12, "all online CPUs are local without a node");
+        check(rdma::device_local_cpus("mlx5_1", root).size() == 12, "all online CPUs are local if the node is unknown");
+    }
+
+    auto check_completion_vector_cpus(const fs::path& _root) -> void
+    {
+        const auto root = _root / "completion_vectors";
+        const auto sysfs = (root / "sys").string();
+        const auto procfs = (root / "proc").string();
+
+        write_file(root / "sys" / "devices" / "system" / "node" / "node0" / "cpulist", "4-7");
+
+        fixture_device{sysfs, "mlx5_0", 0}
+            .add_irq(sysfs, 40, "mlx5_async0@pci:0000:3b:00.0")
+            .add_irq(sysfs, 41, "mlx5_comp0@pci:0000:3b:00.0")
+            .add_irq(sysfs, 42, "mlx5_comp1@pci:0000:3b:00.0")
+            .add_irq(sysfs, 50, "mlx5_comp10@pci:0000:3b:00.0");
+
+        fixture_device{sysfs, "mlx4_0", 0}
+            .add_irq(sysfs, 60, "mlx4-comp-3@pci:0000:04:00.0");
+
+        fixture_device{sysfs, "rxe0", 0};
+
+        write_file(root / "proc" / "irq" / "41" / "effective_affinity_list", "6");
+        write_file(root / "proc" / "irq" / "41" / "smp_affinity_list", "4-7");
+        write_file(root / "proc" / "irq" / "42" / "smp_affinity_list", "5,7");
+
+        check(rdma::completion_vector_irq("mlx5_0", 1, sysfs) == 42, "the interrupt is found by its action name");
+        check(rdma::completion_vector_irq("mlx5_0", 10, sysfs) == 50, "comp10 belongs to vector 10, not 1");
+        check(rdma::completion_vector_irq("mlx4_0", 3, sysfs) == 60, "dashed action names are matched");
+        check(!rdma::completion_vector_irq("rxe0", 0, sysfs), "devices without MSI-X interrupts have none");
+
+        check(rdma::cpu_for_completion_vector("mlx5_0", 0, sysfs, procfs) == 6, "the effective affinity is preferred");
+        check(rdma::cpu_for_completion_vector("mlx5_0", 1, sysfs, procfs) == 5, "the configured affinity is used without it");
+        check(rdma::cpu_for_completion_vector("mlx5_0", 10, sysfs, procfs) == 6,
+              "an interrupt without an affinity falls back to the i-th local CPU");
+        check(rdma::cpu_for_completion_vector("mlx5_0", 2, sysfs, procfs) == 6,
+              "a vector without an interrupt falls back to the i-th local CPU");
+        check(rdma::cpu_for_completion_vector("rxe0", 5, sysfs, procfs) == 5, "the fallback wraps around the local CPUs");
+    }
+} // anonymous namespace
+
+auto main() -> int
+{
+    const auto root = fs::temp_directory_path() / ("rdma_sysfs_fixtures." + std::to_string(getpid()));
+
+    try {
+        fs::create_directories(root);
+
+        check_gid_ranking(root);
+        check_port_selection(root);
+        check_dual_port(root);
+        check_cpu_lists(root);
+        check_completion_vector_cpus(root);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed, fixtures left in " << root << '\n';
+        return 1;
+    }
+
+    fs::remove_all(root);
+    return 0;
+}
@@ -12,11 +12,13 @@
 
 #include <cstdint>
 #include <cstring>
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <sstream>
 #include <random>
+#include <stdexcept>
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     inline std::uint64_t htonll(std::uint64_t _x) { return bswap_64(_x); }
@@ -35,9 +37,84 @@ namespace rdma
         std::uint32_t qp_num;
         std::uint32_t rq_psn;
         std::uint16_t lid;
+        std::uint8_t max_rd_atomic;      // RDMA READs/atomics this side can have outstanding as the initiator.
+        std::uint8_t max_dest_rd_atomic; // RDMA READs/atomics this side can serve concurrently as the target.
+        std::uint8_t mtu;                // The active MTU (an ibv_mtu) of this side's port.
         ibv_gid gid;
     };
 
+    // The timing parameters of a connected QP. The defaults are the values that used
+    // to be hardcoded in the state transitions.
+    struct connection_parameters
+    {
+        std::uint8_t min_rnr_timer = 12;     // RTR. Delay the peer waits after an RNR NAK (12 = 0.64 ms).
+        std::uint8_t timeout = 14;           // RTS. ACK timeout of 4.096 us * 2^timeout (14 = 67 ms).
+        std::uint8_t retry_count = 7;        // RTS. Retransmissions after an ACK timeout.
+        std::uint8_t rnr_retry = 7;          // RTS. Retransmissions after an RNR NAK. 7 retries forever.
+        ibv_mtu max_path_mtu = IBV_MTU_4096; // The largest path MTU negotiate_path_mtu() returns.
+    };
+
+    inline constexpr auto mtu_to_bytes(ibv_mtu _mtu) noexcept -> int
+    {
+        return 128 << _mtu;
+    }
+
+    inline auto mtu_from_bytes(int _bytes) -> ibv_mtu
+    {
+        switch (_bytes) {
+            case 256:  return IBV_MTU_256;
+            case 512:  return IBV_MTU_512;
+            case 1024: return IBV_MTU_1024;
+            case 2048: return IBV_MTU_2048;
+            case 4096: return IBV_MTU_4096;
+            default:   throw std::invalid_argument{"MTU must be 256, 512, 1024, 2048 or 4096 bytes"};
+        }
+    }
+
+    // The path MTU of a connection is the smaller of both ports' active MTU. With
+    // RoCE, the active MTU follows the MTU of the network interface. Peers that do
+    // not advertise an MTU get IBV_MTU_512, the MTU that used to be hardcoded.
+    inline auto negotiate_path_mtu(ibv_mtu _local_mtu,
+                                   const queue_pair_info& _remote_info,
+                                   const connection_parameters& _params = {}) -> ibv_mtu
+    {
+        const auto remote_mtu = _remote_info.mtu != 0 ? static_cast<ibv_mtu>(_remote_info.mtu) : IBV_MTU_512;
+        return std::min({_local_mtu, remote_mtu, _params.max_path_mtu});
+    }
+
+    // Limits on the number of outstanding RDMA READ and atomic operations of a
+    // connected QP. Each side advertises its device limits in queue_pair_info and
+    // both sides settle on the minimum of what one side initiates and the other
+    // side serves (see negotiate_atomic_limits()).
+    struct atomic_limits
+    {
+        std::uint8_t max_rd_atomic;      // Passed to change_queue_pair_state_to_rts.
+        std::uint8_t max_dest_rd_atomic; // Passed to change_queue_pair_state_to_rtr.
+    };
+
+    // The device limits, clamped to the range of the QP attributes.
+    inline auto query_atomic_limits(const context& _c) -> atomic_limits
+    {
+        const auto info = _c.device_info();
+        const auto clamp = [](int _value) {
+            return static_cast<std::uint8_t>(std::clamp(_value, 0, 255));
+        };
+
+        return {clamp(info.max_qp_init_rd_atom), clamp(info.max_qp_rd_atom)};
+    }
+
+    // Peers that do not advertise their limits (zero) are assumed to support a single
+    // outstanding operation, like negotiate_path_mtu() assumes IBV_MTU_512.
+    inline auto negotiate_atomic_limits(const atomic_limits& _local, const queue_pair_info& _remote) -> atomic_limits
+    {
+        const auto advertised = [](std::uint8_t _value) {
+            return _value != 0 ? _value : std::uint8_t{1};
+        };
+
+        return {std::min(_local.max_rd_atomic, advertised(_remote.max_dest_rd_atomic)),
+                std::min(_local.max_dest_rd_atomic, advertised(_remote.max_rd_atomic))};
+    }
+
     // Once the QP has been transitioned to this state, the user may post receive
     // requests. At least one receive buffer should be posted before transitioning
     // the QP to the RTR state. However, this implies the completion queue used by
@@ -48,7 +125,6 @@ namespace rdma
                                                 int _pkey_index,
                                                 int _access_flags) -> void
     {
-        std::cout << "Changing QP state to INIT ...\n";
         ibv_qp_attr attrs{};
 
         attrs.qp_state = IBV_QPS_INIT;
@@ -65,27 +141,29 @@ namespace rdma
                             IBV_QP_ACCESS_FLAGS);
 
         _qp.modify_attribute(attrs, props);
-        std::cout << "QP state changed successfully!\n";
     }
 
     // Requires at least one receive buffer be posted before transitioning
     // the QP to the RTR state. Once the QP is transitioned to this state, it begins
-    // receive processing.
+    // receive processing. _max_dest_rd_atomic and _path_mtu have no defaults. They
+    // come from negotiate_atomic_limits() and negotiate_path_mtu().
     inline auto change_queue_pair_state_to_rtr(queue_pair& _qp,
                                                const queue_pair_info& _remote_info,
                                                std::uint8_t _port_number,
                                                std::uint8_t _gid_index,
-                                               bool _grh_required) -> void
+                                               bool _grh_required,
+                                               std::uint8_t _max_dest_rd_atomic,
+                                               ibv_mtu _path_mtu,
+                                               const connection_parameters& _params = {}) -> void
     {
-        std::cout << "Changing QP state to RTR ...\n";
         ibv_qp_attr attrs{};
 
         attrs.qp_state = IBV_QPS_RTR;
-        attrs.path_mtu = IBV_MTU_512; // Recommended value.
+        attrs.path_mtu = _path_mtu; // See negotiate_path_mtu.
         attrs.dest_qp_num = _remote_info.qp_num;
         attrs.rq_psn = _remote_info.rq_psn; // This should match the remote QP's sq_psn.
-        attrs.max_dest_rd_atomic = 1;
-        attrs.min_rnr_timer = 12; // Recommended value.
+        attrs.max_dest_rd_atomic = _max_dest_rd_atomic;
+        attrs.min_rnr_timer = _params.min_rnr_timer;
         attrs.ah_attr.dlid = _remote_info.lid;
         attrs.ah_attr.sl = 0;
         attrs.ah_attr.src_path_bits = 0;
@@ -109,22 +187,24 @@ namespace rdma
                             IBV_QP_MIN_RNR_TIMER);
 
         _qp.modify_attribute(attrs, props);
-        std::cout << "QP state changed successfully!\n";
     }
 
     // Once the QP is transitioned to this state, it begins send processing and is fully
-    // operational. The user can now post send requests.
-    inline auto change_queue_pair_state_to_rts(queue_pair& _qp, std::uint32_t _sq_psn) -> void
+    // operational. The user can now post send requests. Like _max_dest_rd_atomic on
+    // RTR, _max_rd_atomic has no default and comes from negotiate_atomic_limits().
+    inline auto change_queue_pair_state_to_rts(queue_pair& _qp,
+                                               std::uint32_t _sq_psn,
+                                               std::uint8_t _max_rd_atomic,
+                                               const connection_parameters& _params = {}) -> void
     {
-        std::cout << "Changing QP state to RTS ...\n";
         ibv_qp_attr attrs{};
 
         attrs.qp_state = IBV_QPS_RTS;
-        attrs.timeout = 14; // Recommended value.
-        attrs.retry_cnt = 7; // Recommended value.
-        attrs.rnr_retry = 7; // Recommended value.
+        attrs.timeout = _params.timeout;
+        attrs.retry_cnt = _params.retry_count;
+        attrs.rnr_retry = _params.rnr_retry;
         attrs.sq_psn = _sq_psn; // Should match the remote QP's rq_psn.
-        attrs.max_rd_atomic = 1;
+        attrs.max_rd_atomic = _max_rd_atomic;
 
         const auto props = (IBV_QP_STATE |
                             IBV_QP_TIMEOUT |
@@ -134,69 +214,118 @@ namespace rdma
                             IBV_QP_MAX_QP_RD_ATOMIC);
 
         _qp.modify_attribute(attrs, props);
-        std::cout << "QP state changed successfully!\n";
     }
 
-    inline
-    auto exchange_queue_pair_info(const std::string& _host,
-                                  const std::string& _port,
-                                  queue_pair_info& _qp_info,
-                                  bool _is_server) -> void
+    namespace detail
     {
-        using tcp = boost::asio::ip::tcp;
-
-        _qp_info.qp_num = htonl(_qp_info.qp_num);
-        _qp_info.lid = htons(_qp_info.lid);
+        // Swaps a trivially copyable object with the peer over a short-lived TCP
+        // connection. The server listens on _port. The client connects to _host:_port.
+        template <typename T>
+        auto exchange_with_peer(const std::string& _host,
+                                const std::string& _port,
+                                T& _info,
+                                bool _is_server) -> void
+        {
+            using tcp = boost::asio::ip::tcp;
+
+            if (_is_server) {
+                boost::asio::io_service io_service;
+
+                tcp::endpoint endpoint(tcp::v4(), std::stoi(_port));
+                tcp::acceptor acceptor{io_service, endpoint};
+
+                std::cout << "Waiting for client to connect ... ";
+                tcp::iostream stream;
+                boost::system::error_code ec;
+                acceptor.accept(*stream.rdbuf(), ec);
+
+                if (ec) {
+                    throw std::runtime_error{"connect_queue_pairs server error"};
+                }
+
+                std::cout << "connected!\n";
+                std::cout << "Exchanging QP information with client ... ";
+
+                // Capture the client's queue pair information.
+                T client_info{};
+                stream.read((char*) &client_info, sizeof(T));
+
+                // Send the server's queue pair information.
+                stream.write((char*) &_info, sizeof(T));
+
+                // Copy the client's info into the out parameter.
+                _info = client_info;
+            }
+            else {
+                std::cout << "Connecting to server ... ";
+                tcp::iostream stream{_host, _port};
 
-        if (_is_server) {
-            boost::asio::io_service io_service;
+                if (!stream)
+                    throw std::runtime_error{"connect_queue_pairs client error"};
 
-            tcp::endpoint endpoint(tcp::v4(), std::stoi(_port));
-            tcp::acceptor acceptor{io_service, endpoint};
+                std::cout << "connected!\n";
+                std::cout << "Exchanging QP information with server ... ";
 
-            std::cout << "Waiting for client to connect ... ";
-            tcp::iostream stream;
-            boost::system::error_code ec;
-            acceptor.accept(*stream.rdbuf(), ec);
+                // Send the client's queue pair information to the server.
+                stream.write((char*) &_info, sizeof(T));
 
-            if (ec) {
-                throw std::runtime_error{"connect_queue_pairs server error"};
+                // Capture the server's queue pair information.
+                stream.read((char*) &_info, sizeof(T));
             }
 
-            std::cout << "connected!\n";
-            std::cout << "Exchanging QP information with client ... ";
-
-            // Capture the client's queue pair information.
-            queue_pair_info client_qp_info{};
-            stream.read((char*) &client_qp_info, sizeof(queue_pair_info));
-
-            // Send the server's queue pair information.
-            stream.write((char*) &_qp_info, sizeof(queue_pair_info));
-
-            // Copy the client's info into the out parameter.
-            _qp_info = client_qp_info;
+            std::cout << "done!\n";
         }
-        else {
-            std::cout << "Connecting to server ... ";
-            tcp::iostream stream{_host, _port};
-
-            if (!stream)
-                throw std::runtime_error{"connect_queue_pairs client error"};
 
-            std::cout << "connected!\n";
-            std::cout << "Exchanging QP information with server ... ";
-
-            // Send the client's queue pair information to the server.
-            stream.write((char*) &_qp_info, sizeof(queue_pair_info));
+        inline auto byte_swap(queue_pair_info& _qp_info, bool _to_network) -> void
+        {
+            _qp_info.qp_num = _to_network ? htonl(_qp_info.qp_num) : ntohl(_qp_info.qp_num);
+            _qp_info.rq_psn = _to_network ? htonl(_qp_info.rq_psn) : ntohl(_qp_info.rq_psn);
+            _qp_info.lid = _to_network ? htons(_qp_info.lid) : ntohs(_qp_info.lid);
+        }
 
-            // Capture the server's queue pair information.
-            stream.read((char*) &_qp_info, sizeof(queue_pair_info));
+        inline auto byte_swap(remote_memory_region& _mr_info, bool _to_network) -> void
+        {
+            _mr_info.address = _to_network ? htonll(_mr_info.address) : ntohll(_mr_info.address);
+            _mr_info.length = _to_network ? htonll(_mr_info.length) : ntohll(_mr_info.length);
+            _mr_info.remote_key = _to_network ? htonl(_mr_info.remote_key) : ntohl(_mr_info.remote_key);
         }
+    } // namespace detail
 
-        std::cout << "done!\n";
+    inline
+    auto exchange_queue_pair_info(const std::string& _host,
+                                  const std::string& _port,
+                                  queue_pair_info& _qp_info,
+                                  bool _is_server) -> void
+    {
+        detail::byte_swap(_qp_info, true);
+        detail::exchange_with_peer(_host, _port, _qp_info, _is_server);
+        detail::byte_swap(_qp_info, false);
+    }
 
-        _qp_info.qp_num = ntohl(_qp_info.qp_num);
-        _qp_info.lid = ntohs(_qp_info.lid);
+    // Exchanges the queue pair information and the descriptor of a memory region the
+    // peer may target with one-sided operations in a single round trip. On return,
+    // both out parameters hold the peer's information.
+    inline
+    auto exchange_queue_pair_info(const std::string& _host,
+                                  const std::string& _port,
+                                  queue_pair_info& _qp_info,
+                                  remote_memory_region& _mr_info,
+                                  bool _is_server) -> void
+    {
+        struct
+        {
+            queue_pair_info qp;
+            remote_memory_region mr;
+        } info{_qp_info, _mr_info};
+
+        detail::byte_swap(info.qp, true);
+        detail::byte_swap(info.mr, true);
+        detail::exchange_with_peer(_host, _port, info, _is_server);
+        detail::byte_swap(info.qp, false);
+        detail::byte_swap(info.mr, false);
+
+        _qp_info = info.qp;
+        _mr_info = info.mr;
     }
 
     inline auto sync_client_and_server(const std::string& _host,
@@ -341,9 +470,12 @@ namespace rdma
             std::cout << "-----------------------------\n";
         }
 
-        std::cout << "qp_num: " << _qpi.qp_num << '\n';
-        std::cout << "rq_psn: " << _qpi.rq_psn << '\n';
-        std::cout << "lid   : " << _qpi.lid << '\n';
+        std::cout << "qp_num            : " << _qpi.qp_num << '\n';
+        std::cout << "rq_psn            : " << _qpi.rq_psn << '\n';
+        std::cout << "lid               : " << _qpi.lid << '\n';
+        std::cout << "max rd atomic     : " << (int) _qpi.max_rd_atomic << '\n';
+        std::cout << "max dest rd atomic: " << (int) _qpi.max_dest_rd_atomic << '\n';
+        std::cout << "mtu               : " << to_string(static_cast<ibv_mtu>(_qpi.mtu)) << '\n';
 
         std::ostringstream ss;
         for (int i = 0; i < 8; ++i) {
@@ -354,7 +486,7 @@ namespace rdma
             if (i < 7)
                 ss << ':';
         }
-        std::cout << "gid   : " << ss.str() << '\n';
+        std::cout << "gid               : " << ss.str() << '\n';
     }
 } // namespace rdma
 
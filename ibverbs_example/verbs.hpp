@@ -2,11 +2,26 @@
 #define KDD_RDMA_VERBS_HPP
 
 #include "device_list.hpp"
+#include "device_selection.hpp"
 #include "context.hpp"
 #include "protection_domain.hpp"
 #include "completion_queue.hpp"
+#include "completion_vector.hpp"
+#include "work_request.hpp"
+#include "shared_receive_queue.hpp"
 #include "queue_pair.hpp"
 #include "memory_region.hpp"
+#include "registration_cache.hpp"
+#include "buffer_pool.hpp"
+#include "numa_memory.hpp"
+#include "huge_page_memory.hpp"
+#include "mapped_file.hpp"
+#include "atomics.hpp"
 #include "utility.hpp"
+#include "control_channel.hpp"
+#include "queue_pair_mesh.hpp"
+#include "engine.hpp"
+#include "flow_control.hpp"
+#include "asio_completion_channel.hpp"
 
 #endif // KDD_RDMA_VERBS_HPP
@@ -0,0 +1,76 @@
+#ifndef KDD_RDMA_WORK_REQUEST_HPP
+#define KDD_RDMA_WORK_REQUEST_HPP
+
+#include "memory_region.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+namespace rdma
+{
+    // Describes a single registered buffer to be posted as part of a batch of
+    // work requests. The buffer must lie within the memory region whose local key
+    // is stored in the descriptor.
+    struct buffer_descriptor
+    {
+        std::uint64_t wr_id;
+        void* address;
+        std::uint32_t length;
+        std::uint32_t local_key;
+    };
+
+    inline auto make_buffer_descriptor(const memory_region& _mr,
+                                       std::size_t _offset,
+                                       std::uint32_t _length,
+                                       std::uint64_t _wr_id = 0) -> buffer_descriptor
+    {
+        if (_offset + _length > _mr.memory_size())
+            throw std::out_of_range{"buffer descriptor exceeds memory region"};
+
+        return {_wr_id, static_cast<std::uint8_t*>(_mr.memory_address()) + _offset, _length, _mr.local_key()};
+    }
+
+    // One piece of a message that is gathered from (or scattered to) several
+    // registered buffers by a single work request.
+    struct buffer_segment
+    {
+        void* address;
+        std::uint32_t length;
+        std::uint32_t local_key;
+    };
+
+    inline auto make_buffer_segment(const memory_region& _mr,
+                                    std::size_t _offset,
+                                    std::uint32_t _length) -> buffer_segment
+    {
+        if (_offset + _length > _mr.memory_size())
+            throw std::out_of_range{"buffer segment exceeds memory region"};
+
+        return {static_cast<std::uint8_t*>(_mr.memory_address()) + _offset, _length, _mr.local_key()};
+    }
+
+    // Thrown when posting a list of work requests fails. All work requests before
+    // failed_index() were accepted by the device and will generate completions
+    // (if signaled). The work request at failed_index() and all that follow were
+    // not posted.
+    class post_error : public std::runtime_error
+    {
+    public:
+        post_error(const char* _msg, std::size_t _failed_index)
+            : std::runtime_error{_msg}
+            , failed_index_{_failed_index}
+        {
+        }
+
+        auto failed_index() const noexcept -> std::size_t
+        {
+            return failed_index_;
+        }
+
+    private:
+        std::size_t failed_index_;
+    }; // class post_error
+} // namespace rdma
+
+#endif // KDD_RDMA_WORK_REQUEST_HPP
@@ -2,7 +2,11 @@
 
 #include <boost/program_options.hpp>
 
+#include <chrono>
+#include <cstddef>
 #include <iostream>
+#include <string>
+#include <vector>
 
 namespace po = boost::program_options;
 
@@ -18,6 +22,7 @@ int main(int _argc, char* _argv[])
             ("server,s", po::bool_switch(), "Run application as a server.")
             ("host,h", po::value<std::string>(), "The host to connect to.")
             ("port,p", po::value<std::string>()->default_value("9090"), "The port to connect to.")
+            ("connections,c", po::value<std::size_t>()->default_value(1), "The number of concurrent connections the client opens.")
             ("help", po::bool_switch(), "Show this message.");
 
         po::variables_map vm;
@@ -42,18 +47,93 @@ int main(int _argc, char* _argv[])
     return 0;
 }
 
+// Opens --connections connections at once, reports how long it took to establish
+// all of them and closes them again. Run it against a server on a loopback rxe
+// device to stress the connection manager with many concurrent clients.
 int run_client(const po::variables_map& _vm)
 {
     const auto host = _vm["host"].as<std::string>();
     const auto port = _vm["port"].as<std::string>();
+    const auto connections = _vm["connections"].as<std::size_t>();
 
-    return 0;
+    verbs::connection_manager manager;
+
+    std::size_t established = 0;
+    std::size_t failed = 0;
+    std::size_t disconnected = 0;
+
+    manager.on_established([&](verbs::connection&) { ++established; });
+    manager.on_disconnected([&](verbs::connection&) { ++disconnected; });
+    manager.on_error([&](verbs::connection&, rdma_cm_event_type _event, int _status) {
+        std::cerr << "Connection failed: " << rdma_event_str(_event) << " (" << _status << ")\n";
+        ++failed;
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < connections; ++i)
+        manager.connect(host, port);
+
+    while (established + failed < connections)
+        manager.run_once(-1);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Established " << established << " of " << connections << " connections in "
+              << elapsed.count() << " s (" << established / elapsed.count() << " connections/s)\n";
+
+    // Each disconnect() results in a disconnected event on both sides.
+    std::vector<verbs::connection*> open;
+    manager.for_each([&](verbs::connection& _c) {
+        if (_c.established())
+            open.push_back(&_c);
+    });
+
+    for (auto* c : open)
+        c->disconnect();
+
+    while (disconnected < established)
+        manager.run_once(-1);
+
+    return failed == 0 ? 0 : 1;
 }
 
+// Accepts connections until killed and prints the number of established, active
+// and tracked connections whenever they change, at most once a second.
 int run_server(const po::variables_map& _vm)
 {
-    const auto port = _vm["port"].as<std::string>();
+    const auto port = std::stoi(_vm["port"].as<std::string>());
+
+    verbs::connection_manager manager;
+
+    std::size_t established = 0;
+    std::size_t disconnected = 0;
+
+    manager.on_established([&](verbs::connection&) { ++established; });
+    manager.on_disconnected([&](verbs::connection&) { ++disconnected; });
+    manager.on_error([](verbs::connection&, rdma_cm_event_type _event, int _status) {
+        std::cerr << "Connection failed: " << rdma_event_str(_event) << " (" << _status << ")\n";
+    });
+
+    manager.listen(nullptr, port, 1024);
+
+    std::cout << "Listening on port " << port << '\n';
+
+    std::size_t last_events = 0;
+    std::size_t last_tracked = 0;
+
+    // The manager keeps a connection until its identifier is destroyed, so a count
+    // that does not drop back after the clients disconnect is a leak.
+    while (manager.run_once(1000)) {
+        const auto tracked = manager.connection_count();
+
+        if (established + disconnected != last_events || tracked != last_tracked) {
+            std::cout << "Established " << established << " connections, " << established - disconnected << " active, "
+                      << tracked << " tracked\n";
+            last_events = established + disconnected;
+            last_tracked = tracked;
+        }
+    }
 
     return 0;
 }
-
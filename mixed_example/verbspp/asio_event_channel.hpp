@@ -0,0 +1,104 @@
+#ifndef VERBSPP_ASIO_EVENT_CHANNEL_HPP
+#define VERBSPP_ASIO_EVENT_CHANNEL_HPP
+
+#include "event_channel.hpp"
+
+#include <rdma/rdma_cma.h>
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <boost/asio.hpp>
+
+#include <utility>
+#include <stdexcept>
+
+namespace verbs
+{
+    // Delivers the communication events of an event_channel through a Boost.Asio
+    // io_context, so connection setup can share a thread with TCP sockets, timers and
+    // RDMA completions (see rdma::asio_completion_channel):
+    //
+    //   verbs::asio_event_channel events{io, channel};
+    //
+    //   events.async_get_event([&](const boost::system::error_code& _ec, rdma_cm_event* _e) {
+    //       // Process *_e, rdma_ack_cm_event(_e), then call async_get_event() again.
+    //   });
+    //
+    // The channel's descriptor is switched to non-blocking mode while it is wrapped and
+    // stays owned by the event_channel. The object must outlive the handlers of its
+    // pending operations (see cancel()).
+    class asio_event_channel
+    {
+    public:
+        asio_event_channel(boost::asio::io_context& _io, event_channel& _channel)
+            : channel_{&_channel}
+            , descriptor_{_io}
+            , fd_flags_{fcntl(_channel.fd(), F_GETFL)}
+        {
+            if (fd_flags_ < 0 || fcntl(_channel.fd(), F_SETFL, fd_flags_ | O_NONBLOCK) < 0)
+                throw std::runtime_error{"fcntl failed"};
+
+            descriptor_.assign(_channel.fd());
+        }
+
+        asio_event_channel(const asio_event_channel&) = delete;
+        asio_event_channel& operator=(const asio_event_channel&) = delete;
+
+        ~asio_event_channel()
+        {
+            // Deregisters the descriptor without closing it.
+            descriptor_.release();
+            fcntl(channel_->fd(), F_SETFL, fd_flags_);
+        }
+
+        // Calls _handler(error_code, event) from the io_context with the next event.
+        // The handler must acknowledge the event with rdma_ack_cm_event(). Destroying
+        // an identifier blocks until all of its events have been acknowledged.
+        template <typename Handler>
+        void async_get_event(Handler _handler)
+        {
+            descriptor_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                                   [this, h = std::move(_handler)](const boost::system::error_code& _ec) mutable {
+                                       on_readable(_ec, std::move(h));
+                                   });
+        }
+
+        // Completes pending operations with boost::asio::error::operation_aborted.
+        void cancel()
+        {
+            descriptor_.cancel();
+        }
+
+    private:
+        template <typename Handler>
+        void on_readable(const boost::system::error_code& _ec, Handler&& _handler)
+        {
+            if (_ec) {
+                _handler(_ec, nullptr);
+                return;
+            }
+
+            rdma_cm_event* e{};
+
+            if (rdma_get_cm_event(channel_->handle(), &e) == 0) {
+                _handler(boost::system::error_code{}, e);
+                return;
+            }
+
+            // Another reader may have taken the event.
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                async_get_event(std::move(_handler));
+                return;
+            }
+
+            _handler(boost::system::error_code{errno, boost::system::system_category()}, nullptr);
+        }
+
+        event_channel* channel_;
+        boost::asio::posix::stream_descriptor descriptor_;
+        int fd_flags_;
+    };
+} // namespace verbs
+
+#endif // VERBSPP_ASIO_EVENT_CHANNEL_HPP
@@ -1,14 +1,20 @@
 #ifndef VERBSPP_COMPLETION_QUEUE_HPP
 #define VERBSPP_COMPLETION_QUEUE_HPP
 
+#include <infiniband/verbs.h>
+
+#include <stdexcept>
+
 namespace verbs
 {
     class completion_queue
     {
     public:
-        completion_queue(const communication_identifier& _cm_id)
-            : cq_{ibv_create_cq(&_cm_id.context(), )}
+        completion_queue(ibv_context& _ctx, int _cqe)
+            : cq_{ibv_create_cq(&_ctx, _cqe, nullptr, nullptr, 0)}
         {
+            if (!cq_)
+                throw std::runtime_error{"ibv_create_cq failed"};
         }
 
         completion_queue(const completion_queue&) = delete;
@@ -20,6 +26,22 @@ namespace verbs
                 ibv_destroy_cq(cq_);
         }
 
+        ibv_cq* handle() const noexcept
+        {
+            return cq_;
+        }
+
+        // Non-blocking. Returns the number of completions written to _wcs.
+        int poll(ibv_wc* _wcs, int _max) const
+        {
+            const auto n = ibv_poll_cq(cq_, _max, _wcs);
+
+            if (n < 0)
+                throw std::runtime_error{"ibv_poll_cq failed"};
+
+            return n;
+        }
+
     private:
         ibv_cq* cq_;
     };
@@ -0,0 +1,578 @@
+#ifndef VERBSPP_CONNECTION_MANAGER_HPP
+#define VERBSPP_CONNECTION_MANAGER_HPP
+
+#include "event_channel.hpp"
+#include "communication_identifier.hpp"
+#include "completion_queue.hpp"
+
+#include <rdma/rdma_cma.h>
+#include <infiniband/verbs.h>
+
+#include <sys/eventfd.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdexcept>
+
+namespace verbs
+{
+    // The resources created for every connection.
+    struct connection_config
+    {
+        std::uint32_t buffer_size = 4096;
+        std::uint32_t send_buffers = 16;          // Also the send queue depth.
+        std::uint32_t recv_buffers = 16;          // All are posted before the connection is established.
+        std::uint8_t responder_resources = 1;     // Incoming RDMA READs/atomics served concurrently.
+        std::uint8_t initiator_depth = 1;         // Outgoing RDMA READs/atomics in flight.
+        int resolve_timeout_ms = 2000;            // Address and route resolution timeout of connect().
+    };
+
+    // An RC connection created by a connection_manager. It owns its communication
+    // identifier, queue pair, completion queue and a registered block of send and
+    // receive buffers. Receive buffer i is posted with work request id i. Send
+    // buffer i should be posted with work request id i as well.
+    class connection
+    {
+    public:
+        explicit connection(rdma_cm_id& _id)
+            : id_{&_id}
+            , cq_{}
+            , memory_{}
+            , mr_{}
+            , config_{}
+            , established_{}
+            , disconnecting_{}
+            , user_data_{}
+        {
+        }
+
+        connection(const connection&) = delete;
+        connection& operator=(const connection&) = delete;
+
+        ~connection()
+        {
+            release_queue_pair();
+
+            if (mr_)
+                ibv_dereg_mr(mr_);
+
+            cq_.reset();
+
+            if (id_)
+                rdma_destroy_id(id_);
+        }
+
+        rdma_cm_id* id() const noexcept
+        {
+            return id_;
+        }
+
+        ibv_qp* qp() const noexcept
+        {
+            return id_->qp;
+        }
+
+        const completion_queue& cq() const noexcept
+        {
+            return *cq_;
+        }
+
+        bool established() const noexcept
+        {
+            return established_;
+        }
+
+        std::uint8_t* recv_buffer(std::uint32_t _index) noexcept
+        {
+            return memory_.data() + static_cast<std::size_t>(_index) * config_.buffer_size;
+        }
+
+        std::uint8_t* send_buffer(std::uint32_t _index) noexcept
+        {
+            return recv_buffer(config_.recv_buffers + _index);
+        }
+
+        std::uint32_t buffer_size() const noexcept
+        {
+            return config_.buffer_size;
+        }
+
+        void post_receive(std::uint32_t _index)
+        {
+            if (_index >= config_.recv_buffers)
+                throw std::out_of_range{"invalid receive buffer index"};
+
+            ibv_sge sge{};
+            sge.addr = reinterpret_cast<std::uintptr_t>(recv_buffer(_index));
+            sge.length = config_.buffer_size;
+            sge.lkey = mr_->lkey;
+
+            ibv_recv_wr wr{};
+            wr.wr_id = _index;
+            wr.sg_list = &sge;
+            wr.num_sge = 1;
+
+            ibv_recv_wr* bad_wr{};
+
+            if (ibv_post_recv(id_->qp, &wr, &bad_wr))
+                throw std::runtime_error{"ibv_post_recv failed"};
+        }
+
+        void post_send(std::uint32_t _index, std::uint32_t _length)
+        {
+            if (_index >= config_.send_buffers || _length > config_.buffer_size)
+                throw std::out_of_range{"invalid send buffer index or length"};
+
+            ibv_sge sge{};
+            sge.addr = reinterpret_cast<std::uintptr_t>(send_buffer(_index));
+            sge.length = _length;
+            sge.lkey = mr_->lkey;
+
+            ibv_send_wr wr{};
+            wr.wr_id = _index;
+            wr.opcode = IBV_WR_SEND;
+            wr.sg_list = &sge;
+            wr.num_sge = 1;
+
+            ibv_send_wr* bad_wr{};
+
+            if (ibv_post_send(id_->qp, &wr, &bad_wr))
+                throw std::runtime_error{"ibv_post_send failed"};
+        }
+
+        // Starts tearing down the connection. Both sides receive a disconnected
+        // callback once the disconnect completes.
+        void disconnect()
+        {
+            if (const auto ec = rdma_disconnect(id_); ec)
+                throw std::runtime_error{"rdma_disconnect failed"};
+
+            disconnecting_ = true;
+        }
+
+        void* user_data() const noexcept
+        {
+            return user_data_;
+        }
+
+        void set_user_data(void* _user_data) noexcept
+        {
+            user_data_ = _user_data;
+        }
+
+    private:
+        friend class connection_manager;
+
+        // Creates the queue pair and buffers once the device of the connection is
+        // known, and posts every receive buffer.
+        void create_resources(ibv_pd& _pd, const connection_config& _config)
+        {
+            config_ = _config;
+
+            cq_ = std::make_unique<completion_queue>(*id_->verbs, static_cast<int>(_config.send_buffers + _config.recv_buffers));
+
+            memory_.resize(static_cast<std::size_t>(_config.send_buffers + _config.recv_buffers) * _config.buffer_size);
+            mr_ = ibv_reg_mr(&_pd, memory_.data(), memory_.size(), IBV_ACCESS_LOCAL_WRITE);
+
+            if (!mr_)
+                throw std::runtime_error{"ibv_reg_mr failed"};
+
+            ibv_qp_init_attr attrs{};
+            attrs.qp_type = IBV_QPT_RC;
+            attrs.sq_sig_all = 1;
+            attrs.send_cq = cq_->handle();
+            attrs.recv_cq = cq_->handle();
+            attrs.cap.max_send_wr = _config.send_buffers;
+            attrs.cap.max_recv_wr = _config.recv_buffers;
+            attrs.cap.max_send_sge = 1;
+            attrs.cap.max_recv_sge = 1;
+
+            if (const auto ec = rdma_create_qp(id_, &_pd, &attrs); ec)
+                throw std::runtime_error{"rdma_create_qp failed"};
+
+            for (std::uint32_t i = 0; i < _config.recv_buffers; ++i)
+                post_receive(i);
+        }
+
+        void release_queue_pair() noexcept
+        {
+            if (id_ && id_->qp)
+                rdma_destroy_qp(id_);
+        }
+
+        rdma_cm_id* id_;
+        std::unique_ptr<completion_queue> cq_;
+        std::vector<std::uint8_t> memory_;
+        ibv_mr* mr_;
+        connection_config config_;
+        bool established_;
+        bool disconnecting_; // disconnect() was called on this side.
+        void* user_data_;
+    };
+
+    using connection_handler = std::function<void(connection&)>;
+
+    // Called when a connection attempt fails. _event is the event that reported the
+    // failure (e.g. RDMA_CM_EVENT_REJECTED) and _status its status.
+    using connection_error_handler = std::function<void(connection&, rdma_cm_event_type _event, int _status)>;
+
+    // Accepts and initiates any number of RC connections concurrently. All work is
+    // driven by communication events from a single event channel, so no step of
+    // connection setup blocks on a peer.
+    //
+    //   CONNECT_REQUEST  - create the QP and buffers, post the receives, accept
+    //   ADDR_RESOLVED    - resolve the route (outgoing connections)
+    //   ROUTE_RESOLVED   - create the QP and buffers, post the receives, connect
+    //   ESTABLISHED      - established handler
+    //   DISCONNECTED     - disconnect (if the peer started it), disconnected handler,
+    //                      destroy the QP (and the connection on iWARP)
+    //   TIMEWAIT_EXIT    - destroy the connection
+    //   *_ERROR/REJECTED - error handler, destroy the connection
+    //
+    // Events are processed by run() or run_once(), and every handler runs on that
+    // thread. A connection is valid until its disconnected or error handler returns.
+    // Except for stop(), member functions must only be called from the thread
+    // processing events (e.g. from a handler) or while no thread is processing events.
+    class connection_manager
+    {
+    public:
+        explicit connection_manager(const connection_config& _config = {})
+            : channel_{}
+            , config_{_config}
+            , listener_{}
+            , connections_{}
+            , pds_{}
+            , wake_fd_{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+            , stopped_{false}
+        {
+            if (wake_fd_ < 0)
+                throw std::runtime_error{"eventfd failed"};
+
+            // Events are drained until the channel would block.
+            const auto flags = fcntl(channel_.fd(), F_GETFL);
+
+            if (flags < 0 || fcntl(channel_.fd(), F_SETFL, flags | O_NONBLOCK) < 0) {
+                close(wake_fd_);
+                throw std::runtime_error{"fcntl failed"};
+            }
+        }
+
+        connection_manager(const connection_manager&) = delete;
+        connection_manager& operator=(const connection_manager&) = delete;
+
+        ~connection_manager()
+        {
+            // Every identifier must be destroyed before the protection domains
+            // and the event channel they use.
+            connections_.clear();
+            listener_.reset();
+
+            for (auto& [_, pd] : pds_)
+                ibv_dealloc_pd(pd);
+
+            close(wake_fd_);
+        }
+
+        void on_established(connection_handler _handler)
+        {
+            on_established_ = std::move(_handler);
+        }
+
+        void on_disconnected(connection_handler _handler)
+        {
+            on_disconnected_ = std::move(_handler);
+        }
+
+        void on_error(connection_error_handler _handler)
+        {
+            on_error_ = std::move(_handler);
+        }
+
+        // Accepts connection requests on _port. Listens on all local addresses if
+        // _host is null.
+        void listen(const char* _host, int _port, int _backlog)
+        {
+            listener_ = std::make_unique<communication_identifier>(RDMA_PS_TCP, channel_);
+            listener_->listen(_host, _port, _backlog);
+        }
+
+        // Starts connecting to _host:_port and returns immediately. The established or
+        // error handler is called once the attempt completes.
+        connection& connect(const std::string& _host, const std::string& _port)
+        {
+            addrinfo hints{};
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+
+            addrinfo* res{};
+
+            if (const auto ec = getaddrinfo(_host.c_str(), _port.c_str(), &hints, &res); ec)
+                throw std::runtime_error{"getaddrinfo failed: " + std::string{gai_strerror(ec)}};
+
+            rdma_cm_id* id{};
+
+            if (const auto ec = rdma_create_id(channel_.handle(), &id, nullptr, RDMA_PS_TCP); ec) {
+                freeaddrinfo(res);
+                throw std::runtime_error{"rdma_create_id failed"};
+            }
+
+            auto& c = *connections_.emplace(id, std::make_unique<connection>(*id)).first->second;
+
+            const auto ec = rdma_resolve_addr(id, nullptr, res->ai_addr, config_.resolve_timeout_ms);
+            freeaddrinfo(res);
+
+            if (ec) {
+                connections_.erase(id);
+                throw std::runtime_error{"rdma_resolve_addr failed"};
+            }
+
+            return c;
+        }
+
+        // Processes events until stop() is called.
+        void run()
+        {
+            while (run_once(-1));
+        }
+
+        // Waits up to _timeout_ms milliseconds (forever if negative) for events and
+        // processes all pending ones. Returns false once stop() has been called.
+        bool run_once(int _timeout_ms)
+        {
+            if (stopped_.load(std::memory_order_acquire))
+                return false;
+
+            pollfd fds[2]{{channel_.fd(), POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+
+            if (poll(fds, 2, _timeout_ms) < 0 && errno != EINTR)
+                throw std::runtime_error{"poll failed"};
+
+            rdma_cm_event* e{};
+
+            while (rdma_get_cm_event(channel_.handle(), &e) == 0) {
+                // Acknowledge before processing, because destroying an identifier
+                // blocks until all of its events have been acknowledged.
+                const auto event = *e;
+                rdma_ack_cm_event(e);
+                process_event(event);
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                throw std::runtime_error{"rdma_get_cm_event failed"};
+
+            return !stopped_.load(std::memory_order_acquire);
+        }
+
+        // Makes run() return. May be called from any thread.
+        void stop()
+        {
+            stopped_.store(true, std::memory_order_release);
+
+            const std::uint64_t one = 1;
+            [[maybe_unused]] const auto n = write(wake_fd_, &one, sizeof(one));
+        }
+
+        // The number of connections, including ones still being set up and ones
+        // waiting for TIMEWAIT_EXIT.
+        std::size_t connection_count() const noexcept
+        {
+            return connections_.size();
+        }
+
+        // Calls _f with every connection, including ones that are not established.
+        template <typename F>
+        void for_each(F&& _f)
+        {
+            for (auto& [_, c] : connections_)
+                _f(*c);
+        }
+
+    private:
+        void process_event(const rdma_cm_event& _evt)
+        {
+            switch (_evt.event) {
+                case RDMA_CM_EVENT_CONNECT_REQUEST:
+                    accept(_evt);
+                    break;
+
+                case RDMA_CM_EVENT_ADDR_RESOLVED:
+                    if (const auto ec = rdma_resolve_route(_evt.id, config_.resolve_timeout_ms); ec)
+                        fail(_evt.id, _evt.event, ec);
+                    break;
+
+                case RDMA_CM_EVENT_ROUTE_RESOLVED:
+                    connect_resolved(_evt.id);
+                    break;
+
+                case RDMA_CM_EVENT_ESTABLISHED:
+                    if (auto* c = find(_evt.id); c) {
+                        c->established_ = true;
+
+                        if (on_established_)
+                            on_established_(*c);
+                    }
+                    break;
+
+                case RDMA_CM_EVENT_DISCONNECTED:
+                    if (auto* c = find(_evt.id); c) {
+                        // The peer disconnected. Answering with our own disconnect sends
+                        // the DREP, without which the identifier never reaches
+                        // TIMEWAIT_EXIT. EINVAL means the disconnect already happened.
+                        if (!c->disconnecting_) {
+                            c->disconnecting_ = true;
+
+                            if (rdma_disconnect(_evt.id) && errno != EINVAL) {
+                                fail(_evt.id, _evt.event, errno);
+                                break;
+                            }
+                        }
+
+                        if (c->established_ && on_disconnected_)
+                            on_disconnected_(*c);
+
+                        // The identifier lingers until TIMEWAIT_EXIT so that stale
+                        // packets of this connection cannot reach a new one. iWARP
+                        // never reports TIMEWAIT_EXIT, so its connections go right away.
+                        c->established_ = false;
+                        c->release_queue_pair();
+
+                        if (_evt.id->verbs && _evt.id->verbs->device->transport_type == IBV_TRANSPORT_IWARP)
+                            connections_.erase(_evt.id);
+                    }
+                    break;
+
+                case RDMA_CM_EVENT_TIMEWAIT_EXIT:
+                    connections_.erase(_evt.id);
+                    break;
+
+                case RDMA_CM_EVENT_ADDR_ERROR:
+                case RDMA_CM_EVENT_ROUTE_ERROR:
+                case RDMA_CM_EVENT_CONNECT_ERROR:
+                case RDMA_CM_EVENT_UNREACHABLE:
+                case RDMA_CM_EVENT_REJECTED:
+                case RDMA_CM_EVENT_DEVICE_REMOVAL:
+                    fail(_evt.id, _evt.event, _evt.status);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        void accept(const rdma_cm_event& _evt)
+        {
+            // Until it is stored in connections_, the new identifier must be destroyed
+            // by hand if anything fails.
+            std::unique_ptr<connection> c;
+
+            try {
+                c = std::make_unique<connection>(*_evt.id);
+                c->create_resources(protection_domain(*_evt.id->verbs), config_);
+
+                rdma_conn_param param{};
+                param.responder_resources = std::min(config_.responder_resources, _evt.param.conn.initiator_depth);
+                param.initiator_depth = std::min(config_.initiator_depth, _evt.param.conn.responder_resources);
+                param.rnr_retry_count = 7;
+
+                if (const auto ec = rdma_accept(_evt.id, &param); ec)
+                    throw std::runtime_error{"rdma_accept failed"};
+            }
+            catch (const std::exception&) {
+                rdma_reject(_evt.id, nullptr, 0);
+
+                if (!c)
+                    rdma_destroy_id(_evt.id);
+
+                return;
+            }
+
+            connections_.emplace(_evt.id, std::move(c));
+        }
+
+        void connect_resolved(rdma_cm_id* _id)
+        {
+            auto* c = find(_id);
+
+            if (!c)
+                return;
+
+            try {
+                c->create_resources(protection_domain(*_id->verbs), config_);
+            }
+            catch (const std::exception&) {
+                fail(_id, RDMA_CM_EVENT_ROUTE_RESOLVED, -1);
+                return;
+            }
+
+            rdma_conn_param param{};
+            param.responder_resources = config_.responder_resources;
+            param.initiator_depth = config_.initiator_depth;
+            param.retry_count = 7;
+            param.rnr_retry_count = 7;
+
+            if (const auto ec = rdma_connect(_id, &param); ec)
+                fail(_id, RDMA_CM_EVENT_ROUTE_RESOLVED, ec);
+        }
+
+        void fail(rdma_cm_id* _id, rdma_cm_event_type _event, int _status)
+        {
+            auto* c = find(_id);
+
+            if (!c)
+                return;
+
+            if (on_error_)
+                on_error_(*c, _event, _status);
+
+            connections_.erase(_id);
+        }
+
+        connection* find(rdma_cm_id* _id)
+        {
+            const auto iter = connections_.find(_id);
+            return iter != std::end(connections_) ? iter->second.get() : nullptr;
+        }
+
+        // Connections on the same device share a protection domain.
+        ibv_pd& protection_domain(ibv_context& _ctx)
+        {
+            auto& pd = pds_[&_ctx];
+
+            if (!pd) {
+                pd = ibv_alloc_pd(&_ctx);
+
+                if (!pd) {
+                    pds_.erase(&_ctx);
+                    throw std::runtime_error{"ibv_alloc_pd failed"};
+                }
+            }
+
+            return *pd;
+        }
+
+        event_channel channel_;
+        connection_config config_;
+        std::unique_ptr<communication_identifier> listener_;
+        std::unordered_map<rdma_cm_id*, std::unique_ptr<connection>> connections_;
+        std::unordered_map<ibv_context*, ibv_pd*> pds_;
+        int wake_fd_;
+        std::atomic<bool> stopped_;
+        connection_handler on_established_;
+        connection_handler on_disconnected_;
+        connection_error_handler on_error_;
+    };
+} // namespace verbs
+
+#endif // VERBSPP_CONNECTION_MANAGER_HPP
@@ -14,11 +14,11 @@ namespace verbs
             : ch_{rdma_create_event_channel()}
         {
             if (!ch_)
-                throw std::runtime_error{""};
+                throw std::runtime_error{"rdma_create_event_channel failed"};
         }
 
         event_channel(const event_channel&) = delete;
-        event_channel operator=(const event_channel&) = delete;
+        event_channel& operator=(const event_channel&) = delete;
 
         ~event_channel()
         {
@@ -26,6 +26,17 @@ namespace verbs
                 rdma_destroy_event_channel(ch_);
         }
 
+        rdma_event_channel* handle() const noexcept
+        {
+            return ch_;
+        }
+
+        // The channel becomes readable when a communication event is pending.
+        int fd() const noexcept
+        {
+            return ch_->fd;
+        }
+
     private:
         rdma_event_channel* ch_;
     };
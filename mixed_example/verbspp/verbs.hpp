@@ -3,5 +3,8 @@
 
 #include "event_channel.hpp"
 #include "communication_identifier.hpp"
+#include "completion_queue.hpp"
+#include "connection_manager.hpp"
+#include "asio_event_channel.hpp"
 
 #endif // VERBSPP_VERBS_HPP
@@ -4,31 +4,25 @@
 //
 
 #include "rdma_cpp.hpp"
+#include "framing.hpp"
 
+#include <cstdint>
 #include <cstring>
 #include <iostream>
-#include <iomanip>
 #include <string>
 #include <vector>
-#include <sstream>
 #include <exception>
-#include <iterator>
+#include <stdexcept>
 
-constexpr auto header_length = 10;
-
-auto encode_message(const std::string& _msg) -> std::string
-{
-    std::ostringstream ss;
-    ss << std::left << std::setfill(' ') << std::setw(header_length) << _msg.size();
-    return ss.str() + _msg;
-}
+constexpr std::uint16_t text_message = 1;
+constexpr std::uint32_t max_message_size = 100;
 
 auto main(int _argc, char* _argv[]) -> int
 {
     if (_argc != 4) {
         std::cerr << "Invalid argument count.\n"
 		     "Usage: rdma_client <host> <port> <message>\n"
-		     "  <message> must be less than 100 bytes in size.\n";
+		     "  <message> must be at most 100 bytes in size.\n";
 	return 1;
     }
 
@@ -40,14 +34,25 @@ auto main(int _argc, char* _argv[]) -> int
         rdma::address_info addr_info{host, port, rdma::app_type::client};
         rdma::communication_manager comm_mgr{addr_info};
 
-	// We can avoid this copy with a little extra work.
-        std::vector<std::uint8_t> buffer(header_length + msg.size());
-	const auto m = encode_message(msg);
-	std::copy(std::begin(m), std::end(m), std::begin(buffer));
-        rdma::memory_region mem_region{comm_mgr, buffer.data(), buffer.size()};
+        if (msg.size() > max_message_size)
+            throw std::invalid_argument{"message exceeds 100 bytes."};
+
+        // Only the frame header is encoded into a buffer of its own. The header and
+        // the message are sent as two segments of a single send, so the message is
+        // never copied.
+        std::vector<std::uint8_t> header(rdma::frame_header_size);
+        rdma::encode_frame_header({static_cast<std::uint32_t>(msg.size()), text_message, 0, 0}, header.data());
+        rdma::memory_region header_region{comm_mgr, header.data(), header.size()};
 
         auto qp = comm_mgr.connect();
-        qp.post_send(buffer.data(), buffer.size(), mem_region);
+
+        if (msg.empty()) {
+            qp.post_send({header_region.segment(0, header.size())});
+        }
+        else {
+            rdma::memory_region msg_region{comm_mgr, reinterpret_cast<const std::uint8_t*>(msg.data()), msg.size()};
+            qp.post_send({header_region.segment(0, header.size()), msg_region.segment(0, static_cast<std::uint32_t>(msg.size()))});
+        }
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << '\n';
@@ -13,3 +13,10 @@ g++ -std=c++17 -Wall -Wextra -o rdma_server server.cpp \
 	-L/home/kory/dev/rdma-core/build/lib \
 	-lrdmacm \
 	-libverbs
+
+# Framing benchmark (no RDMA device required)
+g++ -std=c++17 -O2 -Wall -Wextra -o rdma_framing_benchmark framing_benchmark.cpp
+
+# Decoder fuzz driver (no RDMA device required). Run e.g. ./rdma_framing_fuzz 100000
+g++ -std=c++17 -O1 -g -Wall -Wextra -fsanitize=address,undefined -fno-sanitize-recover=all \
+	-o rdma_framing_fuzz framing_fuzz.cpp
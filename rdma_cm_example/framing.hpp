@@ -0,0 +1,273 @@
+#ifndef KDD_RDMA_FRAMING_HPP
+#define KDD_RDMA_FRAMING_HPP
+
+#include <endian.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+// A binary message framing layer. Every frame is a fixed 16 byte header followed
+// by the payload. All header fields are little-endian:
+//
+//   offset  size  field
+//        0     4  length    payload size in bytes
+//        4     2  type      application defined
+//        6     2  flags     application defined
+//        8     8  sequence  0 for the first frame of a stream, +1 per frame
+//
+// Frames are written in place into a buffer that is already registered for
+// sending, and decoded straight out of the receive buffers, so neither side
+// formats strings or copies messages on the data path.
+
+namespace rdma
+{
+    constexpr std::size_t frame_header_size = 16;
+
+    struct frame_header
+    {
+        std::uint32_t length;
+        std::uint16_t type;
+        std::uint16_t flags;
+        std::uint64_t sequence;
+    };
+
+    class framing_error : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    inline auto encode_frame_header(const frame_header& _header, std::uint8_t* _out) noexcept -> void
+    {
+        const auto length = htole32(_header.length);
+        const auto type = htole16(_header.type);
+        const auto flags = htole16(_header.flags);
+        const auto sequence = htole64(_header.sequence);
+
+        std::memcpy(_out, &length, sizeof(length));
+        std::memcpy(_out + 4, &type, sizeof(type));
+        std::memcpy(_out + 6, &flags, sizeof(flags));
+        std::memcpy(_out + 8, &sequence, sizeof(sequence));
+    }
+
+    inline auto decode_frame_header(const std::uint8_t* _in) noexcept -> frame_header
+    {
+        frame_header header;
+
+        std::memcpy(&header.length, _in, sizeof(header.length));
+        std::memcpy(&header.type, _in + 4, sizeof(header.type));
+        std::memcpy(&header.flags, _in + 6, sizeof(header.flags));
+        std::memcpy(&header.sequence, _in + 8, sizeof(header.sequence));
+
+        header.length = le32toh(header.length);
+        header.type = le16toh(header.type);
+        header.flags = le16toh(header.flags);
+        header.sequence = le64toh(header.sequence);
+
+        return header;
+    }
+
+    // Appends frames to a caller owned buffer, typically one registered with
+    // memory_region, and numbers them. Send size() bytes starting at the beginning
+    // of the buffer, then call reset() to reuse it.
+    class frame_writer
+    {
+    public:
+        frame_writer(std::uint8_t* _buffer, std::size_t _capacity)
+            : buffer_{_buffer}
+            , capacity_{_capacity}
+            , size_{}
+            , sequence_{}
+        {
+        }
+
+        // Writes the header of a frame with a payload of _length bytes and returns
+        // where the payload must be written, or nullptr if the frame does not fit.
+        auto begin_frame(std::uint16_t _type, std::uint32_t _length, std::uint16_t _flags = 0) noexcept -> std::uint8_t*
+        {
+            if (capacity_ - size_ < frame_header_size || capacity_ - size_ - frame_header_size < _length)
+                return nullptr;
+
+            auto* frame = buffer_ + size_;
+            encode_frame_header({_length, _type, _flags, sequence_++}, frame);
+            size_ += frame_header_size + _length;
+
+            return frame + frame_header_size;
+        }
+
+        // Writes a complete frame. Returns false if it does not fit.
+        auto write_frame(std::uint16_t _type, const void* _payload, std::uint32_t _length, std::uint16_t _flags = 0) noexcept -> bool
+        {
+            auto* payload = begin_frame(_type, _length, _flags);
+
+            if (!payload)
+                return false;
+
+            // _payload may be null for an empty frame, which memcpy does not allow.
+            if (_length > 0)
+                std::memcpy(payload, _payload, _length);
+
+            return true;
+        }
+
+        // The number of bytes written since the last reset().
+        auto size() const noexcept -> std::size_t
+        {
+            return size_;
+        }
+
+        // Starts over at the beginning of the buffer. Sequence numbers continue.
+        auto reset() noexcept -> void
+        {
+            size_ = 0;
+        }
+
+    private:
+        std::uint8_t* buffer_;
+        std::size_t capacity_;
+        std::size_t size_;
+        std::uint64_t sequence_;
+    }; // class frame_writer
+
+    // Splits a byte stream back into frames. The bytes may arrive in chunks of any
+    // size, e.g. one receive completion at a time. A frame that lies entirely within
+    // a chunk is handed out in place. Only a frame split across chunks is
+    // reassembled in a staging buffer, which is allocated once at construction, so
+    // decoding never allocates.
+    //
+    // A frame larger than _max_payload or out of sequence means the stream is
+    // corrupt. feed() then throws a framing_error and the decoder must be reset()
+    // together with the connection.
+    class frame_decoder
+    {
+    public:
+        explicit frame_decoder(std::uint32_t _max_payload)
+            : max_payload_{_max_payload}
+            , staging_(frame_header_size + _max_payload)
+            , staged_{}
+            , expected_sequence_{}
+        {
+        }
+
+        // Decodes _data and calls _on_frame(const frame_header&, const std::uint8_t*
+        // payload) for every frame it completes. The payload pointer is only valid
+        // during the call. Returns the number of frames decoded.
+        template <typename OnFrame>
+        auto feed(const std::uint8_t* _data, std::size_t _size, OnFrame&& _on_frame) -> std::size_t
+        {
+            std::size_t frames = 0;
+
+            // Finish the frame started by a previous chunk.
+            if (staged_ > 0) {
+                const auto consumed = stage(_data, _size);
+                _data += consumed;
+                _size -= consumed;
+
+                if (staged_ < frame_header_size)
+                    return frames;
+
+                const auto header = decode_frame_header(staging_.data());
+
+                if (staged_ < frame_header_size + header.length)
+                    return frames;
+
+                staged_ = 0;
+                deliver(header, staging_.data() + frame_header_size, _on_frame);
+                ++frames;
+            }
+
+            while (_size >= frame_header_size) {
+                const auto header = decode_frame_header(_data);
+                check(header);
+
+                if (_size - frame_header_size < header.length)
+                    break;
+
+                deliver(header, _data + frame_header_size, _on_frame);
+                ++frames;
+
+                _data += frame_header_size + header.length;
+                _size -= frame_header_size + header.length;
+            }
+
+            // Keep the beginning of the next frame.
+            stage(_data, _size);
+
+            return frames;
+        }
+
+        // The number of bytes of an incomplete frame held back for the next chunk.
+        auto buffered() const noexcept -> std::size_t
+        {
+            return staged_;
+        }
+
+        auto reset() noexcept -> void
+        {
+            staged_ = 0;
+            expected_sequence_ = 0;
+        }
+
+    private:
+        // Appends as much of _data to the staging buffer as the current frame needs
+        // and returns the number of bytes consumed.
+        auto stage(const std::uint8_t* _data, std::size_t _size) -> std::size_t
+        {
+            if (_size == 0)
+                return 0;
+
+            std::size_t consumed = 0;
+
+            // The header first, since it determines how much payload belongs to the frame.
+            if (staged_ < frame_header_size) {
+                const auto n = std::min(_size, frame_header_size - staged_);
+                std::memcpy(staging_.data() + staged_, _data, n);
+                staged_ += n;
+                consumed += n;
+
+                if (staged_ < frame_header_size)
+                    return consumed;
+
+                check(decode_frame_header(staging_.data()));
+            }
+
+            const auto frame_size = frame_header_size + decode_frame_header(staging_.data()).length;
+            const auto n = std::min(_size - consumed, frame_size - staged_);
+            std::memcpy(staging_.data() + staged_, _data + consumed, n);
+            staged_ += n;
+
+            return consumed + n;
+        }
+
+        auto check(const frame_header& _header) -> void
+        {
+            if (_header.length > max_payload_) {
+                reset();
+                throw framing_error{"frame_decoder frame exceeds the maximum payload size."};
+            }
+
+            if (_header.sequence != expected_sequence_) {
+                reset();
+                throw framing_error{"frame_decoder frame out of sequence."};
+            }
+        }
+
+        template <typename OnFrame>
+        auto deliver(const frame_header& _header, const std::uint8_t* _payload, OnFrame& _on_frame) -> void
+        {
+            ++expected_sequence_;
+            _on_frame(_header, _payload);
+        }
+
+        std::uint32_t max_payload_;
+        std::vector<std::uint8_t> staging_;
+        std::size_t staged_;
+        std::uint64_t expected_sequence_;
+    }; // class frame_decoder
+} // namespace rdma
+
+#endif // KDD_RDMA_FRAMING_HPP
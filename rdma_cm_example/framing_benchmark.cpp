@@ -0,0 +1,149 @@
+// Measures how many messages per second can be framed and unframed, without any
+// RDMA traffic, comparing the binary framing layer against the text header the
+// client used before: the length as a space padded, 10 character decimal written
+// through std::ostringstream, with header and message copied into a new vector.
+//
+// The "chunked" rows feed the decoder the encoded stream in chunks of random size,
+// so most frames are split across chunks and have to be reassembled.
+
+#include "framing.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+namespace
+{
+    constexpr auto text_header_length = 10;
+
+    auto encode_text_message(const std::string& _msg) -> std::vector<std::uint8_t>
+    {
+        std::ostringstream ss;
+        ss << std::left << std::setfill(' ') << std::setw(text_header_length) << _msg.size();
+        const auto header = ss.str();
+
+        std::vector<std::uint8_t> message(header.begin(), header.end());
+        message.insert(message.end(), _msg.begin(), _msg.end());
+
+        return message;
+    }
+
+    auto decode_text_message(const std::vector<std::uint8_t>& _message) -> std::string
+    {
+        const std::string header{(const char*) _message.data(), text_header_length};
+        const auto length = std::stoul(header);
+
+        return {(const char*) _message.data() + text_header_length, length};
+    }
+
+    auto print_row(const char* _mode, std::size_t _message_size, std::size_t _messages, double _seconds) -> void
+    {
+        std::cout << "framing," << _mode << ',' << _message_size << ',' << _messages << ','
+                  << _seconds << ',' << _messages / _seconds << '\n';
+    }
+} // anonymous namespace
+
+auto main(int _argc, char* _argv[]) -> int
+{
+    if (_argc != 3) {
+        std::cerr << "Invalid argument count.\n"
+                     "Usage: rdma_framing_benchmark <messages> <message size>\n";
+        return 1;
+    }
+
+    try {
+        const auto messages = std::stoul(_argv[1]);
+        const auto message_size = static_cast<std::uint32_t>(std::stoul(_argv[2]));
+        const std::string msg(message_size, 'm');
+
+        std::cout << "test,mode,message_size,messages,seconds,messages_per_second\n";
+
+        std::size_t checksum = 0;
+
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            for (std::size_t i = 0; i < messages; ++i)
+                checksum += decode_text_message(encode_text_message(msg)).size();
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            print_row("text", message_size, messages, elapsed.count());
+        }
+
+        // A send buffer holding one frame, reused for every message like a registered
+        // send buffer would be.
+        std::vector<std::uint8_t> buffer(rdma::frame_header_size + message_size);
+
+        {
+            rdma::frame_writer writer{buffer.data(), buffer.size()};
+            rdma::frame_decoder decoder{message_size};
+
+            const auto start = std::chrono::steady_clock::now();
+
+            for (std::size_t i = 0; i < messages; ++i) {
+                writer.reset();
+                writer.write_frame(1, msg.data(), message_size);
+
+                decoder.feed(buffer.data(), writer.size(), [&checksum](const rdma::frame_header& _header, const std::uint8_t*) {
+                    checksum += _header.length;
+                });
+            }
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            print_row("binary", message_size, messages, elapsed.count());
+        }
+
+        {
+            // Encode the whole stream up front, then time the decoding only.
+            std::vector<std::uint8_t> stream(messages * buffer.size());
+            rdma::frame_writer writer{stream.data(), stream.size()};
+
+            for (std::size_t i = 0; i < messages; ++i)
+                writer.write_frame(1, msg.data(), message_size);
+
+            std::mt19937 gen{42};
+            std::uniform_int_distribution<std::size_t> chunk_size{1, 2 * buffer.size()};
+            std::vector<std::size_t> chunks;
+
+            for (std::size_t offset = 0; offset < stream.size(); offset += chunks.back())
+                chunks.push_back(std::min(chunk_size(gen), stream.size() - offset));
+
+            rdma::frame_decoder decoder{message_size};
+            std::size_t decoded = 0;
+            std::size_t offset = 0;
+
+            const auto start = std::chrono::steady_clock::now();
+
+            for (const auto n : chunks) {
+                decoded += decoder.feed(stream.data() + offset, n, [](const rdma::frame_header&, const std::uint8_t*) {});
+                offset += n;
+            }
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (decoded != messages || decoder.buffered() != 0)
+                throw std::runtime_error{"chunked decoding lost frames."};
+
+            print_row("binary_chunked", message_size, messages, elapsed.count());
+        }
+
+        // Keeps the compiler from optimizing the loops away.
+        if (checksum == 0 && messages > 0 && message_size > 0)
+            std::cerr << "Unexpected checksum.\n";
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
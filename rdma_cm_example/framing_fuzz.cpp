@@ -0,0 +1,260 @@
+// A randomized test driver for frame_decoder, the piece that parses untrusted input.
+// Every iteration encodes a random stream of frames, optionally corrupts it, and
+// feeds it to the decoder in chunks of random size (including empty chunks and
+// chunks splitting headers). Each chunk is copied into a buffer of exactly its
+// size and every payload handed out is read in full, so building with
+// -fsanitize=address,undefined (see compile.sh) catches any read out of bounds.
+//
+// Checks:
+//   - An intact stream decodes to exactly the frames that were encoded.
+//   - A frame longer than the maximum payload throws framing_error, after exactly
+//     the frames preceding it have been delivered.
+//   - A frame out of sequence throws framing_error in the same way.
+//   - Random corruption either decodes or throws framing_error. Delivered frames
+//     never exceed the maximum payload and are numbered consecutively.
+//   - After reset(), the decoder decodes a fresh stream again.
+
+#include "framing.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+namespace
+{
+    struct test_frame
+    {
+        std::uint16_t type;
+        std::uint16_t flags;
+        std::vector<std::uint8_t> payload;
+    };
+
+    enum class corruption
+    {
+        none,
+        oversize,
+        sequence,
+        garbage
+    };
+
+    auto require(bool _condition, const char* _what) -> void
+    {
+        if (!_condition)
+            throw std::logic_error{_what};
+    }
+
+    auto make_frames(std::mt19937& _gen, std::uint32_t _max_payload) -> std::vector<test_frame>
+    {
+        std::uniform_int_distribution<std::size_t> count{1, 32};
+        std::uniform_int_distribution<std::uint32_t> length{0, _max_payload};
+        std::uniform_int_distribution<unsigned> byte{0, 255};
+
+        std::vector<test_frame> frames(count(_gen));
+
+        for (auto& f : frames) {
+            f.type = static_cast<std::uint16_t>(byte(_gen));
+            f.flags = static_cast<std::uint16_t>(byte(_gen));
+            f.payload.resize(length(_gen));
+
+            for (auto& b : f.payload)
+                b = static_cast<std::uint8_t>(byte(_gen));
+        }
+
+        return frames;
+    }
+
+    // Returns the encoded stream and the offset of every frame in it.
+    auto encode(const std::vector<test_frame>& _frames, std::vector<std::size_t>& _offsets) -> std::vector<std::uint8_t>
+    {
+        std::size_t size = 0;
+
+        for (const auto& f : _frames)
+            size += rdma::frame_header_size + f.payload.size();
+
+        std::vector<std::uint8_t> stream(size);
+        rdma::frame_writer writer{stream.data(), stream.size()};
+
+        _offsets.clear();
+
+        for (const auto& f : _frames) {
+            _offsets.push_back(writer.size());
+            require(writer.write_frame(f.type, f.payload.data(), static_cast<std::uint32_t>(f.payload.size()), f.flags),
+                    "frame_writer rejected a frame that fits.");
+        }
+
+        return stream;
+    }
+
+    // Feeds _stream to _decoder in random chunks and checks every frame delivered
+    // against _expected (unless it is garbage). Returns the number of frames delivered.
+    // framing_error propagates to the caller.
+    auto feed_chunked(std::mt19937& _gen,
+                      rdma::frame_decoder& _decoder,
+                      const std::vector<std::uint8_t>& _stream,
+                      const std::vector<test_frame>& _expected,
+                      std::uint32_t _max_payload,
+                      bool _garbage,
+                      std::size_t& _delivered) -> void
+    {
+        std::uniform_int_distribution<std::size_t> chunk_size{0, 2 * (rdma::frame_header_size + _max_payload) + 1};
+
+        const auto on_frame = [&](const rdma::frame_header& _header, const std::uint8_t* _payload) {
+            require(_header.length <= _max_payload, "decoder delivered a frame above the maximum payload.");
+            require(_header.sequence == _delivered, "decoder delivered a frame out of sequence.");
+
+            // Reading every byte lets the sanitizers catch payloads that point out of bounds.
+            std::vector<std::uint8_t> payload(_payload, _payload + _header.length);
+
+            if (!_garbage) {
+                require(_delivered < _expected.size(), "decoder delivered more frames than were encoded.");
+
+                const auto& f = _expected[_delivered];
+                require(_header.type == f.type && _header.flags == f.flags, "decoded header does not match.");
+                require(payload == f.payload, "decoded payload does not match.");
+            }
+
+            ++_delivered;
+        };
+
+        for (std::size_t offset = 0; offset < _stream.size();) {
+            const auto n = std::min(chunk_size(_gen), _stream.size() - offset);
+
+            // An exactly sized copy, so reads past the chunk are out of bounds.
+            const std::vector<std::uint8_t> chunk(_stream.begin() + offset, _stream.begin() + offset + n);
+            _decoder.feed(chunk.data(), chunk.size(), on_frame);
+
+            offset += n;
+        }
+    }
+
+    auto write_u32(std::uint8_t* _out, std::uint32_t _value) -> void
+    {
+        const auto le = htole32(_value);
+        std::memcpy(_out, &le, sizeof(le));
+    }
+
+    auto write_u64(std::uint8_t* _out, std::uint64_t _value) -> void
+    {
+        const auto le = htole64(_value);
+        std::memcpy(_out, &le, sizeof(le));
+    }
+} // anonymous namespace
+
+auto main(int _argc, char* _argv[]) -> int
+{
+    if (_argc != 2 && _argc != 3) {
+        std::cerr << "Invalid argument count.\n"
+                     "Usage: rdma_framing_fuzz <iterations> [seed]\n";
+        return 1;
+    }
+
+    try {
+        const auto iterations = std::stoul(_argv[1]);
+        const auto seed = _argc == 3 ? static_cast<std::uint32_t>(std::stoul(_argv[2])) : std::random_device{}();
+
+        std::mt19937 gen{seed};
+        std::uniform_int_distribution<std::uint32_t> max_payload_dist{0, 300};
+        std::uniform_int_distribution<int> corruption_dist{0, 3};
+
+        std::size_t frames_decoded = 0;
+        std::size_t errors_detected = 0;
+
+        for (std::size_t i = 0; i < iterations; ++i) {
+            const auto max_payload = max_payload_dist(gen);
+            const auto frames = make_frames(gen, max_payload);
+
+            std::vector<std::size_t> offsets;
+            auto stream = encode(frames, offsets);
+
+            const auto mode = static_cast<corruption>(corruption_dist(gen));
+            const auto target = std::uniform_int_distribution<std::size_t>{0, frames.size() - 1}(gen);
+
+            switch (mode) {
+                case corruption::none:
+                    break;
+
+                case corruption::oversize: {
+                    const auto excess = std::uniform_int_distribution<std::uint32_t>{1, 0xffff'ffffu - max_payload}(gen);
+                    write_u32(stream.data() + offsets[target], max_payload + excess);
+                    break;
+                }
+
+                case corruption::sequence: {
+                    const auto shift = std::uniform_int_distribution<std::uint64_t>{1, ~std::uint64_t{0}}(gen);
+                    write_u64(stream.data() + offsets[target] + 8, target + shift);
+                    break;
+                }
+
+                case corruption::garbage: {
+                    std::uniform_int_distribution<std::size_t> position{0, stream.size() - 1};
+                    std::uniform_int_distribution<unsigned> byte{0, 255};
+
+                    for (int j = 0; j < 8; ++j)
+                        stream[position(gen)] = static_cast<std::uint8_t>(byte(gen));
+
+                    break;
+                }
+            }
+
+            rdma::frame_decoder decoder{max_payload};
+            std::size_t delivered = 0;
+            bool threw = false;
+
+            try {
+                feed_chunked(gen, decoder, stream, frames, max_payload, mode == corruption::garbage, delivered);
+            }
+            catch (const rdma::framing_error&) {
+                threw = true;
+                ++errors_detected;
+            }
+
+            switch (mode) {
+                case corruption::none:
+                    require(!threw, "intact stream threw framing_error.");
+                    require(delivered == frames.size(), "intact stream lost frames.");
+                    require(decoder.buffered() == 0, "intact stream left bytes buffered.");
+                    break;
+
+                case corruption::oversize:
+                    require(threw, "oversize frame was not rejected.");
+                    require(delivered == target, "oversize frame was not rejected at the right frame.");
+                    break;
+
+                case corruption::sequence:
+                    require(threw, "out of sequence frame was not rejected.");
+                    require(delivered == target, "out of sequence frame was not rejected at the right frame.");
+                    break;
+
+                case corruption::garbage:
+                    break;
+            }
+
+            frames_decoded += delivered;
+
+            // The decoder must recover completely after reset().
+            decoder.reset();
+            std::size_t redelivered = 0;
+            const auto fresh = make_frames(gen, max_payload);
+            feed_chunked(gen, decoder, encode(fresh, offsets), fresh, max_payload, false, redelivered);
+
+            require(redelivered == fresh.size() && decoder.buffered() == 0, "decoder did not recover after reset().");
+            frames_decoded += redelivered;
+        }
+
+        std::cout << "test,seed,iterations,frames_decoded,errors_detected\n"
+                  << "framing_fuzz," << seed << ',' << iterations << ',' << frames_decoded << ',' << errors_detected << '\n';
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -6,6 +6,8 @@
 #include <rdma/rdma_cma.h>
 #include <rdma/rdma_verbs.h>
 
+#include <cstdint>
+#include <vector>
 #include <stdexcept>
 
 namespace rdma
@@ -67,6 +69,10 @@ namespace rdma
 
         operator ibv_mr*() const noexcept;
 
+        // Describes _length bytes at _offset within the region, e.g. as one
+        // piece of a message passed to queue_pair::post_send.
+        auto segment(std::uint64_t _offset, std::uint32_t _length) const -> ibv_sge;
+
     private:
         ibv_mr* mr_;
     }; // class memory_region
@@ -76,7 +82,17 @@ namespace rdma
     public:
         explicit queue_pair(rdma_cm_id& _comm_id)
             : comm_id_{_comm_id}
+            , max_send_sge_{}
         {
+            ibv_qp_attr attrs{};
+            ibv_qp_init_attr init_attrs{};
+
+            if (ibv_query_qp(_comm_id.qp, &attrs, IBV_QP_CAP, &init_attrs)) {
+                perror("ibv_query_qp");
+                throw std::runtime_error{"queue_pair construction error."};
+            }
+
+            max_send_sge_ = init_attrs.cap.max_send_sge;
         }
 
         auto post_send(std::uint8_t* _buffer,
@@ -91,8 +107,41 @@ namespace rdma
                 throw std::runtime_error{"queue_pair::post_send completion error."};
 	    }
 
-            // Wait for send to complete.
+            wait_for_send_completion();
+        }
+
+        // Sends one message gathered from the segments in order (see
+        // memory_region::segment), so a header and a payload from different buffers
+        // do not have to be copied together first. The number of segments must not
+        // exceed the QP's max_send_sge capability.
+        auto post_send(const std::vector<ibv_sge>& _segments) -> void
+        {
+            if (_segments.empty())
+                throw std::invalid_argument{"queue_pair::post_send needs at least one segment."};
+
+            if (_segments.size() > max_send_sge_)
+                throw std::invalid_argument{"queue_pair::post_send segment count exceeds max_send_sge."};
+
+	    const int send_flags = 0;
+            auto ec = rdma_post_sendv(&comm_id_,
+                                      nullptr,
+                                      const_cast<ibv_sge*>(_segments.data()),
+                                      static_cast<int>(_segments.size()),
+                                      send_flags);
+
+            if (ec) {
+		perror("rdma_post_sendv");
+                throw std::runtime_error{"queue_pair::post_send completion error."};
+	    }
+
+            wait_for_send_completion();
+        }
+
+    private:
+        auto wait_for_send_completion() -> void
+        {
             ibv_wc wc{};
+            int ec;
 
             // This function requires that separate rdma_cm_id's must be used for
             // sends and receive completions. This function may be bad for implementing
@@ -100,13 +149,13 @@ namespace rdma
             while ((ec = rdma_get_send_comp(&comm_id_, &wc)) == 0);
 
             if (ec < 0) {
-		perror("rdma_post_send");
+		perror("rdma_get_send_comp");
                 throw std::runtime_error{"queue_pair::post_send completion error."};
 	    }
         }
 
-    private:
         rdma_cm_id& comm_id_;
+        std::uint32_t max_send_sge_;
     }; // class queue_pair
 
     class communication_manager
@@ -118,7 +167,7 @@ namespace rdma
             ibv_qp_init_attr attrs{};
             attrs.cap.max_send_wr = 1;
 	    attrs.cap.max_recv_wr = 1;
-            attrs.cap.max_send_sge = 1;
+            attrs.cap.max_send_sge = 2; // Message header and payload.
 	    attrs.cap.max_recv_sge = 1;
             attrs.sq_sig_all = 1;
 
@@ -184,5 +233,18 @@ namespace rdma
     {
         return mr_;
     }
+
+    auto memory_region::segment(std::uint64_t _offset, std::uint32_t _length) const -> ibv_sge
+    {
+        if (_offset + _length > mr_->length)
+            throw std::out_of_range{"memory_region::segment exceeds memory region."};
+
+        ibv_sge sge{};
+        sge.addr = reinterpret_cast<std::uintptr_t>(mr_->addr) + _offset;
+        sge.length = _length;
+        sge.lkey = mr_->lkey;
+
+        return sge;
+    }
 } // namespace rdma
 
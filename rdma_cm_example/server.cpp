@@ -4,13 +4,17 @@
 //
 
 #include "rdma_cpp.hpp"
+#include "framing.hpp"
 
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <stdexcept>
 
+constexpr std::uint32_t max_message_size = 100;
+
 auto main(int _argc, char* _argv[]) -> int
 {
     if (_argc != 2) {
@@ -43,7 +47,7 @@ auto main(int _argc, char* _argv[]) -> int
         rdma::communication_manager client_comm_mgr{*client_comm_id};
 	std::cout << "Created new communication manager for client.\n";
 
-        std::vector<std::uint8_t> buffer(100);
+        std::vector<std::uint8_t> buffer(rdma::frame_header_size + max_message_size);
         rdma::memory_region mem_region{client_comm_mgr, buffer.data(), buffer.size()};
 	std::cout << "Created and registered memory region (buffer size: " << buffer.size() << ").\n";
 
@@ -72,7 +76,13 @@ auto main(int _argc, char* _argv[]) -> int
 	    perror("rdma_get_recv_comp");
             throw std::runtime_error{"rdma_get_recv_comp error."};
 	}
-        std::cout << "Received Message: " << (char*) buffer.data() << '\n';
+
+        rdma::frame_decoder decoder{max_message_size};
+        decoder.feed(buffer.data(), wc.byte_len, [](const rdma::frame_header& _header, const std::uint8_t* _payload) {
+            std::cout << "Received Message: ";
+            std::cout.write(reinterpret_cast<const char*>(_payload), _header.length);
+            std::cout << '\n';
+        });
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << '\n';